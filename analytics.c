@@ -0,0 +1,191 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "analytics.h"
+#include "history.h"
+
+typedef struct {
+    size_t offset;
+    size_t width;
+} Column;
+
+// On-disk order of the metric columns, append new ones at the end
+static const Column columns[] = {
+    {offsetof(Analytics, letter_hits), sizeof(uint32_t)},
+    {offsetof(Analytics, letter_misses), sizeof(uint32_t)},
+    {offsetof(Analytics, word_hits), sizeof(uint32_t)},
+    {offsetof(Analytics, word_misses), sizeof(uint32_t)},
+    {offsetof(Analytics, invalid), sizeof(uint32_t)},
+    {offsetof(Analytics, timeouts), sizeof(uint32_t)},
+    {offsetof(Analytics, hints), sizeof(uint32_t)},
+    {offsetof(Analytics, turns), sizeof(uint32_t)},
+    {offsetof(Analytics, turn_ms), sizeof(uint64_t)},
+    {offsetof(Analytics, rounds), sizeof(uint32_t)},
+    {offsetof(Analytics, eliminations), sizeof(uint32_t)},
+    {offsetof(Analytics, games), sizeof(uint32_t)},
+    {offsetof(Analytics, points), sizeof(int64_t)},
+};
+#define COLUMN_COUNT (int)(sizeof(columns) / sizeof(columns[0]))
+
+typedef struct {
+    uint32_t magic;
+    uint32_t columns;
+    uint32_t count;
+    uint32_t name_size;
+} AnalyticsHeader;
+
+static void clear_rows(Analytics *a) {
+    memset(&a->count, 0, sizeof(*a) - offsetof(Analytics, count));
+}
+
+void analytics_init(Analytics *a) {
+    pthread_mutexattr_init(&a->lock_attr);
+    pthread_mutexattr_setpshared(&a->lock_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&a->lock, &a->lock_attr);
+    clear_rows(a);
+}
+
+static void insert_slot(Analytics *a, int row) {
+    uint32_t i = history_name_hash(a->names[row]) & (ANALYTICS_SLOTS - 1);
+    while (a->slots[i]) i = (i + 1) & (ANALYTICS_SLOTS - 1);
+    __atomic_store_n(&a->slots[i], row + 1, __ATOMIC_RELEASE);
+}
+
+// Lock-free: rows are published after their name is written
+int analytics_find(const Analytics *a, const char *name) {
+    uint32_t i = history_name_hash(name) & (ANALYTICS_SLOTS - 1);
+    int slot;
+    while ((slot = __atomic_load_n(&a->slots[i], __ATOMIC_ACQUIRE)) != 0) {
+        if (strncmp(a->names[slot - 1], name, NAME_SIZE) == 0) return slot - 1;
+        i = (i + 1) & (ANALYTICS_SLOTS - 1);
+    }
+    return -1;
+}
+
+// Existing row for name, or a new zeroed one; -1 when full
+int analytics_row(Analytics *a, const char *name) {
+    int row = analytics_find(a, name);
+    if (row >= 0) return row;
+
+    pthread_mutex_lock(&a->lock);
+    row = analytics_find(a, name);
+    if (row < 0 && a->count < ANALYTICS_CAPACITY) {
+        row = a->count++;
+        snprintf(a->names[row], NAME_SIZE, "%s", name);
+        insert_slot(a, row);
+    }
+    pthread_mutex_unlock(&a->lock);
+    return row;
+}
+
+static void add32(uint32_t *column, int row, uint32_t v) {
+    if (row >= 0) __atomic_fetch_add(&column[row], v, __ATOMIC_RELAXED);
+}
+
+void analytics_move(Analytics *a, int row, int kind) {
+    switch (kind) {
+    case MOVE_LETTER_HIT: add32(a->letter_hits, row, 1); break;
+    case MOVE_LETTER_MISS: add32(a->letter_misses, row, 1); break;
+    case MOVE_WORD_HIT: add32(a->word_hits, row, 1); break;
+    case MOVE_WORD_MISS: add32(a->word_misses, row, 1); break;
+    case MOVE_INVALID: add32(a->invalid, row, 1); break;
+    case MOVE_TIMEOUT: add32(a->timeouts, row, 1); break;
+    case MOVE_HINT: add32(a->hints, row, 1); break;
+    }
+}
+
+void analytics_turn(Analytics *a, int row, long long ms) {
+    if (row < 0 || ms < 0) return;
+    add32(a->turns, row, 1);
+    __atomic_fetch_add(&a->turn_ms[row], (uint64_t)ms, __ATOMIC_RELAXED);
+}
+
+void analytics_round(Analytics *a, int row) {
+    add32(a->rounds, row, 1);
+}
+
+void analytics_elimination(Analytics *a, int row) {
+    add32(a->eliminations, row, 1);
+}
+
+void analytics_game(Analytics *a, int row, int points) {
+    if (row < 0) return;
+    add32(a->games, row, 1);
+    __atomic_fetch_add(&a->points[row], (int64_t)points, __ATOMIC_RELAXED);
+}
+
+static double ratio(double num, double den) {
+    return den > 0 ? num / den : 0.0;
+}
+
+int analytics_format(const Analytics *a, int row, char *out, size_t size) {
+    if (row < 0 || row >= a->count) return snprintf(out, size, "STATS:NONE");
+
+    uint32_t lh = a->letter_hits[row], lm = a->letter_misses[row];
+    uint32_t wh = a->word_hits[row], wm = a->word_misses[row];
+    return snprintf(out, size,
+                    "STATS:%s|games=%u|points=%lld|ppg=%.2f|letters=%u/%u|letter_acc=%.1f"
+                    "|words=%u/%u|word_acc=%.1f|invalid=%u|timeouts=%u|hints=%u"
+                    "|avg_turn_ms=%.0f|elim_per_round=%.2f",
+                    a->names[row], a->games[row], (long long)a->points[row],
+                    ratio(a->points[row], a->games[row]),
+                    lh, lh + lm, 100.0 * ratio(lh, lh + lm),
+                    wh, wh + wm, 100.0 * ratio(wh, wh + wm),
+                    a->invalid[row], a->timeouts[row], a->hints[row],
+                    ratio(a->turn_ms[row], a->turns[row]),
+                    ratio(a->eliminations[row], a->rounds[row]));
+}
+
+// File layout: header, the name column, then each metric column, each
+// holding count entries. Written to path.tmp and renamed into place.
+int analytics_save(Analytics *a, const char *path) {
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return -1;
+
+    int count = __atomic_load_n(&a->count, __ATOMIC_ACQUIRE);
+    AnalyticsHeader h = {ANALYTICS_MAGIC, COLUMN_COUNT, count, NAME_SIZE};
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    ok = ok && fwrite(a->names, NAME_SIZE, count, f) == (size_t)count;
+    for (int c = 0; ok && c < COLUMN_COUNT; c++) {
+        ok = fwrite((char *)a + columns[c].offset, columns[c].width, count, f) == (size_t)count;
+    }
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) < 0) {
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+// Call before any handler is forked
+int analytics_load(Analytics *a, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+
+    AnalyticsHeader h;
+    int ok = fread(&h, sizeof(h), 1, f) == 1 && h.magic == ANALYTICS_MAGIC &&
+             h.name_size == NAME_SIZE && h.count <= ANALYTICS_CAPACITY && h.columns <= COLUMN_COUNT;
+    ok = ok && fread(a->names, NAME_SIZE, h.count, f) == h.count;
+    // Files from before a column was added simply leave it at zero
+    for (uint32_t c = 0; ok && c < h.columns; c++) {
+        ok = fread((char *)a + columns[c].offset, columns[c].width, h.count, f) == h.count;
+    }
+    fclose(f);
+    if (!ok) {
+        clear_rows(a);
+        return -1;
+    }
+
+    a->count = h.count;
+    memset(a->slots, 0, sizeof(a->slots));
+    for (int row = 0; row < a->count; row++) {
+        a->names[row][NAME_SIZE - 1] = '\0';
+        insert_slot(a, row);
+    }
+    return a->count;
+}
@@ -0,0 +1,56 @@
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "game_state.h"
+
+// Per-player aggregates kept column-wise in shared memory: one array per
+// metric, indexed by a player's row. Every game event is a single atomic
+// add into one column, so handlers update them in O(1) without a lock;
+// the lock only guards assigning rows to new names.
+
+#define ANALYTICS_FILE "analytics.dat"
+#define ANALYTICS_CAPACITY 4096
+#define ANALYTICS_SLOTS 8192        // name hash table, power of two
+#define ANALYTICS_MAGIC 0x31534157  // "WAS1"
+
+typedef struct {
+    pthread_mutex_t lock CACHE_ALIGNED;
+    pthread_mutexattr_t lock_attr;
+    int count;
+    int slots[ANALYTICS_SLOTS];     // row + 1, 0 = empty
+    char names[ANALYTICS_CAPACITY][NAME_SIZE];
+
+    uint32_t letter_hits[ANALYTICS_CAPACITY] CACHE_ALIGNED;
+    uint32_t letter_misses[ANALYTICS_CAPACITY] CACHE_ALIGNED;
+    uint32_t word_hits[ANALYTICS_CAPACITY] CACHE_ALIGNED;
+    uint32_t word_misses[ANALYTICS_CAPACITY] CACHE_ALIGNED;
+    uint32_t invalid[ANALYTICS_CAPACITY] CACHE_ALIGNED;
+    uint32_t timeouts[ANALYTICS_CAPACITY] CACHE_ALIGNED;
+    uint32_t hints[ANALYTICS_CAPACITY] CACHE_ALIGNED;
+    uint32_t turns[ANALYTICS_CAPACITY] CACHE_ALIGNED;            // answered turns
+    uint64_t turn_ms[ANALYTICS_CAPACITY] CACHE_ALIGNED;          // summed over answered turns
+    uint32_t rounds[ANALYTICS_CAPACITY] CACHE_ALIGNED;
+    uint32_t eliminations[ANALYTICS_CAPACITY] CACHE_ALIGNED;
+    uint32_t games[ANALYTICS_CAPACITY] CACHE_ALIGNED;
+    int64_t points[ANALYTICS_CAPACITY] CACHE_ALIGNED;
+} Analytics;
+
+void analytics_init(Analytics *a);
+int analytics_load(Analytics *a, const char *path);
+int analytics_save(Analytics *a, const char *path);
+
+int analytics_find(const Analytics *a, const char *name);
+int analytics_row(Analytics *a, const char *name);
+
+void analytics_move(Analytics *a, int row, int kind);
+void analytics_turn(Analytics *a, int row, long long ms);
+void analytics_round(Analytics *a, int row);
+void analytics_elimination(Analytics *a, int row);
+void analytics_game(Analytics *a, int row, int points);
+
+int analytics_format(const Analytics *a, int row, char *out, size_t size);
+
+#endif
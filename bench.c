@@ -0,0 +1,432 @@
+// Microbenchmarks for the server and client hot paths. Builds server.c and
+// client.c into this binary with their main() renamed, so it measures the
+// code exactly as shipped. Run through `make bench`.
+
+#define main server_main
+#include "server.c"
+#undef main
+#define main client_main
+#include "client.c"
+#undef main
+
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#ifndef BENCH_REVISION
+#define BENCH_REVISION "unknown"
+#endif
+
+#define BENCH_WARMUP 5              // repetitions discarded before measuring
+#define BENCH_REPS 30
+#define BENCH_TARGET_NS 2000000     // batch size is grown until a batch takes this long
+#define BENCH_MAX 32
+#define RECV_CHUNK_LINES 64
+
+typedef struct {
+    const char *name;
+    void (*setup)(void);
+    void (*op)(void);
+} Bench;
+
+typedef struct {
+    const char *name;
+    long batch;
+    int reps;
+    double mean, min, p50, p90, p99, max;
+} BenchResult;
+
+static volatile long sink;
+static int letter_pos = 0;
+static int recv_fds[2] = {-1, -1};
+static int recv_left = 0;
+static char recv_chunk[RECV_CHUNK_LINES * 32];
+static int recv_chunk_len = 0;
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Shared state as the server sets it up, without sockets or threads
+static void bench_init(void) {
+    dictionary = calloc(1, sizeof(Dictionary));     // no words, as the solver is not benched
+    if (!dictionary || map_shared_state() < 0 || map_room_state() < 0) {
+        perror("mmap failed");
+        exit(1);
+    }
+    pthread_mutexattr_init(&game->lock_attr);
+    pthread_mutexattr_setpshared(&game->lock_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&game->lock, &game->lock_attr);
+    pthread_mutexattr_init(&log_buffer->lock_attr);
+    pthread_mutexattr_setpshared(&log_buffer->lock_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&log_buffer->lock, &log_buffer->lock_attr);
+    pthread_mutexattr_init(&score_data->lock_attr);
+    pthread_mutexattr_setpshared(&score_data->lock_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&score_data->lock, &score_data->lock_attr);
+    pthread_mutexattr_init(&outbound->lock_attr);
+    pthread_mutexattr_setpshared(&outbound->lock_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&outbound->lock, &outbound->lock_attr);
+    outbound_init();
+
+    game->player_count = MAX_CLIENTS;
+    game->round = 2;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        game->players[i].socket = 1000 + i;   // never written, the flusher is not running
+        snprintf(game->players[i].name, NAME_SIZE, "player_%d", i);
+        game->connected[i] = 1;
+        game->round_lives[i] = 3;
+        game->total_score[i] = 4 * i;
+    }
+    publish_state();
+}
+
+// The log buffer silently drops entries when full, keep it appending
+static void keep_log_open(void) {
+    if (log_buffer->count >= LOG_CAPACITY) log_buffer->count = 0;
+}
+
+static void keep_queues_open(void) {
+    if (outbound->queues[0].queued_bytes > OUT_HIGH_WATERMARK) outbound_init();
+}
+
+static void setup_word(void) {
+    strcpy(game->word, "PAPAYA");
+    init_answer();
+    letter_pos = 0;
+}
+
+static void op_check_letter(void) {
+    sink += check_letter('A' + letter_pos);
+    letter_pos = (letter_pos + 1) % 26;
+}
+
+static void op_update_answer(void) {
+    update_answer('A' + letter_pos);
+    if (++letter_pos == 26) {
+        init_answer();
+        letter_pos = 0;
+    }
+}
+
+static void setup_log(void) {
+    log_buffer->count = 0;
+}
+
+static void op_add_log(void) {
+    keep_log_open();
+    add_log("%s: correct letter %c (+1 pt, total %d)", "player_1", 'A', 7);
+}
+
+// A full score table, the winner is the last record
+static void setup_scores(void) {
+    score_data->count = 0;
+    for (int i = 0; i < SCORE_CAPACITY; i++) {
+        ScoreRecord *r = &score_data->records[i];
+        snprintf(r->player_name, NAME_SIZE, "veteran_%03d", i);
+        r->wins = i % 7;
+        r->games = i % 13 + 1;
+        r->points = i * 3;
+        score_data->count++;
+    }
+    setup_log();
+}
+
+static void op_update_winner(void) {
+    keep_log_open();
+    update_winner("veteran_099");
+}
+
+static void op_save_scores(void) {
+    keep_log_open();
+    save_scores();
+}
+
+static void setup_turns(void) {
+    game->current_player = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) game->round_eliminated[i] = 0;
+    game->round_eliminated[1] = 1;
+}
+
+static void op_next_player(void) {
+    int nxt = next_player();
+    game->current_player = nxt < 0 ? 0 : nxt;
+    sink += nxt;
+}
+
+static void op_format_state(void) {
+    GameSnapshot snap;
+    read_snapshot(&snap);
+    char msg[100];
+    format_state(&snap, 1, msg, sizeof(msg));
+    sink += msg[6];
+}
+
+static void setup_send(void) {
+    outbound_init();
+    setup_log();
+}
+
+static void op_send_state(void) {
+    keep_log_open();
+    keep_queues_open();
+    send_state(1);
+}
+
+static void op_show_scores(void) {
+    keep_queues_open();
+    show_scores();
+}
+
+// The client's line splitter; the peer is refilled once per chunk, and the
+// buffer is refilled from the socket when it holds no complete line
+static LineBuffer recv_buffer;
+
+static void setup_recv(void) {
+    if (recv_fds[0] < 0 && socketpair(AF_UNIX, SOCK_STREAM, 0, recv_fds) < 0) {
+        perror("socketpair");
+        exit(1);
+    }
+    recv_chunk_len = 0;
+    const char *lines[] = {"STATE:R2|L3|S5|E0", "TURN:player_1", "BOARD:P_P_Y_", "PROMPT"};
+    for (int i = 0; i < RECV_CHUNK_LINES; i++) {
+        recv_chunk_len += sprintf(recv_chunk + recv_chunk_len, "%s\n", lines[i % 4]);
+    }
+    recv_left = 0;
+    memset(&recv_buffer, 0, sizeof(recv_buffer));
+}
+
+static void op_recv_line(void) {
+    if (recv_left == 0) {
+        if (write(recv_fds[1], recv_chunk, recv_chunk_len) != recv_chunk_len) exit(1);
+        recv_left = RECV_CHUNK_LINES;
+    }
+    char buf[256];
+    int n;
+    while ((n = next_line(&recv_buffer, buf, sizeof(buf))) < 0) {
+        if (fill_lines(recv_fds[0], &recv_buffer) <= 0) exit(1);
+    }
+    sink += n;
+    recv_left--;
+}
+
+// One client frame with the countdown ticking: drawn in full, flushed as
+// a diff to /dev/null
+static Screen bench_screen;
+static ClientState bench_client;
+static int devnull_fd = -1;
+
+static void setup_render(void) {
+    if (devnull_fd < 0) devnull_fd = open("/dev/null", O_WRONLY);
+    screen_init(&bench_screen);
+    memset(&bench_client, 0, sizeof(bench_client));
+    strcpy(bench_client.my_name, "player_1");
+    strcpy(bench_client.current_turn_player, "player_1");
+    strcpy(bench_client.answer_space, "P_P_Y_");
+    strcpy(bench_client.notice, "✓ CORRECT LETTER! +1 Mark earned");
+    bench_client.round = 2;
+    bench_client.lives = 3;
+    bench_client.my_turn = 1;
+    bench_client.turn_deadline = clock_ms() + TURN_SECONDS * 1000;
+}
+
+static void op_render_frame(void) {
+    bench_client.score++;
+    render(&bench_client, &bench_screen);
+    sink += screen_flush(&bench_screen, devnull_fd, 0);
+}
+
+// A queue with four young waiters per bucket; each op queues a full room
+// in one bucket, forms it and frees the slots
+static void setup_match(void) {
+    if (!match_queue) match_queue = malloc(sizeof(MatchQueue));
+    match_init(match_queue);
+    for (int b = 0; b < MATCH_BUCKETS; b++) {
+        for (int i = 0; i < MATCH_ROOM_MAX - 1; i++) {
+            int rating = MATCH_RATING_MIN + b * (MATCH_RATING_MAX - MATCH_RATING_MIN) / MATCH_BUCKETS;
+            match_enqueue(match_queue, match_alloc(match_queue, -1, 0), rating, 0);
+        }
+    }
+}
+
+static void op_match_room(void) {
+    int room[MATCH_ROOM_MAX];
+    for (int i = 0; i < MATCH_ROOM_MAX; i++) {
+        match_enqueue(match_queue, match_alloc(match_queue, -1, 0), MATCH_RATING_MAX, 0);
+    }
+    int n = match_form(match_queue, 0, room);
+    for (int i = 0; i < n; i++) match_release(match_queue, room[i]);
+    sink += n;
+}
+
+static const Bench benches[] = {
+    {"check_letter", setup_word, op_check_letter},
+    {"update_answer", setup_word, op_update_answer},
+    {"add_log", setup_log, op_add_log},
+    {"update_winner", setup_scores, op_update_winner},
+    {"save_scores", setup_scores, op_save_scores},
+    {"next_player", setup_turns, op_next_player},
+    {"format_state", NULL, op_format_state},
+    {"send_state", setup_send, op_send_state},
+    {"show_scores", setup_send, op_show_scores},
+    {"next_line", setup_recv, op_recv_line},
+    {"render_frame", setup_render, op_render_frame},
+    {"match_room", setup_match, op_match_room},
+};
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double batch_ns(const Bench *b, long batch) {
+    long long start = now_ns();
+    for (long i = 0; i < batch; i++) b->op();
+    return (double)(now_ns() - start);
+}
+
+static double percentile(const double *sorted, int n, double p) {
+    int i = (int)(p * (n - 1) + 0.5);
+    return sorted[i];
+}
+
+static void run_bench(const Bench *b, int reps, BenchResult *r) {
+    if (b->setup) b->setup();
+
+    long batch = 1;
+    while (batch < (1L << 30) && batch_ns(b, batch) < BENCH_TARGET_NS) batch *= 2;
+
+    for (int i = 0; i < BENCH_WARMUP; i++) batch_ns(b, batch);
+
+    double per_op[reps];
+    double total = 0;
+    for (int i = 0; i < reps; i++) {
+        per_op[i] = batch_ns(b, batch) / batch;
+        total += per_op[i];
+    }
+    qsort(per_op, reps, sizeof(double), compare_double);
+
+    r->name = b->name;
+    r->batch = batch;
+    r->reps = reps;
+    r->mean = total / reps;
+    r->min = per_op[0];
+    r->p50 = percentile(per_op, reps, 0.50);
+    r->p90 = percentile(per_op, reps, 0.90);
+    r->p99 = percentile(per_op, reps, 0.99);
+    r->max = per_op[reps - 1];
+}
+
+// p50 of the named benchmark in an earlier JSON result file, or -1
+static double baseline_p50(const char *json, const char *name) {
+    if (!json) return -1;
+    char key[128];
+    snprintf(key, sizeof(key), "\"name\":\"%s\"", name);
+    const char *at = strstr(json, key);
+    if (!at) return -1;
+    at = strstr(at, "\"p50_ns\":");
+    if (!at) return -1;
+    return atof(at + 9);
+}
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc(len + 1);
+    if (data && fread(data, 1, len, f) != (size_t)len) len = 0;
+    if (data) data[len] = '\0';
+    fclose(f);
+    return data;
+}
+
+static void write_json(const char *path, const BenchResult *results, int count) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return;
+    }
+    fprintf(f, "{\"revision\":\"%s\",\"timestamp\":%ld,\"results\":[\n", BENCH_REVISION, (long)time(NULL));
+    for (int i = 0; i < count; i++) {
+        const BenchResult *r = &results[i];
+        fprintf(f, "  {\"name\":\"%s\",\"batch\":%ld,\"reps\":%d,\"mean_ns\":%.2f,\"min_ns\":%.2f,"
+                   "\"p50_ns\":%.2f,\"p90_ns\":%.2f,\"p99_ns\":%.2f,\"max_ns\":%.2f}%s\n",
+                r->name, r->batch, r->reps, r->mean, r->min, r->p50, r->p90, r->p99, r->max,
+                i + 1 < count ? "," : "");
+    }
+    fprintf(f, "]}\n");
+    fclose(f);
+}
+
+int main(int argc, char *argv[]) {
+    const char *json_path = NULL;
+    const char *baseline_path = NULL;
+    const char *filter = NULL;
+    int reps = BENCH_REPS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:b:f:r:")) != -1) {
+        switch (opt) {
+        case 'o':
+            json_path = optarg;
+            break;
+        case 'b':
+            baseline_path = optarg;
+            break;
+        case 'f':
+            filter = optarg;
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-o results.json] [-b baseline.json] [-f filter] [-r reps]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (reps < 1) reps = 1;
+
+    // Read before changing directory, relative paths refer to the caller's
+    char *baseline = baseline_path ? read_file(baseline_path) : NULL;
+    if (baseline_path && !baseline) perror(baseline_path);
+    char json_abs[PATH_MAX];
+    if (json_path && json_path[0] != '/' && getcwd(json_abs, sizeof(json_abs))) {
+        size_t len = strlen(json_abs);
+        snprintf(json_abs + len, sizeof(json_abs) - len, "/%s", json_path);
+        json_path = json_abs;
+    }
+
+    // save_scores() writes scores.txt in the working directory
+    char dir[] = "/tmp/wordbench.XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) < 0) {
+        perror("temporary directory");
+        return 1;
+    }
+
+    bench_init();
+
+    BenchResult results[BENCH_MAX];
+    int count = 0;
+    printf("revision %s, %d reps after %d warmup\n", BENCH_REVISION, reps, BENCH_WARMUP);
+    printf("%-16s %10s %10s %10s %10s %10s%s\n", "benchmark", "batch", "min ns", "p50 ns", "p90 ns", "p99 ns",
+           baseline ? "   vs base" : "");
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        if (filter && !strstr(benches[i].name, filter)) continue;
+        BenchResult *r = &results[count++];
+        run_bench(&benches[i], reps, r);
+        printf("%-16s %10ld %10.1f %10.1f %10.1f %10.1f", r->name, r->batch, r->min, r->p50, r->p90, r->p99);
+        double base = baseline_p50(baseline, r->name);
+        if (base > 0) printf("   %+6.1f%%", (r->p50 - base) / base * 100.0);
+        printf("\n");
+    }
+
+    if (json_path) write_json(json_path, results, count);
+
+    unlink("scores.txt");
+    if (chdir("/") == 0) rmdir(dir);
+    free(baseline);
+    return 0;
+}
@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include "game_state.h"
+
+// Cross-process cache-line contention benchmark for the shared GameState.
+// One writer process applies turns the way handle_move()/the scheduler do,
+// reader processes poll the way the forked client handlers do. Run it under
+// `perf c2c record ./c2cbench` to see the HITM lines for each layout.
+
+// The layout before the cache-line redesign, kept here for comparison
+typedef struct {
+    int socket;
+    char name[NAME_SIZE];
+    int total_score;
+    int round_lives;
+    int round_eliminated;
+    int ready;
+    int connected;
+} LegacyPlayer;
+
+typedef struct {
+    char word[WORD_LEN];
+    char answer_space[ANSWER_SIZE];
+    int current_player;
+    int round;
+    LegacyPlayer players[MAX_CLIENTS];
+    int player_count;
+    int game_started;
+    int game_finished;
+    int turn_in_progress;
+    pthread_mutex_t lock;
+    pthread_mutexattr_t lock_attr;
+} LegacyGameState;
+
+typedef struct {
+    int stop CACHE_ALIGNED;
+    struct {
+        long long ops CACHE_ALIGNED;
+    } counts[64];
+} Control;
+
+enum { POLL, COLD_READ };
+enum { LEGACY, PADDED };
+
+static Control *ctl;
+static volatile long long sink_out;    // keeps the reader loads alive
+
+static void init_mutex(pthread_mutex_t *m, pthread_mutexattr_t *attr) {
+    pthread_mutexattr_init(attr);
+    pthread_mutexattr_setpshared(attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(m, attr);
+}
+
+static void legacy_writer(LegacyGameState *g, int id) {
+    long long ops = 0;
+    while (!__atomic_load_n(&ctl->stop, __ATOMIC_RELAXED)) {
+        int k = ops % MAX_CLIENTS;
+        pthread_mutex_lock(&g->lock);
+        g->players[k].total_score++;
+        g->players[k].round_lives = 3 - (ops & 1);
+        g->players[k].ready = !g->players[k].ready;
+        g->current_player = k;
+        g->turn_in_progress = ops & 1;
+        pthread_mutex_unlock(&g->lock);
+        ops++;
+    }
+    ctl->counts[id].ops = ops;
+}
+
+static void legacy_reader(LegacyGameState *g, int id, int scenario) {
+    long long ops = 0, sink = 0;
+    int idx = id % MAX_CLIENTS;
+    while (!__atomic_load_n(&ctl->stop, __ATOMIC_RELAXED)) {
+        if (scenario == POLL) {
+            pthread_mutex_lock(&g->lock);
+            sink += g->current_player == idx && !g->players[idx].round_eliminated &&
+                    !g->players[idx].ready && !g->turn_in_progress;
+            pthread_mutex_unlock(&g->lock);
+        } else {
+            sink += __atomic_load_n(&g->players[idx].name[0], __ATOMIC_RELAXED);
+            sink += __atomic_load_n(&g->players[idx].socket, __ATOMIC_RELAXED);
+        }
+        ops++;
+    }
+    sink_out = sink;
+    ctl->counts[id].ops = ops;
+}
+
+static void padded_writer(GameState *g, int id) {
+    long long ops = 0;
+    while (!__atomic_load_n(&ctl->stop, __ATOMIC_RELAXED)) {
+        int k = ops % MAX_CLIENTS;
+        pthread_mutex_lock(&g->lock);
+        g->total_score[k]++;
+        g->round_lives[k] = 3 - (ops & 1);
+        g->ready[k] = !g->ready[k];
+        g->current_player = k;
+        g->turn_in_progress = ops & 1;
+        snapshot_publish(g);
+        pthread_mutex_unlock(&g->lock);
+        ops++;
+    }
+    ctl->counts[id].ops = ops;
+}
+
+static void padded_reader(GameState *g, int id, int scenario) {
+    long long ops = 0, sink = 0;
+    int idx = id % MAX_CLIENTS;
+    while (!__atomic_load_n(&ctl->stop, __ATOMIC_RELAXED)) {
+        if (scenario == POLL) {
+            GameSnapshot snap;
+            snapshot_read(g, &snap);
+            sink += snap.current_player == idx && !snap.players[idx].round_eliminated &&
+                    !snap.players[idx].ready && !snap.turn_in_progress;
+        } else {
+            sink += __atomic_load_n(&g->players[idx].name[0], __ATOMIC_RELAXED);
+            sink += __atomic_load_n(&g->players[idx].socket, __ATOMIC_RELAXED);
+        }
+        ops++;
+    }
+    sink_out = sink;
+    ctl->counts[id].ops = ops;
+}
+
+static void run(int layout, int scenario, int readers, double seconds) {
+    size_t size = layout == LEGACY ? sizeof(LegacyGameState) : sizeof(GameState);
+    void *shm = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS|MAP_POPULATE, -1, 0);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    memset(shm, 0, size);
+
+    if (layout == LEGACY) {
+        LegacyGameState *g = shm;
+        init_mutex(&g->lock, &g->lock_attr);
+        for (int i = 0; i < MAX_CLIENTS; i++) snprintf(g->players[i].name, NAME_SIZE, "player%d", i);
+    } else {
+        GameState *g = shm;
+        init_mutex(&g->lock, &g->lock_attr);
+        for (int i = 0; i < MAX_CLIENTS; i++) snprintf(g->players[i].name, NAME_SIZE, "player%d", i);
+        snapshot_publish(g);
+    }
+
+    memset(ctl, 0, sizeof(*ctl));
+    for (int id = 0; id <= readers; id++) {
+        if (fork() == 0) {
+            if (layout == LEGACY) {
+                if (id == 0) legacy_writer(shm, id);
+                else legacy_reader(shm, id, scenario);
+            } else {
+                if (id == 0) padded_writer(shm, id);
+                else padded_reader(shm, id, scenario);
+            }
+            _exit(0);
+        }
+    }
+
+    struct timespec ts = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+    nanosleep(&ts, NULL);
+    __atomic_store_n(&ctl->stop, 1, __ATOMIC_RELAXED);
+    while (wait(NULL) > 0);
+
+    long long reads = 0;
+    for (int id = 1; id <= readers; id++) reads += ctl->counts[id].ops;
+    printf("%-10s %-7s %14.2f %14.2f\n",
+           scenario == POLL ? "poll" : "cold-read",
+           layout == LEGACY ? "legacy" : "padded",
+           ctl->counts[0].ops / seconds / 1e6, reads / seconds / 1e6);
+
+    munmap(shm, size);
+}
+
+int main(int argc, char *argv[]) {
+    int readers = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    double seconds = 1.0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:t:")) != -1) {
+        switch (opt) {
+        case 'r':
+            readers = atoi(optarg);
+            break;
+        case 't':
+            seconds = atof(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-r readers] [-t seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (readers < 1) readers = 1;
+    if (readers > 63) readers = 63;
+
+    ctl = mmap(NULL, sizeof(Control), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if (ctl == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    printf("GameState: legacy %zu bytes, padded %zu bytes; 1 writer, %d readers, %.1fs each\n",
+           sizeof(LegacyGameState), sizeof(GameState), readers, seconds);
+    printf("%-10s %-7s %14s %14s\n", "scenario", "layout", "writes Mop/s", "reads Mop/s");
+    for (int scenario = POLL; scenario <= COLD_READ; scenario++) {
+        run(LEGACY, scenario, readers, seconds);
+        run(PADDED, scenario, readers, seconds);
+    }
+    return 0;
+}
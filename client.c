@@ -4,16 +4,26 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <ctype.h>
-#include <sys/select.h>
-#include <sys/time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/timerfd.h>
+#include <stdarg.h>
 #include <termios.h>
 #include <time.h>
+#include "screen.h"
 
 #define PORT 8080
 #define ANSWER_SIZE 50
 #define NAME_SIZE 50
 #define WORD_LEN 20
-#define MAX_RETRIES 3
+#define TURN_SECONDS 15         // turn length if PROMPT carries no deadline
+#define INBUF_SIZE 4096
+#define MAX_PLAYERS 5
+#define EVENT_LINES 6           // tournament and round events kept on screen
+#define ESC_WAIT_MS 50          // an ESC nothing follows within this is the Esc key
+#define CHAT_TEXT_MAX 100       // the server cuts longer chat
 
 typedef struct {
     char answer_space[ANSWER_SIZE];
@@ -23,115 +33,543 @@ typedef struct {
     int lives;
     int score;
     int is_eliminated;  // Synced from server
-    int needs_display;
-    int waiting_for_prompt;
+    int hint_used;
+    int in_tournament;  // the connection outlives each game
+    int my_turn;        // PROMPT received, move not sent yet
+    int typing_word;    // word entry open during the turn
+    char word[WORD_LEN];
+    int word_len;
+    int typing_chat;    // chat entry open, at any time; keys go to it
+    char chat[CHAT_TEXT_MAX + 1];
+    int chat_len;
+    long long turn_deadline;    // CLOCK_MONOTONIC ms, last moment to send a move
+    int turn_seconds;   // length of the current turn as the server set it
+    char notice[160];   // outcome of the last move, kept under the board
+    int game_over;
+    int scores_round;
+    int score_count;
+    char scores[MAX_PLAYERS][SCREEN_COLS - 44];     // last ROUND_SCORES, beside the board
+    int event_count;
+    char events[EVENT_LINES][SCREEN_COLS + 1];
+    int frame_due;      // state changed since the last frame
+    int escape;         // KEY_*: how far into an escape sequence the keyboard is
+    long long escape_at;        // CLOCK_MONOTONIC ms the ESC arrived
 } ClientState;
 
-int recvLine(int sock, char *buf, int max) {
-    int i = 0;
-    char c;
-    while (i < max - 1) {
-        int n = recv(sock, &c, 1, 0);
-        if (n <= 0) return n;
-        if (c == '\n') break;
-        buf[i++] = c;
-    }
-    buf[i] = '\0';
-    return i;
+enum { KEY_PLAIN, KEY_ESC, KEY_SEQUENCE };
+
+// Socket input as it arrives, handed out one complete line at a time
+typedef struct {
+    char data[INBUF_SIZE];
+    int start;
+    int len;
+} LineBuffer;
+
+struct termios saved_termios;
+int raw_mode = 0;
+
+long long clock_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-void displayGameState(ClientState *s) {
-    printf("\n╔════════════════════════════════════════╗\n");
-    printf("║        WORD GUESSING GAME              ║\n");
-    printf("╠════════════════════════════════════════╣\n");
-    printf("║ Player: %-30s ║\n", s->my_name);
-    printf("║ Round:  %-30d ║\n", s->round);
-    printf("║ Lives:  %-30d ║\n", s->lives);
-    printf("║ Score:  %-30d ║\n", s->score);
-    printf("╠════════════════════════════════════════╣\n");
-    printf("║ Word:   ");
-    for (int i = 0; i < strlen(s->answer_space); i++)
-        printf("%c ", s->answer_space[i]);
-    printf("%-*s         ║\n", (int)(24 - strlen(s->answer_space) * 2), "");
-    printf("╚════════════════════════════════════════╝\n");
+// Appends whatever the socket has queued. Returns the bytes read, 0 once
+// the server has closed the connection, -1 with errno set otherwise.
+int fill_lines(int sock, LineBuffer *in) {
+    if (in->start > 0) {
+        memmove(in->data, in->data + in->start, in->len - in->start);
+        in->len -= in->start;
+        in->start = 0;
+    }
+    // No server line is this long, drop it rather than stall
+    if (in->len == (int)sizeof(in->data)) in->len = 0;
+
+    int n = recv(sock, in->data + in->len, sizeof(in->data) - in->len, 0);
+    if (n > 0) in->len += n;
+    return n;
 }
 
-void clear_screen() {
-    printf("\033[2J\033[H");
+// Takes the next complete line off the buffer, without its newline.
+// Returns its length, -1 when no complete line is buffered.
+int next_line(LineBuffer *in, char *line, int max) {
+    char *begin = in->data + in->start;
+    char *end = memchr(begin, '\n', in->len - in->start);
+    if (!end) return -1;
+
+    int n = end - begin;
+    in->start += n + 1;
+    if (n >= max) n = max - 1;
+    memcpy(line, begin, n);
+    line[n] = '\0';
+    if (n > 0 && line[n - 1] == '\r') line[--n] = '\0';
+    return n;
 }
 
-void displayMenu() {
-    printf("\n┌────────────────────────────────────────────────────────────────┐\n");
-    printf("│  Choose your move:                                             │\n");
-    printf("│  1. Guess a LETTER (+1 Mark if correct, -1 Life if wrong)      │\n");
-    printf("│  2. Guess the WORD (+3 Marks if correct, ELIMINATION if wrong) │\n");
-    printf("│                                                                │\n");
-    printf("│  [WARNING: Timeout after 15 seconds = -1 Mark!]                │\n");
-    printf("└────────────────────────────────────────────────────────────────┘\n");
-    printf("Your choice (1 or 2): ");
-    fflush(stdout);
+void restore_terminal() {
+    if (raw_mode) {
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved_termios);
+        raw_mode = 0;
+    }
 }
 
-int get_input_with_timer(char *buffer, int max_len, int timeout, const char *prompt) {
-    printf("%s", prompt);
-    fflush(stdout);
-    
-    fd_set readfds;
-    struct timeval tv;
-    time_t start_time = time(NULL);
-    time_t current_time;
-    int time_left;
-    
-    while (1) {
-        current_time = time(NULL);
-        time_left = timeout - (current_time - start_time);
-        
-        if (time_left <= 0) {
-            printf("\n\n*** TIME'S UP! Turn forfeited. ***\n");
-            fflush(stdout);
-            int c;
-            while ((c = getchar()) != '\n' && c != EOF);
-            return 0;
+void restore_and_exit(int sig) {
+    restore_terminal();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// Keys arrive one at a time and are not echoed. ISIG stays on, so Ctrl+C
+// still quits (through restore_and_exit).
+void enter_raw_mode() {
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &saved_termios) < 0) return;
+
+    struct termios raw = saved_termios;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) < 0) return;
+
+    raw_mode = 1;
+    atexit(restore_terminal);
+    signal(SIGINT, restore_and_exit);
+    signal(SIGTERM, restore_and_exit);
+}
+
+// Ticks once a second while a turn is running, for the countdown. The
+// first tick is offset so the last one lands on the deadline itself.
+void arm_timer(int tfd, long long left_ms) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (left_ms > 0) {
+        long long first = left_ms % 1000 ? left_ms % 1000 : 1000;
+        its.it_value.tv_sec = first / 1000;
+        its.it_value.tv_nsec = (first % 1000) * 1000000;
+        its.it_interval.tv_sec = 1;
+    }
+    timerfd_settime(tfd, 0, &its, NULL);
+}
+
+void send_text(int sock, const char *msg) {
+    if (send(sock, msg, strlen(msg), MSG_NOSIGNAL) < 0) {
+        // A dead connection shows up as EOF on the next read
+    }
+}
+
+void add_event(ClientState *s, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(s->events[s->event_count % EVENT_LINES], SCREEN_COLS + 1, fmt, args);
+    va_end(args);
+    s->event_count++;
+}
+
+// Draws the whole frame from the client state; the screen sends the terminal
+// only what differs from the last frame
+void render(ClientState *s, Screen *scr) {
+    screen_clear(scr);
+
+    screen_put(scr, 0, 0, "╔════════════════════════════════════════╗");
+    screen_put(scr, 1, 0, "║        WORD GUESSING GAME              ║");
+    screen_put(scr, 2, 0, "╠════════════════════════════════════════╣");
+    screen_printf(scr, 3, 0, "║ Player: %-30.30s ║", s->my_name);
+    screen_printf(scr, 4, 0, "║ Round:  %-30d ║", s->round);
+    screen_printf(scr, 5, 0, "║ Lives:  %-30d ║", s->lives);
+    screen_printf(scr, 6, 0, "║ Score:  %-30d ║", s->score);
+    screen_put(scr, 7, 0, "╠════════════════════════════════════════╣");
+    char spaced[2 * ANSWER_SIZE] = "";
+    for (int i = 0; s->answer_space[i] && i < 15; i++) {
+        spaced[2 * i] = s->answer_space[i];
+        spaced[2 * i + 1] = ' ';
+        spaced[2 * i + 2] = '\0';
+    }
+    screen_printf(scr, 8, 0, "║ Word:   %-30.30s ║", spaced);
+    screen_put(scr, 9, 0, "╚════════════════════════════════════════╝");
+
+    if (s->score_count > 0) {
+        screen_printf(scr, 1, 44, "Round %d scores:", s->scores_round);
+        for (int i = 0; i < s->score_count; i++) screen_put(scr, 3 + i, 44, s->scores[i]);
+    }
+
+    if (s->notice[0]) screen_put(scr, 11, 0, s->notice);
+
+    if (s->my_turn) {
+        screen_put(scr, 13, 0, "═══════════════════════════════════════");
+        screen_put(scr, 14, 0, "║          YOUR TURN!                 ║");
+        screen_put(scr, 15, 0, "═══════════════════════════════════════");
+        screen_put(scr, 16, 0, "┌────────────────────────────────────────────────────────────────┐");
+        screen_printf(scr, 17, 0, "│  %-62s│", "A-Z    guess that LETTER (+1 Mark, -1 Life if wrong)");
+        screen_printf(scr, 18, 0, "│  %-62s│", "Enter  type the WORD (+3 Marks, ELIMINATION if wrong)");
+        screen_printf(scr, 19, 0, "│  %-62s│", "?      ask for a HINT (once per round)");
+        screen_printf(scr, 20, 0, "│  %-62s│", "!      show your STATS (does not use up the turn)");
+        char warning[64];
+        snprintf(warning, sizeof(warning), "[WARNING: Timeout after %d seconds = -1 Mark!]", s->turn_seconds);
+        screen_printf(scr, 21, 0, "│  %-62s│", warning);
+        screen_put(scr, 22, 0, "└────────────────────────────────────────────────────────────────┘");
+
+        long long left = (s->turn_deadline - clock_ms() + 999) / 1000;
+        if (left < 0) left = 0;
+        int col;
+        if (s->typing_chat) {
+            col = screen_printf(scr, 23, 0, "[%2llds] Say: ", left);
+            col += screen_put(scr, 23, col, s->chat);
+        } else if (s->typing_word) {
+            col = screen_printf(scr, 23, 0, "[%2llds] Enter sends, Esc goes back. Word: ", left);
+            col += screen_put(scr, 23, col, s->word);
+        } else {
+            col = screen_printf(scr, 23, 0, "[%2llds] Your choice: ", left);
+        }
+        screen_cursor(scr, 23, col);
+        return;
+    }
+
+    if (s->game_over) {
+        screen_printf(scr, 13, 0, "*** GAME ENDED! Final score: %d ***", s->score);
+        screen_put(scr, 14, 0, s->in_tournament ? "Waiting for the heat results..."
+                                                : "Check final_scores.txt for rankings and winner!");
+    } else if (s->is_eliminated) {
+        screen_put(scr, 13, 0, "*** ELIMINATED - Spectating ***");
+        screen_printf(scr, 14, 0, "%s is currently playing...", s->current_turn_player);
+    } else if (strcmp(s->current_turn_player, s->my_name) == 0) {
+        screen_put(scr, 13, 0, "*** Your turn is coming up ***");
+    } else {
+        screen_printf(scr, 13, 0, "*** %s's TURN ***", s->current_turn_player);
+        screen_printf(scr, 14, 0, "Waiting for %s to make a move...", s->current_turn_player);
+    }
+
+    int first = s->event_count > EVENT_LINES ? s->event_count - EVENT_LINES : 0;
+    for (int i = first; i < s->event_count; i++) {
+        screen_put(scr, 16 + i - first, 0, s->events[i % EVENT_LINES]);
+    }
+    if (s->typing_chat) {
+        screen_put(scr, 23, 0, "Say: ");
+        screen_cursor(scr, 23, 5 + screen_put(scr, 23, 5, s->chat));
+    } else {
+        screen_put(scr, 23, 0, "Press ! for your stats, Tab to chat.");
+        screen_cursor(scr, 23, 36);
+    }
+}
+
+void end_turn(ClientState *s, int tfd) {
+    s->my_turn = 0;
+    s->typing_word = 0;
+    arm_timer(tfd, 0);
+}
+
+// PROMPT:<deadline>|<now>|<rtt> gives the deadline in the server's clock
+// and its clock when it sent the line. Only the difference is used, from
+// our own receive time, less the round trip: half of it has passed already
+// and our move needs the other half to get back.
+void start_turn(ClientState *s, int tfd, const char *args) {
+    long long deadline = 0, sent = 0;
+    int rtt = 0;
+    long long left = TURN_SECONDS * 1000;
+    if (args && sscanf(args, "%lld|%lld|%d", &deadline, &sent, &rtt) == 3 && deadline > sent) {
+        s->turn_seconds = (deadline - sent + 999) / 1000;
+        left = deadline - sent - rtt;
+        if (left < 1) left = 1;
+    } else {
+        s->turn_seconds = TURN_SECONDS;
+    }
+    s->my_turn = 1;
+    s->typing_word = 0;
+    s->word_len = 0;
+    s->word[0] = '\0';
+    s->turn_deadline = clock_ms() + left;
+    arm_timer(tfd, left);
+}
+
+// The Esc key: closes the chat line, or else leaves word entry
+void escape_key(ClientState *s) {
+    s->frame_due = 1;
+    if (s->typing_chat) s->typing_chat = 0;
+    else if (s->my_turn) s->typing_word = 0;
+}
+
+// Arrow and function keys arrive as ESC [ or ESC O, parameter bytes and a
+// final byte in 0x40-0x7E; all of it is swallowed. An ESC left on its own
+// is taken as Esc by the main loop once ESC_WAIT_MS pass. Returns 1 if c
+// belongs to an escape sequence.
+int escape_byte(ClientState *s, int c) {
+    if (s->escape == KEY_SEQUENCE) {
+        if (c >= 0x40 && c <= 0x7E) s->escape = KEY_PLAIN;
+        return 1;
+    }
+    if (s->escape == KEY_ESC) {
+        s->escape = KEY_PLAIN;
+        if (c == '[' || c == 'O') {
+            s->escape = KEY_SEQUENCE;
+            return 1;
         }
-        
-        printf("\r%s[Time left: %d sec] ", prompt, time_left);
-        fflush(stdout);
-        
-        FD_ZERO(&readfds);
-        FD_SET(STDIN_FILENO, &readfds);
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
-        
-        int ready = select(STDIN_FILENO + 1, &readfds, NULL, NULL, &tv);
-        
-        if (ready > 0) {
-            if (fgets(buffer, max_len, stdin) != NULL) {
-                buffer[strcspn(buffer, "\n")] = '\0';
-                printf("\n");
-                return 1;
+        escape_key(s);      // Esc, then an ordinary key typed right after it
+    }
+    if (c == 27) {
+        s->escape = KEY_ESC;
+        s->escape_at = clock_ms();
+        return 1;
+    }
+    return 0;
+}
+
+void handle_key(ClientState *s, int sock, int tfd, int c) {
+    char msg[WORD_LEN + 16];
+    s->frame_due = 1;
+    if (escape_byte(s, c)) return;
+
+    // Chat goes out whatever else is going on and never ends a turn
+    if (s->typing_chat) {
+        if (c == '\n' || c == '\r') {
+            if (s->chat_len > 0) {
+                char line[CHAT_TEXT_MAX + 8];
+                snprintf(line, sizeof(line), "CHAT:%s\n", s->chat);
+                send_text(sock, line);
             }
-        } else if (ready < 0) {
-            perror("select");
-            return 0;
+            s->typing_chat = 0;
+        } else if ((c == 127 || c == 8) && s->chat_len > 0) {
+            s->chat[--s->chat_len] = '\0';
+        } else if (c >= 0x20 && c < 0x7F && c != '|' && s->chat_len < CHAT_TEXT_MAX) {
+            s->chat[s->chat_len++] = c;
+            s->chat[s->chat_len] = '\0';
+        }
+        return;
+    }
+    if (c == '\t') {
+        s->typing_chat = 1;
+        s->chat_len = 0;
+        s->chat[0] = '\0';
+        return;
+    }
+
+    if (!s->my_turn) {
+        if (c == '!') send_text(sock, "STATS\n");
+        return;
+    }
+
+    if (s->typing_word) {
+        if (c == '\n' || c == '\r') {
+            if (s->word_len == 0) return;
+            snprintf(msg, sizeof(msg), "WORD:%s\n", s->word);
+            send_text(sock, msg);
+            snprintf(s->notice, sizeof(s->notice), "✓ Sent word: %s", s->word);
+            end_turn(s, tfd);
+        } else if ((c == 127 || c == 8) && s->word_len > 0) {
+            s->word[--s->word_len] = '\0';
+        } else if (isalpha(c) && s->word_len < WORD_LEN - 1) {
+            s->word[s->word_len++] = toupper(c);
+            s->word[s->word_len] = '\0';
+        }
+        return;
+    }
+
+    if (isalpha(c)) {
+        snprintf(msg, sizeof(msg), "LETTER:%c\n", toupper(c));
+        send_text(sock, msg);
+        snprintf(s->notice, sizeof(s->notice), "✓ Sent letter: %c", toupper(c));
+        end_turn(s, tfd);
+    } else if (c == '\n' || c == '\r') {
+        s->typing_word = 1;
+    } else if (c == '?') {
+        if (s->hint_used) {
+            snprintf(s->notice, sizeof(s->notice), "Hint already used this round.");
+            return;
+        }
+        send_text(sock, "HINT\n");
+        s->hint_used = 1;
+    } else if (c == '!') {
+        send_text(sock, "STATS\n");
+    }
+}
+
+// Applies one server line to the state; the next frame shows it.
+// Returns 0 once the session is over.
+int handle_line(ClientState *s, int sock, int tfd, char *buffer) {
+    // Heartbeat: echoed at once, nothing to draw
+    if (strncmp(buffer, "PING", 4) == 0) {
+        char pong[64];
+        snprintf(pong, sizeof(pong), "PONG%.50s\n", buffer + 4);
+        send_text(sock, pong);
+        return 1;
+    }
+    s->frame_due = 1;
+
+    // === BOARD UPDATE ===
+    if (strncmp(buffer, "BOARD:", 6) == 0) {
+        snprintf(s->answer_space, ANSWER_SIZE, "%s", buffer + 6);
+    }
+    // === TURN ANNOUNCEMENT ===
+    else if (strncmp(buffer, "TURN:", 5) == 0) {
+        snprintf(s->current_turn_player, NAME_SIZE, "%s", buffer + 5);
+        if (s->my_turn && strcmp(s->current_turn_player, s->my_name) != 0) end_turn(s, tfd);
+    }
+    // === PROMPT ===
+    else if (strncmp(buffer, "PROMPT", 6) == 0 && (buffer[6] == '\0' || buffer[6] == ':')) {
+        // CRITICAL: Check server's elimination status, not local flag
+        if (strcmp(s->current_turn_player, s->my_name) == 0 && !s->is_eliminated) {
+            start_turn(s, tfd, buffer[6] ? buffer + 7 : NULL);
+        }
+    }
+    // === RESULTS ===
+    else if (strcmp(buffer, "CORRECT_LETTER") == 0) {
+        s->score += 1;
+        snprintf(s->notice, sizeof(s->notice), "✓ CORRECT LETTER! +1 Mark earned");
+    }
+    else if (strcmp(buffer, "WRONG_LETTER") == 0) {
+        s->lives -= 1;
+        snprintf(s->notice, sizeof(s->notice), "✗ WRONG LETTER! -1 Life lost");
+    }
+    else if (strcmp(buffer, "CORRECT_WORD") == 0) {
+        s->score += 3;
+        snprintf(s->notice, sizeof(s->notice), "★★★ CORRECT WORD! +3 Marks, round complete ★★★");
+    }
+    else if (strcmp(buffer, "WRONG_WORD") == 0) {
+        s->is_eliminated = 1;
+        s->lives = 0;
+        snprintf(s->notice, sizeof(s->notice), "✗✗✗ WRONG WORD! You are eliminated, still spectating ✗✗✗");
+    }
+    else if (strcmp(buffer, "TIMEOUT") == 0) {
+        s->score -= 1;
+        end_turn(s, tfd);
+        snprintf(s->notice, sizeof(s->notice), "YOU TIMED OUT! -1 Mark penalty");
+    }
+    else if (strcmp(buffer, "INVALID") == 0) {
+        snprintf(s->notice, sizeof(s->notice), "*** Invalid move! ***");
+    }
+    else if (strcmp(buffer, "ELIMINATED") == 0) {
+        s->is_eliminated = 1;
+        s->lives = 0;
+        snprintf(s->notice, sizeof(s->notice), "YOU ARE ELIMINATED! You can still spectate...");
+    }
+    else if (strncmp(buffer, "HINT:", 5) == 0) {
+        char letter = '-';
+        int remaining = 0;
+        sscanf(buffer + 5, "%c|%d", &letter, &remaining);
+        snprintf(s->notice, sizeof(s->notice), "Hint: try '%c' (%d possible words left)", letter, remaining);
+    }
+    // CHAT:name|text|name|text... once per flush
+    else if (strncmp(buffer, "CHAT:", 5) == 0) {
+        char *save = NULL;
+        char *name = strtok_r(buffer + 5, "|", &save);
+        char *text;
+        while (name && (text = strtok_r(NULL, "|", &save))) {
+            add_event(s, "<%s> %s", name, text);
+            name = strtok_r(NULL, "|", &save);
+        }
+    }
+    else if (strncmp(buffer, "STATS:", 6) == 0) {
+        if (strcmp(buffer + 6, "NONE") == 0) {
+            add_event(s, "No stats recorded yet.");
+        } else {
+            for (char *p = buffer + 6; *p; p++) if (*p == '|') *p = ' ';
+            add_event(s, "Stats for %s", buffer + 6);
+        }
+    }
+    // === STATE UPDATE - CRITICAL: Parse elimination status ===
+    else if (strncmp(buffer, "STATE:", 6) == 0) {
+        int old_round = s->round;
+        int eliminated_flag = 0;
+
+        // Parse: STATE:R3|L1|S5|E0  (E0=active, E1=eliminated)
+        sscanf(buffer + 6, "R%d|L%d|S%d|E%d",
+               &s->round, &s->lives, &s->score, &eliminated_flag);
+        s->is_eliminated = eliminated_flag;  // SYNC FROM SERVER
+
+        if (s->round != old_round) {
+            s->hint_used = 0;
+            snprintf(s->notice, sizeof(s->notice), "ROUND %d STARTING! Lives reset to 3", s->round);
         }
     }
+    // === ROUND SCORES ===
+    else if (strncmp(buffer, "ROUND_SCORES:", 13) == 0) {
+        s->scores_round = s->round;
+        s->score_count = 0;
+        for (char *token = strtok(buffer + 13, "|"); token && s->score_count < MAX_PLAYERS;
+             token = strtok(NULL, "|")) {
+            snprintf(s->scores[s->score_count++], sizeof(s->scores[0]), "%s", token);
+        }
+    }
+    else if (strncmp(buffer, "REVEAL:", 7) == 0) {
+        end_turn(s, tfd);
+        snprintf(s->notice, sizeof(s->notice), "ROUND %d ENDED - THE ANSWER WAS: %s", s->round, buffer + 7);
+        add_event(s, "Round %d: the answer was %s", s->round, buffer + 7);
+    }
+    else if (strcmp(buffer, "END") == 0) {
+        end_turn(s, tfd);
+        s->game_over = 1;
+        add_event(s, "Game ended, final score %d", s->score);
+        if (!s->in_tournament) return 0;
+    }
+    // === TOURNAMENT ===
+    else if (strncmp(buffer, "REGISTERED:", 11) == 0) {
+        int seed = 0, entrants = 0;
+        sscanf(buffer + 11, "%d|%d", &seed, &entrants);
+        s->in_tournament = 1;
+        add_event(s, "Registered for the tournament: seed %d of %d, waiting for the draw", seed, entrants);
+    }
+    else if (strncmp(buffer, "SPECTATING:", 11) == 0) {
+        s->in_tournament = 1;
+        add_event(s, "Not on the roster, watching the tournament (%s entrants)", buffer + 11);
+    }
+    else if (strncmp(buffer, "STAGE:", 6) == 0) {
+        int stage = 0, heats = 0, players = 0;
+        sscanf(buffer + 6, "%d|%d|%d", &stage, &heats, &players);
+        add_event(s, "=== Stage %d: %d players in %d heat(s) ===", stage, players, heats);
+    }
+    else if (strncmp(buffer, "HEAT:", 5) == 0) {
+        int stage = 0, heat = 0, heats = 0;
+        sscanf(buffer + 5, "%d|%d|%d", &stage, &heat, &heats);
+        s->round = 1;
+        s->lives = 3;
+        s->score = 0;
+        s->is_eliminated = 0;
+        s->hint_used = 0;
+        s->game_over = 0;
+        s->score_count = 0;
+        s->answer_space[0] = '\0';
+        strcpy(s->current_turn_player, "Waiting...");
+        snprintf(s->notice, sizeof(s->notice), "*** Stage %d, heat %d of %d is starting ***", stage, heat, heats);
+    }
+    else if (strncmp(buffer, "HEAT_RESULT:", 12) == 0) {
+        int stage = 0, heat = 0, skip = 0;
+        sscanf(buffer + 12, "%d|%d|%n", &stage, &heat, &skip);
+        add_event(s, "Stage %d heat %d: %s", stage, heat, skip ? buffer + 12 + skip : "");
+    }
+    else if (strncmp(buffer, "ADVANCE:", 8) == 0) {
+        add_event(s, "*** You advance to stage %s! ***", buffer + 8);
+    }
+    else if (strncmp(buffer, "OUT:", 4) == 0) {
+        int stage = 0, place = 0;
+        sscanf(buffer + 4, "%d|%d", &stage, &place);
+        add_event(s, "Out in stage %d (place %d in the heat), following the rest", stage, place);
+    }
+    else if (strncmp(buffer, "CHAMPION:", 9) == 0) {
+        add_event(s, "*** TOURNAMENT CHAMPION: %s ***", buffer + 9);
+        return 0;
+    }
+    return 1;
 }
 
 int main() {
     int sock = 0;
     struct sockaddr_in serv_addr;
     ClientState state;
-    char buffer[256] = {0};
+    LineBuffer in;
+    static Screen screen;
+    char buffer[INBUF_SIZE];
 
     memset(&state, 0, sizeof(state));
+    memset(&in, 0, sizeof(in));
     state.round = 1;
     state.lives = 3;
     state.score = 0;
     state.is_eliminated = 0;  // Start as active
-    state.needs_display = 1;
-    state.waiting_for_prompt = 0;
     strcpy(state.current_turn_player, "Waiting...");
 
+    // Asked before connecting: the server wants NAME within seconds
+    printf("Enter your name: ");
+    fflush(stdout);
+    if (!fgets(state.my_name, NAME_SIZE, stdin)) return 1;
+    state.my_name[strcspn(state.my_name, "\n")] = 0;
+
     if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
         printf("Socket creation error\n");
         return -1;
@@ -154,335 +592,102 @@ int main() {
     printf("║   Connected to Word Guessing Server    ║\n");
     printf("╚════════════════════════════════════════╝\n\n");
 
-    printf("Enter your name: ");
-    fflush(stdout);
-    fgets(state.my_name, NAME_SIZE, stdin);
-    state.my_name[strcspn(state.my_name, "\n")] = 0;
-
     char name_msg[256];
     snprintf(name_msg, sizeof(name_msg), "NAME:%s\n", state.my_name);
-    send(sock, name_msg, strlen(name_msg), 0);
+    send_text(sock, name_msg);
+    snprintf(state.notice, sizeof(state.notice), "✓ Name sent: %s. Waiting for other players to join...", state.my_name);
+    state.frame_due = 1;
 
-    printf("\n✓ Name sent: %s\n", state.my_name);
-    printf("Waiting for other players to join...\n");
+    // Everything from here is driven by whichever of the socket, the
+    // keyboard or the countdown timer is ready; nothing blocks in between.
+    // Handlers only change the state, frames follow at most every
+    // SCREEN_FRAME_MS however fast updates arrive.
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (tfd < 0) {
+        perror("timerfd_create");
+        return 1;
+    }
+    fcntl(sock, F_SETFL, O_NONBLOCK);
+    enter_raw_mode();
+    screen_init(&screen);
 
-    int game_active = 1;
+    struct pollfd fds[3];
+    fds[0].fd = sock;
+    fds[0].events = POLLIN;
+    fds[1].fd = STDIN_FILENO;
+    fds[1].events = POLLIN;
+    fds[2].fd = tfd;
+    fds[2].events = POLLIN;
 
-    while (game_active) {
-        memset(buffer, 0, sizeof(buffer));
-        int valread = recvLine(sock, buffer, sizeof(buffer));
-        
-        if (valread <= 0) {
-            printf("\nDisconnected from server\n");
-            break;
-        }
+    int session_active = 1;
 
-        // === BOARD UPDATE ===
-        if (strncmp(buffer, "BOARD:", 6) == 0) {
-            strcpy(state.answer_space, buffer + 6);
-            
-            if (!state.waiting_for_prompt && strcmp(state.current_turn_player, state.my_name) != 0) {
-                clear_screen();
-                displayGameState(&state);
-                if (!state.is_eliminated) {
-                    printf("\n*** %s's TURN ***\n", state.current_turn_player);
-                    printf("Waiting for %s to make a move...\n", state.current_turn_player);
-                } else {
-                    printf("\n*** ELIMINATED - Spectating ***\n");
-                    printf("%s is currently playing...\n", state.current_turn_player);
-                }
-            }
-            continue;
+    while (session_active) {
+        int wait_ms = -1;
+        if (state.frame_due) {
+            long long until = screen.last_flush + SCREEN_FRAME_MS - clock_ms();
+            wait_ms = until > 0 ? until : 0;
         }
-
-        // === TURN ANNOUNCEMENT ===
-        if (strncmp(buffer, "TURN:", 5) == 0) {
-            strcpy(state.current_turn_player, buffer + 5);
-            
-            if (strcmp(state.current_turn_player, state.my_name) == 0) {
-                state.waiting_for_prompt = 1;
-            } else {
-                state.waiting_for_prompt = 0;
-                if (!state.is_eliminated) {
-                    clear_screen();
-                    displayGameState(&state);
-                    printf("\n*** %s's TURN ***\n", state.current_turn_player);
-                    printf("Waiting for %s to make a move...\n", state.current_turn_player);
-                }
-            }
-            continue;
+        if (state.escape == KEY_ESC) {
+            long long until = state.escape_at + ESC_WAIT_MS - clock_ms();
+            if (until < 0) until = 0;
+            if (wait_ms < 0 || until < wait_ms) wait_ms = until;
+        }
+        if (poll(fds, 3, wait_ms) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
         }
 
-        // === PROMPT ===
-        if (strcmp(buffer, "PROMPT") == 0) {
-            if (strcmp(state.current_turn_player, state.my_name) != 0) {
-                printf("[ERROR] Received PROMPT but not my turn!\n");
-                continue;
-            }
-            
-            // CRITICAL: Check server's elimination status, not local flag
-            if (state.is_eliminated) {
-                printf("\n[DEBUG] Received PROMPT but server says eliminated (E=%d)\n", state.is_eliminated);
-                printf("You are eliminated. Spectating...\n");
-                continue;
-            }
-
-            state.waiting_for_prompt = 0;
-            clear_screen();
-            displayGameState(&state);
-            
-            printf("\n");
-            printf("═══════════════════════════════════════\n");
-            printf("║          YOUR TURN!                 ║\n");
-            printf("═══════════════════════════════════════\n");
-
-            displayMenu();
-            
-            int valid_choice = 0;
-            int choice;
-            int retry_count = 0;
-            
-            while (!valid_choice && retry_count < MAX_RETRIES) {
-                if (scanf("%d", &choice) != 1) {
-                    while (getchar() != '\n');
-                    retry_count++;
-                    printf("\nInvalid input! Please enter 1 or 2. ");
-                    printf("(Attempt %d/%d)\n", retry_count, MAX_RETRIES);
-                    
-                    if (retry_count >= MAX_RETRIES) {
-                        printf("\nToo many invalid attempts! Turn forfeited.\n");
-                        break;
-                    }
-                    printf("\nYour choice (1 or 2): ");
-                    continue;
-                }
-                while (getchar() != '\n');
-
-                if (choice == 1 || choice == 2) {
-                    valid_choice = 1;
-                } else {
-                    retry_count++;
-                    printf("\nInvalid choice! Must be 1 or 2. ");
-                    printf("(Attempt %d/%d)\n", retry_count, MAX_RETRIES);
-                    
-                    if (retry_count >= MAX_RETRIES) {
-                        printf("\nToo many invalid attempts! Turn forfeited.\n");
-                        break;
-                    }
-                    printf("\nYour choice (1 or 2): ");
-                }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            int n = fill_lines(sock, &in);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                add_event(&state, "Disconnected from server");
+                break;
             }
-
-            if (!valid_choice) {
-                printf("\nTurn skipped.\n");
-                send(sock, "LETTER:X\n", 9, 0);
-                continue;
+            while (session_active && next_line(&in, buffer, sizeof(buffer)) >= 0) {
+                session_active = handle_line(&state, sock, tfd, buffer);
             }
+        }
 
-            clear_screen();
-            displayGameState(&state);
-            printf("\n");
-            
-            if (choice == 1) {
-                char input[10];
-                int got_input = get_input_with_timer(input, sizeof(input), 15, 
-                                                     "Enter a letter: ");
-                
-                if (got_input) {
-                    if (strlen(input) == 1 && isalpha(input[0])) {
-                        char move_msg[20];
-                        snprintf(move_msg, sizeof(move_msg), "LETTER:%c\n", input[0]);
-                        send(sock, move_msg, strlen(move_msg), 0);
-                        printf("✓ Sent letter: %c\n", input[0]);
-                    } else {
-                        printf("\nInvalid input! Must be a single letter. Turn wasted.\n");
-                        send(sock, "LETTER:X\n", 9, 0);
-                    }
-                }
-            } else if (choice == 2) {
-                char word[WORD_LEN];
-                int got_input = get_input_with_timer(word, sizeof(word), 15, 
-                                                     "Enter the word: ");
-                
-                if (got_input) {
-                    char move_msg[30];
-                    snprintf(move_msg, sizeof(move_msg), "WORD:%s\n", word);
-                    send(sock, move_msg, strlen(move_msg), 0);
-                    printf("✓ Sent word: %s\n", word);
-                }
+        if (session_active && (fds[1].revents & (POLLIN | POLLHUP))) {
+            char keys[64];
+            int n = read(STDIN_FILENO, keys, sizeof(keys));
+            if (n <= 0) {
+                fds[1].fd = -1;     // stdin closed, keep following the game
             }
-            
-            state.needs_display = 1;
-        }
-        // === RESULTS ===
-        else if (strcmp(buffer, "CORRECT_LETTER") == 0) {
-            clear_screen();
-            displayGameState(&state);
-            printf("\n");
-            printf("╔═══════════════════════════════════════╗\n");
-            printf("║                                       ║\n");
-            printf("║       ✓ CORRECT LETTER!               ║\n");
-            printf("║                                       ║\n");
-            printf("║         +1 Mark Earned                ║\n");
-            printf("║                                       ║\n");
-            printf("╚═══════════════════════════════════════╝\n");
-            state.score += 1;
-            sleep(2);
-        }
-        else if (strcmp(buffer, "WRONG_LETTER") == 0) {
-            clear_screen();
-            displayGameState(&state);
-            printf("\n");
-            printf("╔═══════════════════════════════════════╗\n");
-            printf("║                                       ║\n");
-            printf("║       ✗ WRONG LETTER!                 ║\n");
-            printf("║                                       ║\n");
-            printf("║         -1 Life Lost                  ║\n");
-            printf("║                                       ║\n");
-            printf("╚═══════════════════════════════════════╝\n");
-            state.lives -= 1;
-            sleep(2);
-        }
-        else if (strcmp(buffer, "CORRECT_WORD") == 0) {
-            clear_screen();
-            displayGameState(&state);
-            printf("\n");
-            printf("╔═══════════════════════════════════════╗\n");
-            printf("║                                       ║\n");
-            printf("║    ★★★ CORRECT WORD! ★★★              ║\n");
-            printf("║                                       ║\n");
-            printf("║         +3 Marks Earned!              ║\n");
-            printf("║         Round Complete!               ║\n");
-            printf("║                                       ║\n");
-            printf("╚═══════════════════════════════════════╝\n");
-            state.score += 3;
-            sleep(3);
-        }
-        else if (strcmp(buffer, "WRONG_WORD") == 0) {
-            clear_screen();
-            displayGameState(&state);
-            printf("\n");
-            printf("╔═══════════════════════════════════════╗\n");
-            printf("║                                       ║\n");
-            printf("║       ✗✗✗ WRONG WORD! ✗✗✗             ║\n");
-            printf("║                                       ║\n");
-            printf("║         YOU ARE ELIMINATED!           ║\n");
-            printf("║                                       ║\n");
-            printf("╚═══════════════════════════════════════╝\n");
-            state.is_eliminated = 1;
-            state.lives = 0;
-            sleep(3);
-            printf("\nYou can still spectate the game...\n");
-        }
-        else if (strcmp(buffer, "TIMEOUT") == 0) {
-            clear_screen();
-            displayGameState(&state);
-            printf("\n");
-            printf("╔═══════════════════════════════════════╗\n");
-            printf("║                                       ║\n");
-            printf("║          YOU TIMED OUT!               ║\n");
-            printf("║                                       ║\n");
-            printf("║         -1 Mark Penalty               ║\n");
-            printf("║                                       ║\n");
-            printf("╚═══════════════════════════════════════╝\n");
-            state.score -= 1;
-            sleep(2);
+            for (int i = 0; i < n; i++) handle_key(&state, sock, tfd, (unsigned char)keys[i]);
         }
-        // === STATE UPDATE - CRITICAL: Parse elimination status ===
-        else if (strncmp(buffer, "STATE:", 6) == 0) {
-            int old_round = state.round;
-            int old_eliminated = state.is_eliminated;
-            int eliminated_flag = 0;
-            
-            // Parse: STATE:R3|L1|S5|E0  (E0=active, E1=eliminated)
-            sscanf(buffer + 6, "R%d|L%d|S%d|E%d", 
-                   &state.round, &state.lives, &state.score, &eliminated_flag);
-            
-            state.is_eliminated = eliminated_flag;  // SYNC FROM SERVER
-            
-            // Debug logging
-            if (state.is_eliminated != old_eliminated) {
-                printf("\n[STATUS CHANGE] Elimination: %d → %d (Lives: %d)\n", 
-                       old_eliminated, state.is_eliminated, state.lives);
-            }
-            
-            if (state.round != old_round) {
-                printf("\n╔═══════════════════════════════════════╗\n");
-                printf("║         ROUND %d STARTING!             ║\n", state.round);
-                printf("║         Lives Reset to 3               ║\n");
-                printf("║         Ready to play!                 ║\n");
-                printf("╚═══════════════════════════════════════╝\n");
-                sleep(2);
-            }
+        if (state.escape == KEY_ESC && clock_ms() - state.escape_at >= ESC_WAIT_MS) {
+            state.escape = KEY_PLAIN;
+            escape_key(&state);
         }
-        // === ROUND SCORES ===
-        else if (strncmp(buffer, "ROUND_SCORES:", 13) == 0) {
-            clear_screen();
-            printf("\n");
-            printf("╔═════════════════════════════════════════════════════════╗\n");
-            printf("║                   ROUND %d SUMMARY                      ║\n", state.round);
-            printf("╠═════════════════════════════════════════════════════════╣\n");
-            
-            char scores_copy[256];
-            strcpy(scores_copy, buffer + 13);
-            char *token = strtok(scores_copy, "|");
-            int player_num = 1;
-            
-            while (token != NULL && player_num <= 5) {
-                printf("║ Player %d: %-45s ║\n", player_num, token);
-                token = strtok(NULL, "|");
-                player_num++;
+
+        if (session_active && (fds[2].revents & POLLIN)) {
+            unsigned long long ticks;
+            if (read(tfd, &ticks, sizeof(ticks)) > 0 && state.my_turn) {
+                if (clock_ms() >= state.turn_deadline) {
+                    end_turn(&state, tfd);
+                    snprintf(state.notice, sizeof(state.notice), "*** TIME'S UP! Turn forfeited. ***");
+                }
+                state.frame_due = 1;
             }
-            
-            printf("╚═════════════════════════════════════════════════════════╝\n");
-            printf("\nPress Enter to continue...");
-            fflush(stdout);
-            getchar();
-        }
-        else if (strcmp(buffer, "INVALID") == 0) {
-            printf("\n*** Invalid move! ***\n");
-            sleep(1);
         }
-        else if (strcmp(buffer, "ELIMINATED") == 0) {
-            clear_screen();
-            printf("\n");
-            printf("╔═══════════════════════════════════════╗\n");
-            printf("║                                       ║\n");
-            printf("║        YOU ARE ELIMINATED!            ║\n");
-            printf("║                                       ║\n");
-            printf("╚═══════════════════════════════════════╝\n");
-            state.is_eliminated = 1;
-            state.lives = 0;
-            printf("\nYou can still spectate...\n");
-        }
-        else if (strncmp(buffer, "REVEAL:", 7) == 0) {
-            clear_screen();
-            printf("\n");
-            printf("╔═══════════════════════════════════════╗\n");
-            printf("║                                       ║\n");
-            printf("║             ROUND %d ENDED            ║\n", state.round);
-            printf("║                                       ║\n");
-            printf("║    THE ANSWER WAS: %-18s  ║\n", buffer + 7);
-            printf("║                                       ║\n");
-            printf("╚═══════════════════════════════════════╝\n");
-            sleep(2);
-        }
-        else if (strcmp(buffer, "END") == 0) {
-            printf("\n");
-            printf("╔═══════════════════════════════════════╗\n");
-            printf("║                                       ║\n");
-            printf("║            GAME ENDED!                ║\n");
-            printf("║                                       ║\n");
-            printf("║         Final Score: %-16d     ║\n", state.score);
-            printf("║                                       ║\n");
-            printf("║     Check final_scores.txt for        ║\n");
-            printf("║          rankings and winner!         ║\n");
-            printf("║                                       ║\n");
-            printf("╚═══════════════════════════════════════╝\n");
-            game_active = 0;
+
+        long long now = clock_ms();
+        if (state.frame_due && now - screen.last_flush >= SCREEN_FRAME_MS) {
+            render(&state, &screen);
+            screen_flush(&screen, STDOUT_FILENO, now);
+            state.frame_due = 0;
         }
     }
 
+    // Last frame at once, then leave the cursor below it
+    render(&state, &screen);
+    screen_cursor(&screen, SCREEN_ROWS - 1, 0);
+    screen_flush(&screen, STDOUT_FILENO, clock_ms());
+    printf("\n");
+    restore_terminal();
+    close(tfd);
     close(sock);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,561 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "dictionary.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+typedef struct {
+    char word[DICT_WORD_WIDTH];
+    int score;
+} LoadEntry;
+
+static int pack_word(char out[DICT_WORD_WIDTH], const char *in) {
+    int len = 0;
+    memset(out, 0, DICT_WORD_WIDTH);
+    while (in[len] && in[len] != '\n' && in[len] != '\r' && in[len] != ',') {
+        if (len >= DICT_WORD_WIDTH || !isalpha((unsigned char)in[len])) return 0;
+        out[len] = toupper((unsigned char)in[len]);
+        len++;
+    }
+    return len;
+}
+
+static int cmp_packed(const void *a, const void *b) {
+    return memcmp(a, b, DICT_WORD_WIDTH);
+}
+
+// Bit i set if slot[i] == c. One compare for the whole packed word.
+static inline uint32_t position_mask(const char *slot, char c) {
+#ifdef __SSE2__
+    __m128i w = _mm_loadu_si128((const __m128i *)slot);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(w, _mm_set1_epi8(c)));
+#else
+    uint32_t m = 0;
+    for (int i = 0; i < DICT_WORD_WIDTH; i++) {
+        if (slot[i] == c) m |= 1u << i;
+    }
+    return m;
+#endif
+}
+
+#define BLOOM_BITS_PER_WORD 10
+#define BLOOM_PROBES 7
+#define MPH_BUCKET_SIZE 4           // average keys per displacement bucket
+#define MPH_DIRECT 0x80000000u
+#define MPH_MAX_SEED 0x7FFFFFFFu
+
+static int build_buckets(Dictionary *d);
+static int build_lookup(Dictionary *d);
+
+int dict_load(Dictionary *d, const char *path, const char **extra, int extra_count) {
+    memset(d, 0, sizeof(*d));
+
+    size_t cap = 1024, n = 0;
+    LoadEntry *entries = malloc(cap * sizeof(LoadEntry));
+    if (!entries) return -1;
+
+    FILE *f = path ? fopen(path, "r") : NULL;
+    char line[256];
+    int i = 0;
+    while (1) {
+        const char *src;
+        if (f && fgets(line, sizeof(line), f)) {
+            src = line;
+        } else if (i < extra_count) {
+            src = extra[i++];
+        } else {
+            break;
+        }
+        if (n == cap) {
+            cap *= 2;
+            void *grown = realloc(entries, cap * sizeof(LoadEntry));
+            if (!grown) {
+                free(entries);
+                if (f) fclose(f);
+                return -1;
+            }
+            entries = grown;
+        }
+        int len = pack_word(entries[n].word, src);
+        if (len > 0) {
+            int score;
+            entries[n].score = DICT_UNSCORED;
+            if (src[len] == ',' && sscanf(src + len + 1, "%d", &score) == 1 && score >= 0 && score < 100) {
+                entries[n].score = score;
+            }
+            n++;
+        }
+    }
+    if (f) fclose(f);
+
+    qsort(entries, n, sizeof(LoadEntry), cmp_packed);
+    size_t unique = 0;
+    for (size_t j = 0; j < n; j++) {
+        if (unique == 0 || memcmp(entries[unique - 1].word, entries[j].word, DICT_WORD_WIDTH) != 0) {
+            entries[unique++] = entries[j];
+        }
+    }
+
+    d->count = unique;
+    d->bitset_words = (unique + 63) / 64;
+    d->words = malloc((unique ? unique : 1) * DICT_WORD_WIDTH);
+    d->lengths = malloc(unique ? unique : 1);
+    d->letter_masks = malloc((unique ? unique : 1) * sizeof(uint32_t));
+    d->letter_bits = calloc((size_t)(d->bitset_words ? d->bitset_words : 1) * DICT_ALPHABET, sizeof(uint64_t));
+    d->difficulty = malloc(unique ? unique : 1);
+    d->bucket_words = malloc((unique ? unique : 1) * sizeof(uint32_t));
+    if (!d->words || !d->lengths || !d->letter_masks || !d->letter_bits ||
+        !d->difficulty || !d->bucket_words) {
+        free(entries);
+        dict_free(d);
+        return -1;
+    }
+
+    for (size_t j = 0; j < unique; j++) {
+        memcpy(d->words[j], entries[j].word, DICT_WORD_WIDTH);
+        d->difficulty[j] = entries[j].score;
+
+        uint32_t mask = 0;
+        int len = 0;
+        while (len < DICT_WORD_WIDTH && d->words[j][len]) {
+            int c = d->words[j][len] - 'A';
+            mask |= 1u << c;
+            d->letter_bits[(j / 64) * DICT_ALPHABET + c] |= 1ULL << (j % 64);
+            len++;
+        }
+        d->lengths[j] = len;
+        d->letter_masks[j] = mask;
+    }
+    free(entries);
+
+    // Words without a stored score (new entries, built-in list) are scored now
+    if (dict_score(d, 0) < 0 || build_lookup(d) < 0) {
+        dict_free(d);
+        return -1;
+    }
+    return 0;
+}
+
+void dict_free(Dictionary *d) {
+    free(d->words);
+    free(d->lengths);
+    free(d->letter_masks);
+    free(d->letter_bits);
+    free(d->difficulty);
+    free(d->bucket_words);
+    free(d->bloom);
+    free(d->mph_seeds);
+    free(d->mph_slots);
+    memset(d, 0, sizeof(*d));
+}
+
+int dict_find(const Dictionary *d, const char *word) {
+    char key[DICT_WORD_WIDTH];
+    if (pack_word(key, word) <= 0) return -1;
+
+    int lo = 0, hi = (int)d->count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        int c = memcmp(d->words[mid], key, DICT_WORD_WIDTH);
+        if (c == 0) return mid;
+        if (c < 0) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+static const Dictionary *key_dict;
+static int key_pos;
+
+// Order words by length, then by every letter except the one at key_pos,
+// so words differing only at that position end up adjacent.
+static int cmp_wildcard(const void *a, const void *b) {
+    const char *x = key_dict->words[*(const uint32_t *)a];
+    const char *y = key_dict->words[*(const uint32_t *)b];
+    for (int i = 0; i < DICT_WORD_WIDTH; i++) {
+        if (i == key_pos) continue;
+        if (x[i] != y[i]) return (unsigned char)x[i] - (unsigned char)y[i];
+    }
+    return 0;
+}
+
+// Number of same-length words that differ from each word in exactly one
+// position, i.e. the candidates a player cannot tell apart by letters alone.
+static int count_neighbours(const Dictionary *d, uint32_t *neighbours) {
+    uint32_t *order = malloc((d->count ? d->count : 1) * sizeof(uint32_t));
+    if (!order) return -1;
+    memset(neighbours, 0, d->count * sizeof(uint32_t));
+
+    key_dict = d;
+    for (key_pos = 0; key_pos < DICT_WORD_WIDTH; key_pos++) {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < d->count; i++) {
+            if (d->lengths[i] > key_pos) order[n++] = i;
+        }
+        if (n < 2) break;
+        qsort(order, n, sizeof(uint32_t), cmp_wildcard);
+
+        uint32_t start = 0;
+        for (uint32_t i = 1; i <= n; i++) {
+            if (i == n || cmp_wildcard(&order[start], &order[i]) != 0) {
+                for (uint32_t j = start; j < i; j++) neighbours[order[j]] += i - start - 1;
+                start = i;
+            }
+        }
+    }
+    free(order);
+    return 0;
+}
+
+// Difficulty = surprisal of the distinct letters a player has to find,
+// given how many dictionary words contain each letter, plus the number of
+// one-letter neighbours. Normalized to 0-99 over the whole dictionary.
+int dict_score(Dictionary *d, int rescore_all) {
+    if (d->count == 0) return build_buckets(d);
+
+    uint32_t *neighbours = malloc(d->count * sizeof(uint32_t));
+    double *raw = malloc(d->count * sizeof(double));
+    if (!neighbours || !raw || count_neighbours(d, neighbours) < 0) {
+        free(neighbours);
+        free(raw);
+        return -1;
+    }
+
+    uint32_t contains[DICT_ALPHABET] = {0};
+    for (uint32_t i = 0; i < d->count; i++) {
+        uint32_t mask = d->letter_masks[i];
+        while (mask) {
+            contains[__builtin_ctz(mask)]++;
+            mask &= mask - 1;
+        }
+    }
+
+    double lo = 0, hi = 0;
+    for (uint32_t i = 0; i < d->count; i++) {
+        double info = 0;
+        uint32_t mask = d->letter_masks[i];
+        while (mask) {
+            info -= log2((double)contains[__builtin_ctz(mask)] / d->count);
+            mask &= mask - 1;
+        }
+        raw[i] = info + 1.5 * log2(1.0 + neighbours[i]);
+        if (i == 0 || raw[i] < lo) lo = raw[i];
+        if (i == 0 || raw[i] > hi) hi = raw[i];
+    }
+
+    for (uint32_t i = 0; i < d->count; i++) {
+        if (!rescore_all && d->difficulty[i] != DICT_UNSCORED) continue;
+        d->difficulty[i] = hi > lo ? (uint8_t)(99.0 * (raw[i] - lo) / (hi - lo)) : 50;
+    }
+
+    free(neighbours);
+    free(raw);
+    return build_buckets(d);
+}
+
+static int build_buckets(Dictionary *d) {
+    uint32_t fill[DICT_DIFFICULTY_BUCKETS] = {0};
+    for (uint32_t i = 0; i < d->count; i++) {
+        fill[d->difficulty[i] * DICT_DIFFICULTY_BUCKETS / 100]++;
+    }
+
+    d->bucket_start[0] = 0;
+    for (int b = 0; b < DICT_DIFFICULTY_BUCKETS; b++) {
+        d->bucket_start[b + 1] = d->bucket_start[b] + fill[b];
+        fill[b] = d->bucket_start[b];
+    }
+    for (uint32_t i = 0; i < d->count; i++) {
+        d->bucket_words[fill[d->difficulty[i] * DICT_DIFFICULTY_BUCKETS / 100]++] = i;
+    }
+    return 0;
+}
+
+// O(1) pick from the requested bucket, falling back to the nearest non-empty one
+int dict_sample(const Dictionary *d, int bucket, unsigned int r) {
+    if (bucket < 0) bucket = 0;
+    if (bucket >= DICT_DIFFICULTY_BUCKETS) bucket = DICT_DIFFICULTY_BUCKETS - 1;
+
+    for (int dist = 0; dist < DICT_DIFFICULTY_BUCKETS; dist++) {
+        int candidates[2] = { bucket - dist, bucket + dist };
+        for (int k = 0; k < (dist ? 2 : 1); k++) {
+            int b = candidates[k];
+            if (b < 0 || b >= DICT_DIFFICULTY_BUCKETS) continue;
+            uint32_t size = d->bucket_start[b + 1] - d->bucket_start[b];
+            if (size) return d->bucket_words[d->bucket_start[b] + r % size];
+        }
+    }
+    return -1;
+}
+
+static inline uint64_t hash_packed(const char *key, uint64_t seed) {
+    uint64_t a, b;
+    memcpy(&a, key, 8);
+    memcpy(&b, key + 8, 8);
+    uint64_t h = seed * 0x9E3779B97F4A7C15ULL ^ a;
+    h = (h ^ (h >> 31)) * 0xBF58476D1CE4E5B9ULL ^ b;
+    h = (h ^ (h >> 29)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 32);
+}
+
+static inline uint32_t mph_bucket(const Dictionary *d, uint64_t h) {
+    return (uint32_t)(((h >> 32) * (uint64_t)d->mph_buckets) >> 32);
+}
+
+static inline uint32_t mph_slot(const Dictionary *d, const char *key, uint32_t seed) {
+    if (seed & MPH_DIRECT) return seed & ~MPH_DIRECT;
+    return (uint32_t)((hash_packed(key, seed) & 0xFFFFFFFFu) * (uint64_t)d->count >> 32);
+}
+
+static uint32_t *sort_bucket;
+
+static int cmp_bucket_size(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    uint32_t sx = sort_bucket[x + 1] - sort_bucket[x];
+    uint32_t sy = sort_bucket[y + 1] - sort_bucket[y];
+    if (sx != sy) return sx > sy ? -1 : 1;
+    return x < y ? -1 : (x > y);
+}
+
+// Bloom filter plus a hash-and-displace minimal perfect hash: buckets are
+// placed largest first by searching a seed that sends all their keys to
+// free slots; single-key buckets store their slot directly.
+static int build_lookup(Dictionary *d) {
+    uint32_t n = d->count;
+    uint32_t bloom_bits = 64;
+    while (bloom_bits < (uint64_t)n * BLOOM_BITS_PER_WORD && bloom_bits < 0x80000000u) bloom_bits <<= 1;
+
+    d->bloom_mask = bloom_bits - 1;
+    d->mph_buckets = n / MPH_BUCKET_SIZE + 1;
+    d->bloom = calloc(bloom_bits / 64, sizeof(uint64_t));
+    d->mph_seeds = calloc(d->mph_buckets, sizeof(uint32_t));
+    d->mph_slots = malloc((n ? n : 1) * sizeof(uint32_t));
+
+    uint32_t *start = calloc(d->mph_buckets + 1, sizeof(uint32_t));
+    uint32_t *keys = malloc((n ? n : 1) * sizeof(uint32_t));
+    uint32_t *order = malloc(d->mph_buckets * sizeof(uint32_t));
+    uint8_t *taken = calloc(n ? n : 1, 1);
+    uint32_t *pending = malloc((n ? n : 1) * sizeof(uint32_t));
+    int rc = -1;
+
+    if (!d->bloom || !d->mph_seeds || !d->mph_slots || !start || !keys || !order || !taken || !pending) {
+        goto out;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t h = hash_packed(d->words[i], 0);
+        uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+        for (int k = 0; k < BLOOM_PROBES; k++) {
+            uint32_t bit = (h1 + k * h2) & d->bloom_mask;
+            d->bloom[bit / 64] |= 1ULL << (bit % 64);
+        }
+        start[mph_bucket(d, h) + 1]++;
+    }
+    for (uint32_t b = 0; b < d->mph_buckets; b++) start[b + 1] += start[b];
+
+    // Counting sort of word indices by bucket
+    memset(pending, 0, n * sizeof(uint32_t));
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t b = mph_bucket(d, hash_packed(d->words[i], 0));
+        keys[start[b] + pending[b]++] = i;
+    }
+
+    for (uint32_t b = 0; b < d->mph_buckets; b++) order[b] = b;
+    sort_bucket = start;
+    qsort(order, d->mph_buckets, sizeof(uint32_t), cmp_bucket_size);
+
+    uint32_t free_slot = 0;
+    for (uint32_t o = 0; o < d->mph_buckets; o++) {
+        uint32_t b = order[o];
+        uint32_t size = start[b + 1] - start[b];
+        if (size == 0) break;
+
+        if (size == 1) {
+            while (taken[free_slot]) free_slot++;
+            taken[free_slot] = 1;
+            d->mph_seeds[b] = MPH_DIRECT | free_slot;
+            d->mph_slots[free_slot] = keys[start[b]];
+            continue;
+        }
+
+        uint32_t seed;
+        for (seed = 1; seed <= MPH_MAX_SEED; seed++) {
+            uint32_t placed = 0;
+            for (; placed < size; placed++) {
+                uint32_t slot = mph_slot(d, d->words[keys[start[b] + placed]], seed);
+                if (taken[slot]) break;
+                taken[slot] = 1;
+                pending[placed] = slot;
+            }
+            if (placed == size) break;
+            while (placed > 0) taken[pending[--placed]] = 0;
+        }
+        if (seed > MPH_MAX_SEED) goto out;
+
+        d->mph_seeds[b] = seed;
+        for (uint32_t k = 0; k < size; k++) d->mph_slots[pending[k]] = keys[start[b] + k];
+    }
+    rc = 0;
+
+out:
+    free(start);
+    free(keys);
+    free(order);
+    free(taken);
+    free(pending);
+    return rc;
+}
+
+// Constant-time, allocation-free membership test. Returns the word index or -1.
+int dict_contains(const Dictionary *d, const char *word) {
+    char key[DICT_WORD_WIDTH];
+    if (d->count == 0 || pack_word(key, word) <= 0) return -1;
+
+    uint64_t h = hash_packed(key, 0);
+    uint32_t h1 = (uint32_t)h, h2 = (uint32_t)(h >> 32) | 1;
+    for (int k = 0; k < BLOOM_PROBES; k++) {
+        uint32_t bit = (h1 + k * h2) & d->bloom_mask;
+        if (!(d->bloom[bit / 64] & (1ULL << (bit % 64)))) return -1;
+    }
+
+    uint32_t idx = d->mph_slots[mph_slot(d, key, d->mph_seeds[mph_bucket(d, h)])];
+    return memcmp(d->words[idx], key, DICT_WORD_WIDTH) == 0 ? (int)idx : -1;
+}
+
+size_t solver_size(const Dictionary *d) {
+    return sizeof(SolverState) + (size_t)(d->bitset_words ? d->bitset_words : 1) * sizeof(uint64_t);
+}
+
+static void add_frequencies(SolverState *s, uint32_t mask) {
+    while (mask) {
+        s->letter_freq[__builtin_ctz(mask)]++;
+        mask &= mask - 1;
+    }
+}
+
+// Recount the candidate set. Sparse sets walk their members' letter masks,
+// dense ones popcount whole bitset words against the per-letter index.
+static void recount(SolverState *s, const Dictionary *d) {
+    uint32_t remaining = 0, nonzero = 0;
+    for (uint32_t w = 0; w < d->bitset_words; w++) {
+        if (s->bits[w]) {
+            remaining += __builtin_popcountll(s->bits[w]);
+            nonzero++;
+        }
+    }
+    s->remaining = remaining;
+    memset(s->letter_freq, 0, sizeof(s->letter_freq));
+
+    if (remaining * 4 < nonzero * DICT_ALPHABET) {
+        for (uint32_t w = 0; w < d->bitset_words; w++) {
+            uint64_t live = s->bits[w];
+            while (live) {
+                add_frequencies(s, d->letter_masks[w * 64 + __builtin_ctzll(live)]);
+                live &= live - 1;
+            }
+        }
+    } else {
+        for (uint32_t w = 0; w < d->bitset_words; w++) {
+            uint64_t live = s->bits[w];
+            if (!live) continue;
+            const uint64_t *lb = &d->letter_bits[(size_t)w * DICT_ALPHABET];
+            for (int c = 0; c < DICT_ALPHABET; c++) {
+                s->letter_freq[c] += __builtin_popcountll(live & lb[c]);
+            }
+        }
+    }
+}
+
+// Keep candidates whose positions of `letter` equal `expected`. A zero
+// `expected` means the letter is absent, which the letter index answers
+// a whole bitset word at a time without touching the packed words.
+static void filter_letter(SolverState *s, const Dictionary *d, char letter, uint32_t expected) {
+    int c = letter - 'A';
+
+    for (uint32_t w = 0; w < d->bitset_words; w++) {
+        uint64_t has = d->letter_bits[(size_t)w * DICT_ALPHABET + c];
+        if (!expected) {
+            s->bits[w] &= ~has;
+            continue;
+        }
+
+        uint64_t live = s->bits[w] & has;
+        uint64_t keep = live;
+        while (live) {
+            uint32_t idx = w * 64 + __builtin_ctzll(live);
+            live &= live - 1;
+            if (position_mask(d->words[idx], letter) != expected) {
+                keep &= ~(1ULL << (idx & 63));
+            }
+        }
+        s->bits[w] = keep;
+    }
+    recount(s, d);
+}
+
+void solver_reset(SolverState *s, const Dictionary *d, const char *answer_space) {
+    uint32_t len = strlen(answer_space);
+    s->word_len = len;
+    s->guessed_mask = 0;
+    s->absent_mask = 0;
+    memset(s->bits, 0, (size_t)d->bitset_words * sizeof(uint64_t));
+
+    for (uint32_t i = 0; i < d->count; i++) {
+        if (d->lengths[i] == len) s->bits[i / 64] |= 1ULL << (i % 64);
+    }
+    recount(s, d);
+
+    // Letters already on the board (e.g. a restored round) narrow the set too
+    for (uint32_t i = 0; i < len; i++) {
+        if (isalpha((unsigned char)answer_space[i])) {
+            solver_guess_letter(s, d, answer_space, answer_space[i]);
+        }
+    }
+}
+
+void solver_guess_letter(SolverState *s, const Dictionary *d, const char *answer_space, char letter) {
+    letter = toupper((unsigned char)letter);
+    if (letter < 'A' || letter > 'Z') return;
+
+    uint32_t bit = 1u << (letter - 'A');
+    if (s->guessed_mask & bit) return;
+    s->guessed_mask |= bit;
+
+    char board[DICT_WORD_WIDTH];
+    memset(board, 0, sizeof(board));
+    memcpy(board, answer_space, strnlen(answer_space, sizeof(board)));
+
+    uint32_t expected = position_mask(board, letter);
+    if (!expected) s->absent_mask |= bit;
+    filter_letter(s, d, letter, expected);
+}
+
+void solver_exclude_word(SolverState *s, const Dictionary *d, const char *word) {
+    int idx = dict_find(d, word);
+    if (idx < 0) return;
+
+    uint64_t bit = 1ULL << (idx % 64);
+    if (!(s->bits[idx / 64] & bit)) return;
+
+    s->bits[idx / 64] &= ~bit;
+    s->remaining--;
+    uint32_t mask = d->letter_masks[idx];
+    while (mask) {
+        s->letter_freq[__builtin_ctz(mask)]--;
+        mask &= mask - 1;
+    }
+}
+
+char solver_best_letter(const SolverState *s) {
+    int best = -1;
+    for (int i = 0; i < DICT_ALPHABET; i++) {
+        if (s->guessed_mask & (1u << i)) continue;
+        if (s->letter_freq[i] == 0) continue;
+        if (best < 0 || s->letter_freq[i] > s->letter_freq[best]) best = i;
+    }
+    return best < 0 ? 0 : 'A' + best;
+}
@@ -0,0 +1,51 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <stdint.h>
+
+#define DICT_WORD_WIDTH 16          // packed slot size, words longer than this are skipped
+#define DICT_ALPHABET 26
+#define DICT_DIFFICULTY_BUCKETS 10  // difficulty 0-99, ten points per bucket
+#define DICT_UNSCORED 0xFF
+
+typedef struct {
+    uint32_t count;
+    uint32_t bitset_words;          // (count + 63) / 64
+    char (*words)[DICT_WORD_WIDTH]; // uppercase, NUL padded, sorted, unique
+    uint8_t *lengths;
+    uint32_t *letter_masks;         // bit (c - 'A') set if the word contains c
+    uint64_t *letter_bits;          // [bitset word][letter]: words containing the letter
+    uint8_t *difficulty;            // 0 (easy) - 99 (hard), stored as "word,score" in the file
+    uint32_t bucket_start[DICT_DIFFICULTY_BUCKETS + 1];
+    uint32_t *bucket_words;         // word indices grouped by difficulty bucket
+    uint64_t *bloom;                // membership pre-check, ~1% false positives
+    uint32_t bloom_mask;            // bloom size in bits - 1 (power of two)
+    uint32_t mph_buckets;
+    uint32_t *mph_seeds;            // per-bucket displacement, high bit = direct slot
+    uint32_t *mph_slots;            // perfect hash slot -> word index
+} Dictionary;
+
+// Per-round candidate set. Lives in shared memory so every handler sees it.
+typedef struct {
+    uint32_t word_len;
+    uint32_t guessed_mask;
+    uint32_t absent_mask;
+    uint32_t remaining;
+    uint32_t letter_freq[DICT_ALPHABET];  // candidates containing each letter
+    uint64_t bits[];
+} SolverState;
+
+int dict_load(Dictionary *d, const char *path, const char **extra, int extra_count);
+void dict_free(Dictionary *d);
+int dict_find(const Dictionary *d, const char *word);
+int dict_contains(const Dictionary *d, const char *word);
+int dict_score(Dictionary *d, int rescore_all);
+int dict_sample(const Dictionary *d, int bucket, unsigned int r);
+
+size_t solver_size(const Dictionary *d);
+void solver_reset(SolverState *s, const Dictionary *d, const char *answer_space);
+void solver_guess_letter(SolverState *s, const Dictionary *d, const char *answer_space, char letter);
+void solver_exclude_word(SolverState *s, const Dictionary *d, const char *word);
+char solver_best_letter(const SolverState *s);
+
+#endif
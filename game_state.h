@@ -0,0 +1,278 @@
+#ifndef GAME_STATE_H
+#define GAME_STATE_H
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+// Shared-memory layout used by the server and its forked processes.
+// Data written on every turn is kept on its own cache lines, away from
+// the locks and from data that is written once and then only read.
+
+#define MAX_CLIENTS 5               // seats per room
+#define WORD_LEN 20
+#define NAME_SIZE 50
+#define ANSWER_SIZE 50
+#define LOG_CAPACITY 2000
+#define SCORE_CAPACITY 100
+#define RESULT_QUEUE_CAPACITY 16
+#define MAX_ROUNDS 8                // words kept per game for the history store
+#define MAX_MOVES 256               // moves kept per game, later ones are not recorded
+#define OUT_SLAB_SIZE 512           // bytes per pooled outbound buffer
+#define OUT_SLAB_COUNT 256
+#define OUT_HIGH_WATERMARK 16384    // queued bytes before a client is demoted to spectator
+#define OUT_LOW_WATERMARK 4096      // queued bytes before it is restored
+#define OUT_HARD_LIMIT 32768        // messages beyond this are dropped
+#define OUT_STALL_MS 5000           // time over the high watermark before disconnect
+
+#define CACHE_LINE 64
+#define CACHE_ALIGNED __attribute__((aligned(CACHE_LINE)))
+
+enum {
+    MOVE_LETTER_HIT,
+    MOVE_LETTER_MISS,
+    MOVE_WORD_HIT,
+    MOVE_WORD_MISS,
+    MOVE_INVALID,
+    MOVE_TIMEOUT,
+    MOVE_HINT
+};
+
+typedef struct {
+    unsigned char round;
+    unsigned char player;           // seat index
+    unsigned char kind;             // MOVE_*
+    char letter;                    // guessed or hinted letter, 0 for words
+} MoveRecord;
+
+// Cold per-player data, written once when the player joins
+typedef struct {
+    int socket;
+    int stats_row;                  // row in the analytics columns, -1 = none
+    char name[NAME_SIZE];
+} Player;
+
+// Read-mostly copy of the engine state, published through a seqlock so
+// pollers and state broadcasts never take the writer lock.
+typedef struct {
+    int round;
+    int current_player;
+    int turn_in_progress;
+    int volley_open;
+    int game_started;
+    int game_finished;
+    int player_count;
+    char answer_space[ANSWER_SIZE];
+    struct {
+        int total_score;
+        int round_lives;
+        int round_eliminated;
+        int ready;
+        int connected;
+    } players[MAX_CLIENTS];
+} GameSnapshot;
+
+typedef struct {
+    // Engine writer lock: word, board, turns, scores, lives
+    pthread_mutex_t lock CACHE_ALIGNED;
+
+    // Turn state, rewritten every turn
+    int current_player CACHE_ALIGNED;
+    int turn_in_progress;
+    int round;
+    int game_started;
+    int game_finished;
+    int frozen;                 // being handed to a new server, no turn may start
+    int difficulty;             // dictionary difficulty bucket for the next word
+    int turn;                   // turns granted so far, correlates trace spans
+
+    // Simultaneous rounds: each active player's guess for the open volley,
+    // held until the scheduler resolves them together
+    int volley_open CACHE_ALIGNED;
+    int submit_seq;                 // guesses received so far in this volley
+    long long volley_opened;        // CLOCK_MONOTONIC ms
+    long long volley_deadline;
+    int pending_seq[MAX_CLIENTS];   // order the guess arrived in, 0 = none yet
+    char pending[MAX_CLIENTS][WORD_LEN + 8];    // the move line as sent
+
+    // Per-player hot state, one array per field (struct of arrays)
+    int ready[MAX_CLIENTS] CACHE_ALIGNED;
+    int round_lives[MAX_CLIENTS];
+    int round_eliminated[MAX_CLIENTS];
+    int total_score[MAX_CLIENTS];
+    int connected[MAX_CLIENTS];
+    int hint_used[MAX_CLIENTS];
+
+    // Wrong guesses of the current round, replayed into the solver when
+    // the room is resumed under another process
+    unsigned int missed_letters;    // bit per letter, A = bit 0
+    char missed_words[MAX_CLIENTS][WORD_LEN];   // a wrong word eliminates, so one per seat
+
+    // When each handler last read anything from its client, checked by
+    // the flusher against the heartbeat deadline
+    long long last_heard[MAX_CLIENTS] CACHE_ALIGNED;   // CLOCK_MONOTONIC ms
+    int rtt_ms[MAX_CLIENTS];        // smoothed PING round trip, 0 = not measured
+
+    // Published snapshot, read by every poller
+    unsigned int snapshot_seq CACHE_ALIGNED;    // odd while a writer is publishing
+    GameSnapshot snapshot;
+
+    // Board, rewritten on correct guesses only
+    char word[WORD_LEN] CACHE_ALIGNED;
+    char answer_space[ANSWER_SIZE];
+    unsigned int letter_masks[26];  // positions of each letter in word
+
+    // Roster, written when players join
+    pthread_mutex_t roster_lock CACHE_ALIGNED;  // slot assignment: socket, player_count
+    int player_count;
+    Player players[MAX_CLIENTS];
+
+    // Current game for the history store, appended under lock
+    char round_words[MAX_ROUNDS][WORD_LEN] CACHE_ALIGNED;
+    int move_count;
+    MoveRecord moves[MAX_MOVES];
+
+    pthread_mutexattr_t lock_attr;
+    pthread_mutexattr_t roster_lock_attr;
+} GameState;
+
+typedef struct {
+    char message[512];
+    time_t timestamp;
+} LogEntry;
+
+typedef struct {
+    pthread_mutex_t lock CACHE_ALIGNED;
+    pthread_mutexattr_t lock_attr;
+    int count CACHE_ALIGNED;    // polled by the logger thread
+    LogEntry entries[LOG_CAPACITY] CACHE_ALIGNED;
+} LogBuffer;
+
+typedef struct {
+    char data[OUT_SLAB_SIZE];
+    int len;
+    int next;                   // next buffer in the queue, -1 = end
+} OutBuffer;
+
+typedef struct {
+    int head;                   // slab indices, -1 = empty
+    int tail;
+    int offset;                 // bytes of head already sent
+    int queued_bytes;
+    int lagging;                // over the high watermark, spectating
+    long long lagging_since;
+    int dropped;
+} CACHE_ALIGNED OutQueue;
+
+// Per-connection outbound queues. Any process enqueues, the flusher thread
+// in the main process (which owns every socket) writes without blocking.
+typedef struct {
+    pthread_mutex_t lock CACHE_ALIGNED;
+    pthread_mutexattr_t lock_attr;
+    int free_head CACHE_ALIGNED;
+    OutQueue queues[MAX_CLIENTS];
+    OutBuffer slab[OUT_SLAB_COUNT] CACHE_ALIGNED;
+} OutboundPool;
+
+typedef struct {
+    char player_name[NAME_SIZE];
+    int wins;
+    int games;
+    int points;
+} ScoreRecord;
+
+typedef struct {
+    pthread_mutex_t lock CACHE_ALIGNED;
+    pthread_mutexattr_t lock_attr;
+    int count CACHE_ALIGNED;
+    ScoreRecord records[SCORE_CAPACITY];
+} ScoreData;
+
+// One finished game, players ranked best first
+typedef struct {
+    int player_count;
+    int rounds;
+    time_t finished;
+    char names[MAX_CLIENTS][NAME_SIZE];
+    int scores[MAX_CLIENTS];
+    int seats[MAX_CLIENTS];         // seat index of each ranked player, as in moves
+    int word_count;                 // rounds actually played
+    char words[MAX_ROUNDS][WORD_LEN];
+    int move_count;
+    MoveRecord moves[MAX_MOVES];
+} GameResult;
+
+// Standings of a tournament heat, one per room slot. The room worker writes
+// them just before it exits, however the game ended; main reads them once
+// it has reaped the room.
+typedef struct {
+    int heat;                       // heat index + 1, 0 = the room is not a heat
+    int player_count;
+    char names[MAX_CLIENTS][NAME_SIZE];
+    int scores[MAX_CLIENTS];
+} HeatResult;
+
+#define CHAT_BATCH_SIZE (OUT_SLAB_SIZE - 16)    // chat bytes a room sends per flush
+
+// Chat posted in a room slot since the last flush. The room's handlers and
+// the gateway append; the room's flusher thread takes it all as one line.
+typedef struct {
+    pthread_mutex_t lock CACHE_ALIGNED;
+    pthread_mutexattr_t lock_attr;
+    int room;                       // room id, 0 = no room in this slot
+    int len;
+    char text[CHAT_BATCH_SIZE];     // "name|text|name|text..."
+} ChatBox;
+
+// Finished games waiting for the persistence thread. Any process submits,
+// the thread commits everything queued with one durable write.
+typedef struct {
+    pthread_mutex_t lock CACHE_ALIGNED;
+    pthread_cond_t ready;           // results queued or shutdown requested
+    pthread_cond_t done;            // a batch was taken or committed
+    pthread_mutexattr_t lock_attr;
+    pthread_condattr_t cond_attr;
+    int head;
+    int count;
+    long long submitted;            // tickets handed out
+    long long committed;            // tickets durable on disk
+    GameResult results[RESULT_QUEUE_CAPACITY];
+} ResultQueue;
+
+// Writers hold g->lock, so there is only ever one publisher
+static inline void snapshot_publish(GameState *g) {
+    unsigned int seq = g->snapshot_seq;
+    __atomic_store_n(&g->snapshot_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    GameSnapshot *snap = &g->snapshot;
+    snap->round = g->round;
+    snap->current_player = g->current_player;
+    snap->turn_in_progress = g->turn_in_progress;
+    snap->volley_open = g->volley_open;
+    snap->game_started = g->game_started;
+    snap->game_finished = g->game_finished;
+    snap->player_count = g->player_count;
+    memcpy(snap->answer_space, g->answer_space, ANSWER_SIZE);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        snap->players[i].total_score = g->total_score[i];
+        snap->players[i].round_lives = g->round_lives[i];
+        snap->players[i].round_eliminated = g->round_eliminated[i];
+        snap->players[i].ready = g->ready[i];
+        snap->players[i].connected = g->connected[i];
+    }
+
+    __atomic_store_n(&g->snapshot_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static inline void snapshot_read(GameState *g, GameSnapshot *out) {
+    unsigned int before, after;
+    do {
+        before = __atomic_load_n(&g->snapshot_seq, __ATOMIC_ACQUIRE);
+        memcpy(out, &g->snapshot, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&g->snapshot_seq, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+}
+
+#endif
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "gateway.h"
+
+void feed_init(RoomFeed *f) {
+    memset(f, 0, sizeof(*f));
+    pthread_mutexattr_init(&f->lock_attr);
+    pthread_mutexattr_setpshared(&f->lock_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&f->lock, &f->lock_attr);
+}
+
+// Main, before forking the room into this slot
+void feed_open(RoomFeed *f, int room, const char *const *names, int n) {
+    pthread_mutex_lock(&f->lock);
+    int len = 0;
+    f->roster[0] = '\0';
+    for (int i = 0; i < n && len < FEED_ROSTER_SIZE; i++) {
+        len += snprintf(f->roster + len, FEED_ROSTER_SIZE - len, "%s%s", i ? "|" : "", names[i]);
+    }
+    __atomic_store_n(&f->head, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&f->closed, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&f->room, room, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&f->lock);
+}
+
+// Keeps the room id, so readers can still drain what it appended last
+void feed_close(RoomFeed *f) {
+    pthread_mutex_lock(&f->lock);
+    __atomic_store_n(&f->closed, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&f->lock);
+}
+
+// The room playing in this slot, 0 if none
+int feed_room(const RoomFeed *f) {
+    return __atomic_load_n(&f->closed, __ATOMIC_ACQUIRE) ? 0 : __atomic_load_n(&f->room, __ATOMIC_ACQUIRE);
+}
+
+// Any of the room's processes. Lines are stored whole, newline included,
+// so a reader never sees half of one.
+void feed_append(RoomFeed *f, const char *line) {
+    int len = strlen(line);
+    if (len > FEED_CAPACITY / 4) len = FEED_CAPACITY / 4;
+    pthread_mutex_lock(&f->lock);
+    uint64_t head = f->head;
+    for (int i = 0; i <= len; i++) {
+        f->data[(head + i) & (FEED_CAPACITY - 1)] = i < len ? line[i] : '\n';
+    }
+    __atomic_store_n(&f->head, head + len + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&f->lock);
+}
+
+// Copies whole lines from *pos on, at most size bytes, and advances *pos.
+// A reader the room has lapped skips what was overwritten. Returns the
+// bytes copied, or -1 once the room has exited and everything it appended
+// has been read, or the slot holds another room.
+int feed_read(RoomFeed *f, int room, uint64_t *pos, char *out, int size) {
+    if (feed_room(f) == room && __atomic_load_n(&f->head, __ATOMIC_ACQUIRE) == *pos) return 0;
+
+    pthread_mutex_lock(&f->lock);
+    if (f->room != room || (f->closed && f->head == *pos)) {
+        pthread_mutex_unlock(&f->lock);
+        return -1;
+    }
+    uint64_t head = f->head;
+    if (head - *pos > FEED_CAPACITY) {
+        *pos = head - FEED_CAPACITY;
+        while (*pos < head && f->data[(*pos)++ & (FEED_CAPACITY - 1)] != '\n');
+    }
+    int n = head - *pos < (uint64_t)size ? (int)(head - *pos) : size;
+    for (int i = 0; i < n; i++) out[i] = f->data[(*pos + i) & (FEED_CAPACITY - 1)];
+    pthread_mutex_unlock(&f->lock);
+
+    while (n > 0 && out[n - 1] != '\n') n--;
+    *pos += n;
+    return n;
+}
+
+// Bytes up to and including the blank line ending the headers, 0 if it
+// has not arrived yet
+int http_request_end(const char *buf, int len) {
+    for (int i = 3; i < len; i++) {
+        if (buf[i] == '\n' && buf[i - 1] == '\r' && buf[i - 2] == '\n' && buf[i - 3] == '\r') return i + 1;
+    }
+    return 0;
+}
+
+static int header_is(const char *name, const char *want) {
+    while (*name && *want && tolower((unsigned char)*name) == tolower((unsigned char)*want)) {
+        name++;
+        want++;
+    }
+    return *name == '\0' && *want == '\0';
+}
+
+// A GET with its headers, NUL terminated. A WebSocket upgrade has to be
+// complete (RFC 6455 version 13); anything else is served as plain HTTP.
+// Returns -1 for what is neither.
+int http_parse(char *buf, HttpRequest *req) {
+    memset(req, 0, sizeof(*req));
+    char *save = NULL;
+    char *line = strtok_r(buf, "\r\n", &save);
+    if (!line || strncmp(line, "GET ", 4) != 0) return -1;
+    char *path = line + 4;
+    char *end = strchr(path, ' ');
+    if (!end || end - path >= HTTP_PATH_SIZE || strncmp(end, " HTTP/1.1", 9) != 0) return -1;
+    memcpy(req->path, path, end - path);
+
+    int upgrade = 0, version = 0;
+    while ((line = strtok_r(NULL, "\r\n", &save))) {
+        char *value = strchr(line, ':');
+        if (!value) return -1;
+        *value++ = '\0';
+        value += strspn(value, " \t");
+        if (header_is(line, "Upgrade")) {
+            for (char *c = value; *c; c++) *c = tolower((unsigned char)*c);
+            upgrade = strstr(value, "websocket") != NULL;
+        } else if (header_is(line, "Sec-WebSocket-Version")) {
+            version = atoi(value);
+        } else if (header_is(line, "Sec-WebSocket-Key")) {
+            snprintf(req->key, sizeof(req->key), "%.*s", (int)strcspn(value, " \t"), value);
+        }
+    }
+    if (!upgrade) {
+        req->key[0] = '\0';
+        return 0;
+    }
+    return version == 13 && req->key[0] ? 0 : -1;
+}
+
+static uint32_t rol(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+// SHA-1 of a short message, for the handshake only
+static void sha1(const unsigned char *msg, size_t len, unsigned char *digest) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    size_t total = ((len + 8) / 64 + 1) * 64;
+    for (size_t off = 0; off < total; off += 64) {
+        unsigned char block[64];
+        for (int i = 0; i < 64; i++) {
+            size_t at = off + i;
+            if (at < len) block[i] = msg[at];
+            else if (at == len) block[i] = 0x80;
+            else if (at >= total - 8) block[i] = (unsigned char)((uint64_t)len * 8 >> (8 * (total - 1 - at)));
+            else block[i] = 0;
+        }
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)block[4 * i] << 24 | block[4 * i + 1] << 16 | block[4 * i + 2] << 8 | block[4 * i + 3];
+        }
+        for (int i = 16; i < 80; i++) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rol(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 20; i++) digest[i] = h[i / 4] >> (24 - 8 * (i % 4));
+}
+
+static void base64(const unsigned char *in, int len, char *out) {
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    int o = 0;
+    for (int i = 0; i < len; i += 3) {
+        uint32_t v = in[i] << 16 | (i + 1 < len ? in[i + 1] << 8 : 0) | (i + 2 < len ? in[i + 2] : 0);
+        out[o++] = digits[v >> 18 & 63];
+        out[o++] = digits[v >> 12 & 63];
+        out[o++] = i + 1 < len ? digits[v >> 6 & 63] : '=';
+        out[o++] = i + 2 < len ? digits[v & 63] : '=';
+    }
+    out[o] = '\0';
+}
+
+// The 101 response accepting a client's key. Returns its length.
+int ws_accept(const char *key, char *out, size_t size) {
+    char keyed[128];
+    unsigned char digest[20];
+    char accept[32];
+    int len = snprintf(keyed, sizeof(keyed), "%s258EAFA5-E914-47DA-95CA-C5AB0DC85B11", key);
+    sha1((const unsigned char *)keyed, len, digest);
+    base64(digest, sizeof(digest), accept);
+    return snprintf(out, size,
+                    "HTTP/1.1 101 Switching Protocols\r\n"
+                    "Upgrade: websocket\r\n"
+                    "Connection: Upgrade\r\n"
+                    "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+}
+
+// One unmasked, unfragmented server frame. out holds len + 4 bytes; lines
+// never reach the 64 KiB that would need a longer header.
+int ws_encode(int opcode, const char *payload, int len, char *out) {
+    int n = 0;
+    out[n++] = 0x80 | opcode;
+    if (len < 126) {
+        out[n++] = len;
+    } else {
+        out[n++] = 126;
+        out[n++] = len >> 8;
+        out[n++] = len & 0xFF;
+    }
+    memcpy(out + n, payload, len);
+    return n + len;
+}
+
+// One client frame from the front of buf, unmasked in place. Returns its
+// length, 0 if it has not all arrived, -1 for what this server does not
+// take: unmasked or fragmented frames, extensions, payloads over
+// WS_MAX_PAYLOAD.
+int ws_decode(unsigned char *buf, int len, int *opcode, char **payload, int *payload_len) {
+    if (len < 2) return 0;
+    int op = buf[0] & 0x0F;
+    if ((buf[0] & 0xF0) != 0x80 || !(buf[1] & 0x80)) return -1;
+    if (op != WS_TEXT && op != WS_BINARY && op != WS_CLOSE && op != WS_PING && op != WS_PONG) return -1;
+
+    int n = buf[1] & 0x7F;
+    int head = 2;
+    if (n == 127 || (n == 126 && op >= WS_CLOSE)) return -1;
+    if (n == 126) {
+        if (len < 4) return 0;
+        n = buf[2] << 8 | buf[3];
+        head = 4;
+    }
+    if (n > WS_MAX_PAYLOAD) return -1;
+    if (len < head + 4 + n) return 0;
+
+    unsigned char *mask = buf + head;
+    unsigned char *data = mask + 4;
+    for (int i = 0; i < n; i++) data[i] ^= mask[i & 3];
+    *opcode = op;
+    *payload = (char *)data;
+    *payload_len = n;
+    return head + 4 + n;
+}
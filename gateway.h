@@ -0,0 +1,52 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "game_state.h"
+
+// Browser gateway (-W). Every room slot has a feed in the shared arena:
+// the room appends each line it broadcasts, and the gateway process tails
+// the feeds, frames every line once and writes the same bytes to all the
+// WebSockets watching that room. Browsers that play are relayed onto
+// socket pairs, which the matchmaker takes like any TCP connection.
+
+#define FEED_CAPACITY 16384         // bytes of broadcast lines kept per room
+#define FEED_ROSTER_SIZE (MAX_CLIENTS * NAME_SIZE)
+#define WS_MAX_PAYLOAD 512          // larger client frames close the connection
+#define WS_FRAME_MAX (WS_MAX_PAYLOAD + 14)
+#define HTTP_REQUEST_MAX 2048
+#define HTTP_PATH_SIZE 128
+
+enum { WS_TEXT = 1, WS_BINARY = 2, WS_CLOSE = 8, WS_PING = 9, WS_PONG = 10 };
+
+typedef struct {
+    pthread_mutex_t lock CACHE_ALIGNED;
+    pthread_mutexattr_t lock_attr;
+    int room;                       // room id, 0 = no room in this slot
+    int closed;                     // the room exited, its lines stay readable
+    char roster[FEED_ROSTER_SIZE];  // "name|name|..."
+    uint64_t head CACHE_ALIGNED;    // bytes appended since the room opened
+    char data[FEED_CAPACITY] CACHE_ALIGNED;
+} RoomFeed;
+
+typedef struct {
+    char path[HTTP_PATH_SIZE];
+    char key[64];                   // Sec-WebSocket-Key, empty for plain HTTP
+} HttpRequest;
+
+void feed_init(RoomFeed *f);
+void feed_open(RoomFeed *f, int room, const char *const *names, int n);
+void feed_close(RoomFeed *f);
+int feed_room(const RoomFeed *f);
+void feed_append(RoomFeed *f, const char *line);
+int feed_read(RoomFeed *f, int room, uint64_t *pos, char *out, int size);
+
+int http_request_end(const char *buf, int len);
+int http_parse(char *buf, HttpRequest *req);
+int ws_accept(const char *key, char *out, size_t size);
+int ws_encode(int opcode, const char *payload, int len, char *out);
+int ws_decode(unsigned char *buf, int len, int *opcode, char **payload, int *payload_len);
+
+#endif
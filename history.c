@@ -0,0 +1,278 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "history.h"
+
+#define RECORD_MAX (sizeof(HistRecord) + HISTORY_MAX_PLAYERS * sizeof(HistPlayer) + \
+                    MAX_ROUNDS * WORD_LEN + MAX_MOVES * sizeof(MoveRecord) + 8)
+
+uint32_t history_name_hash(const char *name) {
+    uint32_t h = 2166136261u;       // FNV-1a
+    for (; *name; name++) {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h ? h : 1;
+}
+
+static void segment_path(char *out, size_t size, const char *dir, int number, const char *ext) {
+    snprintf(out, size, "%s/seg-%06d.%s", dir, number, ext);
+}
+
+static size_t record_size(int players, int words, int moves) {
+    size_t len = sizeof(HistRecord) + players * sizeof(HistPlayer) +
+                 words * WORD_LEN + moves * sizeof(MoveRecord);
+    return (len + 7) & ~(size_t)7;
+}
+
+// Record at offset if it is complete and well formed, NULL otherwise
+static const HistRecord *check_record(const char *seg, size_t size, uint64_t offset) {
+    if (offset % 8 || offset + sizeof(HistRecord) > size) return NULL;
+    const HistRecord *r = (const HistRecord *)(seg + offset);
+    if (r->magic != HISTORY_RECORD_MAGIC || r->player_count > HISTORY_MAX_PLAYERS) return NULL;
+    if (r->length < record_size(r->player_count, r->word_count, r->move_count)) return NULL;
+    if (offset + r->length > size) return NULL;
+    return r;
+}
+
+const HistRecord *history_record(const HistSegment *s, uint64_t offset) {
+    return check_record(s->seg, s->seg_size, offset);
+}
+
+static void index_entry(const HistRecord *r, uint64_t offset, HistIndexEntry *e) {
+    memset(e, 0, sizeof(*e));
+    e->offset = offset;
+    e->finished = r->finished;
+    const HistPlayer *p = hist_players(r);
+    for (int i = 0; i < r->player_count && i < HISTORY_MAX_PLAYERS; i++) {
+        e->name_hash[i] = history_name_hash(p[i].name);
+    }
+}
+
+static int cmp_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+// Segment numbers in dir, ascending
+int history_list(const char *dir, int **numbers) {
+    *numbers = NULL;
+    DIR *d = opendir(dir);
+    if (!d) return 0;
+
+    int count = 0, cap = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        int n;
+        char ext[8];
+        if (sscanf(ent->d_name, "seg-%d.%7s", &n, ext) != 2 || strcmp(ext, "dat") != 0) continue;
+        if (count == cap) {
+            cap = cap ? cap * 2 : 16;
+            int *grown = realloc(*numbers, cap * sizeof(int));
+            if (!grown) break;
+            *numbers = grown;
+        }
+        (*numbers)[count++] = n;
+    }
+    closedir(d);
+    if (count) qsort(*numbers, count, sizeof(int), cmp_int);
+    return count;
+}
+
+static int new_segment(HistoryWriter *h, int number) {
+    char path[512];
+    segment_path(path, sizeof(path), h->dir, number, "dat");
+    h->seg_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    segment_path(path, sizeof(path), h->dir, number, "idx");
+    h->idx_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (h->seg_fd < 0 || h->idx_fd < 0) return -1;
+
+    HistSegmentHeader sh = {HISTORY_SEGMENT_MAGIC, 1, (int64_t)time(NULL)};
+    HistIndexHeader ih = {HISTORY_INDEX_MAGIC, 1};
+    if (write(h->seg_fd, &sh, sizeof(sh)) != sizeof(sh)) return -1;
+    if (write(h->idx_fd, &ih, sizeof(ih)) != sizeof(ih)) return -1;
+    h->segment = number;
+    h->seg_size = sizeof(sh);
+    return 0;
+}
+
+// Reopen the newest segment for appending: cut off a torn last record and
+// rebuild the index if it does not cover every record.
+static int reopen_segment(HistoryWriter *h, int number) {
+    char path[512];
+    segment_path(path, sizeof(path), h->dir, number, "dat");
+    h->seg_fd = open(path, O_RDWR);
+    if (h->seg_fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(h->seg_fd, &st) < 0 || (size_t)st.st_size < sizeof(HistSegmentHeader)) return -1;
+    char *seg = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, h->seg_fd, 0);
+    if (seg == MAP_FAILED) return -1;
+    if (((HistSegmentHeader *)seg)->magic != HISTORY_SEGMENT_MAGIC) {
+        munmap(seg, st.st_size);
+        return -1;
+    }
+
+    uint64_t end = sizeof(HistSegmentHeader);
+    size_t records = 0;
+    const HistRecord *r;
+    while ((r = check_record(seg, st.st_size, end)) != NULL) {
+        end += r->length;
+        records++;
+    }
+
+    segment_path(path, sizeof(path), h->dir, number, "idx");
+    h->idx_fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat ist;
+    size_t indexed = 0;
+    if (h->idx_fd >= 0 && fstat(h->idx_fd, &ist) == 0 && (size_t)ist.st_size >= sizeof(HistIndexHeader)) {
+        indexed = (ist.st_size - sizeof(HistIndexHeader)) / sizeof(HistIndexEntry);
+    }
+    if (h->idx_fd >= 0 && indexed != records) {
+        HistIndexHeader ih = {HISTORY_INDEX_MAGIC, 1};
+        int ok = ftruncate(h->idx_fd, 0) == 0 && pwrite(h->idx_fd, &ih, sizeof(ih), 0) == sizeof(ih);
+        off_t at = sizeof(ih);
+        for (uint64_t off = sizeof(HistSegmentHeader); ok && off < end; off += r->length) {
+            r = (const HistRecord *)(seg + off);
+            HistIndexEntry e;
+            index_entry(r, off, &e);
+            ok = pwrite(h->idx_fd, &e, sizeof(e), at) == sizeof(e);
+            at += sizeof(e);
+        }
+        if (!ok) {
+            munmap(seg, st.st_size);
+            return -1;
+        }
+    }
+    munmap(seg, st.st_size);
+
+    if (h->idx_fd < 0 || ftruncate(h->seg_fd, end) < 0) return -1;
+    lseek(h->seg_fd, end, SEEK_SET);
+    lseek(h->idx_fd, 0, SEEK_END);
+    h->segment = number;
+    h->seg_size = end;
+    return 0;
+}
+
+int history_open(HistoryWriter *h, const char *dir) {
+    memset(h, 0, sizeof(*h));
+    h->seg_fd = h->idx_fd = -1;
+    snprintf(h->dir, sizeof(h->dir), "%s", dir);
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) return -1;
+
+    int *numbers;
+    int count = history_list(dir, &numbers);
+    int last = count ? numbers[count - 1] : 0;
+    free(numbers);
+
+    if (last && reopen_segment(h, last) == 0) return 0;
+    history_close(h);
+    return new_segment(h, last + 1);
+}
+
+// One write() per record, then its index entry
+int history_append(HistoryWriter *h, const GameResult *r) {
+    if (h->seg_fd < 0) return -1;
+    if (h->seg_size >= HISTORY_SEGMENT_BYTES) {
+        fdatasync(h->seg_fd);
+        history_close(h);
+        if (new_segment(h, h->segment + 1) < 0) return -1;
+    }
+
+    char buf[RECORD_MAX];
+    memset(buf, 0, sizeof(buf));
+    int players = r->player_count < HISTORY_MAX_PLAYERS ? r->player_count : HISTORY_MAX_PLAYERS;
+    int words = r->word_count < MAX_ROUNDS ? r->word_count : MAX_ROUNDS;
+    int moves = r->move_count < MAX_MOVES ? r->move_count : MAX_MOVES;
+
+    HistRecord *rec = (HistRecord *)buf;
+    rec->magic = HISTORY_RECORD_MAGIC;
+    rec->length = record_size(players, words, moves);
+    rec->finished = r->finished;
+    rec->player_count = players;
+    rec->word_count = words;
+    rec->move_count = moves;
+
+    HistPlayer *p = (HistPlayer *)(rec + 1);
+    for (int i = 0; i < players; i++) {
+        snprintf(p[i].name, NAME_SIZE, "%s", r->names[i]);
+        p[i].score = r->scores[i];
+        p[i].seat = r->seats[i];
+        p[i].rank = i;
+    }
+    memcpy((char *)(p + players), r->words, words * WORD_LEN);
+    memcpy((char *)(p + players) + words * WORD_LEN, r->moves, moves * sizeof(MoveRecord));
+
+    if (write(h->seg_fd, buf, rec->length) != (ssize_t)rec->length) {
+        // Cut a partial record back off so seg_size stays the file's end
+        if (ftruncate(h->seg_fd, h->seg_size) < 0) history_close(h);
+        else lseek(h->seg_fd, h->seg_size, SEEK_SET);
+        return -1;
+    }
+
+    HistIndexEntry e;
+    index_entry(rec, h->seg_size, &e);
+    h->seg_size += rec->length;
+    if (write(h->idx_fd, &e, sizeof(e)) != sizeof(e)) return -1;
+    return 0;
+}
+
+int history_sync(HistoryWriter *h) {
+    return h->seg_fd >= 0 ? fdatasync(h->seg_fd) : -1;
+}
+
+void history_close(HistoryWriter *h) {
+    if (h->seg_fd >= 0) close(h->seg_fd);
+    if (h->idx_fd >= 0) close(h->idx_fd);
+    h->seg_fd = h->idx_fd = -1;
+}
+
+int history_map(HistSegment *s, const char *dir, int number) {
+    memset(s, 0, sizeof(*s));
+    s->number = number;
+
+    char path[512];
+    struct stat st;
+    segment_path(path, sizeof(path), dir, number, "dat");
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(HistSegmentHeader)) {
+        close(fd);
+        return -1;
+    }
+    void *seg = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED) return -1;
+    s->seg = seg;
+    s->seg_size = st.st_size;
+
+    segment_path(path, sizeof(path), dir, number, "idx");
+    fd = open(path, O_RDONLY);
+    if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(HistIndexHeader)) {
+        void *idx = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (idx != MAP_FAILED && ((HistIndexHeader *)idx)->magic == HISTORY_INDEX_MAGIC) {
+            s->idx_map = idx;
+            s->idx_size = st.st_size;
+            s->entries = (const HistIndexEntry *)((char *)idx + sizeof(HistIndexHeader));
+            s->entry_count = (st.st_size - sizeof(HistIndexHeader)) / sizeof(HistIndexEntry);
+        } else if (idx != MAP_FAILED) {
+            munmap(idx, st.st_size);
+        }
+    }
+    if (fd >= 0) close(fd);
+    return 0;
+}
+
+void history_unmap(HistSegment *s) {
+    if (s->seg) munmap((void *)s->seg, s->seg_size);
+    if (s->idx_map) munmap(s->idx_map, s->idx_size);
+    memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,101 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "game_state.h"
+
+// Append-only game history. Games go into segment files of compact binary
+// records (players, words, moves, scores); each segment has a sidecar index
+// of fixed-size entries (record offset, finish time, player name hashes)
+// so queries scan a few bytes per game and touch only matching records.
+// Segments are read through mmap. The index is not synced: it is rebuilt
+// from the segment if it falls behind after a crash.
+
+#define HISTORY_DIR "history"
+#define HISTORY_SEGMENT_BYTES (8 * 1024 * 1024)    // roll to a new segment past this
+#define HISTORY_MAX_PLAYERS 8
+#define HISTORY_SEGMENT_MAGIC 0x31484757           // "WGH1"
+#define HISTORY_RECORD_MAGIC 0x52484757            // "WGHR"
+#define HISTORY_INDEX_MAGIC 0x49484757             // "WGHI"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int64_t created;
+} HistSegmentHeader;
+
+// Followed by HistPlayer[player_count], char[word_count][WORD_LEN] and
+// MoveRecord[move_count], padded to 8 bytes
+typedef struct {
+    uint32_t magic;
+    uint32_t length;
+    int64_t finished;
+    uint8_t player_count;
+    uint8_t word_count;
+    uint16_t move_count;
+    uint32_t reserved;
+} HistRecord;
+
+typedef struct {
+    char name[NAME_SIZE];
+    int16_t score;
+    uint8_t seat;                   // as in MoveRecord.player
+    uint8_t rank;                   // 0 = winner
+} HistPlayer;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} HistIndexHeader;
+
+typedef struct {
+    uint64_t offset;                // record offset in the segment
+    int64_t finished;
+    uint32_t name_hash[HISTORY_MAX_PLAYERS];    // 0 = empty slot
+} HistIndexEntry;
+
+typedef struct {
+    char dir[256];
+    int segment;
+    int seg_fd;
+    int idx_fd;
+    off_t seg_size;
+} HistoryWriter;
+
+typedef struct {
+    int number;
+    const char *seg;
+    size_t seg_size;
+    const HistIndexEntry *entries;
+    size_t entry_count;
+    void *idx_map;
+    size_t idx_size;
+} HistSegment;
+
+uint32_t history_name_hash(const char *name);
+
+int history_open(HistoryWriter *h, const char *dir);
+int history_append(HistoryWriter *h, const GameResult *r);
+int history_sync(HistoryWriter *h);
+void history_close(HistoryWriter *h);
+
+int history_list(const char *dir, int **numbers);
+int history_map(HistSegment *s, const char *dir, int number);
+void history_unmap(HistSegment *s);
+const HistRecord *history_record(const HistSegment *s, uint64_t offset);
+
+static inline const HistPlayer *hist_players(const HistRecord *r) {
+    return (const HistPlayer *)(r + 1);
+}
+
+static inline const char (*hist_words(const HistRecord *r))[WORD_LEN] {
+    return (const char (*)[WORD_LEN])(hist_players(r) + r->player_count);
+}
+
+static inline const MoveRecord *hist_moves(const HistRecord *r) {
+    return (const MoveRecord *)(hist_words(r) + r->word_count);
+}
+
+#endif
@@ -0,0 +1,212 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "history.h"
+
+// Queries the server's game history store, newest games first:
+//   ./historyq -p alice -n 1000         alice's last 1000 games and totals
+//   ./historyq -s 2026-01-01 -u 2026-02-01 -v
+// Segments outside the time range are skipped on their index alone, and
+// for player queries only records whose index entry carries the name's
+// hash are read.
+
+typedef struct {
+    int games, wins;
+    long points;
+    long rank_sum;
+    int letter_hits, letter_misses, word_hits, word_misses;
+    int invalid, timeouts, hints;
+} PlayerTotals;
+
+static const char *move_names[] = {"+", "-", "WORD+", "WORD-", "invalid", "timeout", "hint"};
+
+static int parse_time(const char *s, time_t *out) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    char *end = strptime(s, "%Y-%m-%d", &tm);
+    if (end && (*end == '\0' || strptime(end, " %H:%M", &tm))) {
+        tm.tm_isdst = -1;
+        *out = mktime(&tm);
+        return 0;
+    }
+    char *num_end;
+    long long v = strtoll(s, &num_end, 10);
+    if (*s && *num_end == '\0') {
+        *out = (time_t)v;
+        return 0;
+    }
+    return -1;
+}
+
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void print_game(const HistRecord *r, int verbose) {
+    char when[32];
+    time_t t = (time_t)r->finished;
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M", localtime(&t));
+
+    const HistPlayer *p = hist_players(r);
+    printf("%s ", when);
+    for (int i = 0; i < r->player_count; i++) {
+        printf(" %s %d%s", p[i].name, p[i].score, i + 1 < r->player_count ? "," : "");
+    }
+    printf("\n");
+    if (!verbose) return;
+
+    const char (*words)[WORD_LEN] = hist_words(r);
+    const MoveRecord *moves = hist_moves(r);
+    for (int w = 0; w < r->word_count; w++) {
+        printf("    round %d %-12.*s", w + 1, WORD_LEN, words[w]);
+        for (int m = 0; m < r->move_count; m++) {
+            if (moves[m].round != w + 1) continue;
+            const char *who = "?";
+            for (int i = 0; i < r->player_count; i++) {
+                if (p[i].seat == moves[m].player) who = p[i].name;
+            }
+            if (moves[m].kind > MOVE_HINT) continue;
+            if (moves[m].letter) printf(" %s:%c%s", who, moves[m].letter, move_names[moves[m].kind]);
+            else printf(" %s:%s", who, move_names[moves[m].kind]);
+        }
+        printf("\n");
+    }
+}
+
+static void add_totals(PlayerTotals *t, const HistRecord *r, int slot) {
+    const HistPlayer *p = &hist_players(r)[slot];
+    const MoveRecord *moves = hist_moves(r);
+    t->games++;
+    t->wins += p->rank == 0;
+    t->points += p->score;
+    t->rank_sum += p->rank + 1;
+    for (int m = 0; m < r->move_count; m++) {
+        if (moves[m].player != p->seat) continue;
+        switch (moves[m].kind) {
+        case MOVE_LETTER_HIT: t->letter_hits++; break;
+        case MOVE_LETTER_MISS: t->letter_misses++; break;
+        case MOVE_WORD_HIT: t->word_hits++; break;
+        case MOVE_WORD_MISS: t->word_misses++; break;
+        case MOVE_INVALID: t->invalid++; break;
+        case MOVE_TIMEOUT: t->timeouts++; break;
+        case MOVE_HINT: t->hints++; break;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *dir = HISTORY_DIR;
+    const char *player = NULL;
+    time_t since = 0, until = 0;
+    long limit = 20;
+    int verbose = 0, quiet = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:p:s:u:n:vq")) != -1) {
+        switch (opt) {
+        case 'd':
+            dir = optarg;
+            break;
+        case 'p':
+            player = optarg;
+            break;
+        case 's':
+        case 'u':
+            if (parse_time(optarg, opt == 's' ? &since : &until) < 0) {
+                fprintf(stderr, "Bad time '%s' (YYYY-MM-DD[ HH:MM] or epoch seconds)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'n':
+            limit = atol(optarg);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-d dir] [-p player] [-s since] [-u until] [-n games] [-v] [-q]\n"
+                            "  -n 0 means all matching games, -q prints totals only\n", argv[0]);
+            return 1;
+        }
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int *numbers;
+    int segments = history_list(dir, &numbers);
+    uint32_t hash = player ? history_name_hash(player) : 0;
+    PlayerTotals totals;
+    memset(&totals, 0, sizeof(totals));
+    long shown = 0, scanned = 0;
+
+    for (int s = segments - 1; s >= 0 && (limit <= 0 || shown < limit); s--) {
+        HistSegment seg;
+        if (history_map(&seg, dir, numbers[s]) < 0) continue;
+        if (seg.entry_count == 0) {
+            history_unmap(&seg);
+            continue;
+        }
+        // Index entries are in finish order
+        if ((until && seg.entries[0].finished > until) ||
+            (since && seg.entries[seg.entry_count - 1].finished < since)) {
+            history_unmap(&seg);
+            continue;
+        }
+
+        for (size_t e = seg.entry_count; e-- > 0 && (limit <= 0 || shown < limit); ) {
+            const HistIndexEntry *ent = &seg.entries[e];
+            scanned++;
+            if (until && ent->finished > until) continue;
+            if (since && ent->finished < since) break;
+
+            int slot = -1;
+            if (player) {
+                int candidate = 0;
+                for (int i = 0; i < HISTORY_MAX_PLAYERS; i++) {
+                    if (ent->name_hash[i] == hash) candidate = 1;
+                }
+                if (!candidate) continue;
+            }
+
+            const HistRecord *r = history_record(&seg, ent->offset);
+            if (!r) continue;
+            if (player) {
+                for (int i = 0; i < r->player_count; i++) {
+                    if (strncmp(hist_players(r)[i].name, player, NAME_SIZE) == 0) slot = i;
+                }
+                if (slot < 0) continue;     // hash collision
+                add_totals(&totals, r, slot);
+            }
+            if (!quiet) print_game(r, verbose);
+            shown++;
+        }
+        history_unmap(&seg);
+    }
+    free(numbers);
+
+    if (player) {
+        printf("\n%s: %d games, %d wins (%.1f%%), %ld points (%.2f/game), average place %.2f\n",
+               player, totals.games, totals.wins,
+               totals.games ? 100.0 * totals.wins / totals.games : 0.0,
+               totals.points, totals.games ? (double)totals.points / totals.games : 0.0,
+               totals.games ? (double)totals.rank_sum / totals.games : 0.0);
+        int letters = totals.letter_hits + totals.letter_misses;
+        printf("  letters %d/%d correct (%.1f%%), words %d/%d, %d invalid, %d timeouts, %d hints\n",
+               totals.letter_hits, letters, letters ? 100.0 * totals.letter_hits / letters : 0.0,
+               totals.word_hits, totals.word_hits + totals.word_misses,
+               totals.invalid, totals.timeouts, totals.hints);
+    }
+    fprintf(stderr, "%ld games matched, %ld index entries scanned in %d segments, %.2f ms\n",
+            shown, scanned, segments, elapsed_ms(&start));
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include <string.h>
+#include "match.h"
+
+void match_init(MatchQueue *q) {
+    memset(q, 0, sizeof(*q));
+    for (int i = 0; i < MATCH_CAPACITY; i++) {
+        q->slots[i].next = i + 1 < MATCH_CAPACITY ? i + 1 : -1;
+    }
+    for (int b = 0; b < MATCH_BUCKETS; b++) q->head[b] = q->tail[b] = -1;
+    q->oldest = q->newest = -1;
+    q->shaking_oldest = q->shaking_newest = -1;
+}
+
+static void age_append(MatchQueue *q, int slot, int *oldest, int *newest) {
+    Waiter *w = &q->slots[slot];
+    w->age_next = -1;
+    w->age_prev = *newest;
+    if (w->age_prev >= 0) q->slots[w->age_prev].age_next = slot;
+    else *oldest = slot;
+    *newest = slot;
+}
+
+static void age_unlink(MatchQueue *q, int slot, int *oldest, int *newest) {
+    Waiter *w = &q->slots[slot];
+    if (w->age_prev >= 0) q->slots[w->age_prev].age_next = w->age_next;
+    else *oldest = w->age_next;
+    if (w->age_next >= 0) q->slots[w->age_next].age_prev = w->age_prev;
+    else *newest = w->age_prev;
+}
+
+// Slot for a new connection, -1 when the pool is exhausted
+int match_alloc(MatchQueue *q, int fd, long long now) {
+    int slot = q->free_head;
+    if (slot < 0) return -1;
+    Waiter *w = &q->slots[slot];
+    q->free_head = w->next;
+    w->fd = fd;
+    w->state = SLOT_HANDSHAKE;
+    w->since = now;
+    w->line_len = 0;
+    w->name[0] = '\0';
+    age_append(q, slot, &q->shaking_oldest, &q->shaking_newest);
+    q->handshakes++;
+    return slot;
+}
+
+static void unlink_waiter(MatchQueue *q, int slot) {
+    Waiter *w = &q->slots[slot];
+    if (w->prev >= 0) q->slots[w->prev].next = w->next;
+    else q->head[w->bucket] = w->next;
+    if (w->next >= 0) q->slots[w->next].prev = w->prev;
+    else q->tail[w->bucket] = w->prev;
+    q->count[w->bucket]--;
+
+    age_unlink(q, slot, &q->oldest, &q->newest);
+    q->queued--;
+    w->state = SLOT_TAKEN;
+}
+
+static void end_handshake(MatchQueue *q, int slot) {
+    age_unlink(q, slot, &q->shaking_oldest, &q->shaking_newest);
+    q->handshakes--;
+}
+
+// Return a slot to the pool, leaving the queue first if it is in it
+void match_release(MatchQueue *q, int slot) {
+    if (q->slots[slot].state == SLOT_QUEUED) unlink_waiter(q, slot);
+    else if (q->slots[slot].state == SLOT_HANDSHAKE) end_handshake(q, slot);
+    q->slots[slot].state = SLOT_FREE;
+    q->slots[slot].fd = -1;
+    q->slots[slot].next = q->free_head;
+    q->free_head = slot;
+}
+
+static int rating_bucket(int rating) {
+    if (rating <= MATCH_RATING_MIN) return 0;
+    if (rating >= MATCH_RATING_MAX) return MATCH_BUCKETS - 1;
+    return (rating - MATCH_RATING_MIN) * MATCH_BUCKETS / (MATCH_RATING_MAX - MATCH_RATING_MIN);
+}
+
+void match_enqueue(MatchQueue *q, int slot, int rating, long long now) {
+    Waiter *w = &q->slots[slot];
+    end_handshake(q, slot);
+    w->state = SLOT_QUEUED;
+    w->rating = rating;
+    w->bucket = rating_bucket(rating);
+    w->since = now;
+
+    w->next = -1;
+    w->prev = q->tail[w->bucket];
+    if (w->prev >= 0) q->slots[w->prev].next = slot;
+    else q->head[w->bucket] = slot;
+    q->tail[w->bucket] = slot;
+    q->count[w->bucket]++;
+
+    age_append(q, slot, &q->oldest, &q->newest);
+    q->queued++;
+}
+
+// Buckets either side of a waiter's own that it may be matched across
+static int match_window(long long age) {
+    if (age < MATCH_FILL_MS) return 0;
+    if (age >= MATCH_MAX_WAIT_MS) return MATCH_BUCKETS;
+    return (age - MATCH_FILL_MS) * MATCH_BUCKETS / (MATCH_MAX_WAIT_MS - MATCH_FILL_MS);
+}
+
+// Take the anchor, then the oldest waiters of the nearest buckets
+static int take_room(MatchQueue *q, int anchor, int window, int *room) {
+    int b = q->slots[anchor].bucket;
+    int n = 0;
+    unlink_waiter(q, anchor);
+    room[n++] = anchor;
+
+    for (int d = 0; d <= window && n < MATCH_ROOM_MAX; d++) {
+        for (int side = 0; side < 2 && n < MATCH_ROOM_MAX; side++) {
+            int nb = side ? b + d : b - d;
+            if ((d == 0 && side) || nb < 0 || nb >= MATCH_BUCKETS) continue;
+            while (q->head[nb] >= 0 && n < MATCH_ROOM_MAX) {
+                int slot = q->head[nb];
+                unlink_waiter(q, slot);
+                room[n++] = slot;
+            }
+        }
+    }
+    return n;
+}
+
+// One room's worth of slots into room[], removed from the queue. Returns
+// the player count, 0 if no room can form yet. Call until it returns 0.
+int match_form(MatchQueue *q, long long now, int *room) {
+    if (q->queued < MATCH_ROOM_MIN) return 0;
+
+    for (int b = 0; b < MATCH_BUCKETS; b++) {
+        if (q->count[b] >= MATCH_ROOM_MAX) return take_room(q, q->head[b], 0, room);
+    }
+
+    // Arrival order: the first waiter still inside MATCH_FILL_MS ends the scan
+    for (int w = q->oldest; w >= 0; w = q->slots[w].age_next) {
+        long long age = now - q->slots[w].since;
+        if (age < MATCH_FILL_MS) break;
+
+        int window = match_window(age);
+        int b = q->slots[w].bucket;
+        int lo = b - window < 0 ? 0 : b - window;
+        int hi = b + window >= MATCH_BUCKETS ? MATCH_BUCKETS - 1 : b + window;
+        int available = 0;
+        for (int nb = lo; nb <= hi && available < MATCH_ROOM_MIN; nb++) available += q->count[nb];
+        if (available >= MATCH_ROOM_MIN) return take_room(q, w, window, room);
+    }
+    return 0;
+}
+
+// The oldest connection that started its handshake before the given time
+// and still has not sent NAME, -1 if there is none
+int match_expired(const MatchQueue *q, long long before) {
+    int slot = q->shaking_oldest;
+    return slot >= 0 && q->slots[slot].since < before ? slot : -1;
+}
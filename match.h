@@ -0,0 +1,59 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include "game_state.h"
+
+// Matchmaking queue, owned by the accept loop. Connections take a slot from
+// a fixed pool while they send NAME; once rated they join a FIFO list for
+// their rating bucket and one global arrival-order list, so enqueue and
+// removal are O(1). A bucket holding a full room is matched at once. A
+// player waiting past MATCH_FILL_MS may start a smaller room, drawing from
+// buckets further away the longer they wait, until MATCH_MAX_WAIT_MS opens
+// every bucket: with MATCH_ROOM_MIN players queued nobody waits longer.
+// Connections still sending NAME are kept in arrival order as well, so the
+// ones past their deadline are found without a scan.
+
+#define MATCH_CAPACITY 4096         // connections in handshake or queued
+#define MATCH_BUCKETS 32
+#define MATCH_RATING_MIN -50        // ratings are clamped into the buckets
+#define MATCH_RATING_MAX 200
+#define MATCH_ROOM_MIN 3
+#define MATCH_ROOM_MAX MAX_CLIENTS
+#define MATCH_FILL_MS 2000
+#define MATCH_MAX_WAIT_MS 10000
+
+enum { SLOT_FREE, SLOT_HANDSHAKE, SLOT_QUEUED, SLOT_TAKEN };  // taken: matched into a room
+
+typedef struct {
+    int fd;
+    int state;
+    int rating;
+    int bucket;
+    long long since;                // queue entry time, or connection time in handshake, ms
+    int prev, next;                 // bucket list, or free list
+    int age_prev, age_next;         // arrival order, queued or in handshake
+    int line_len;
+    char line[NAME_SIZE + 8];       // NAME line as it arrives
+    char name[NAME_SIZE];
+} Waiter;
+
+typedef struct {
+    Waiter slots[MATCH_CAPACITY];
+    int free_head;
+    int head[MATCH_BUCKETS];
+    int tail[MATCH_BUCKETS];
+    int count[MATCH_BUCKETS];
+    int oldest, newest;
+    int queued;
+    int shaking_oldest, shaking_newest;
+    int handshakes;
+} MatchQueue;
+
+void match_init(MatchQueue *q);
+int match_alloc(MatchQueue *q, int fd, long long now);
+void match_release(MatchQueue *q, int slot);
+void match_enqueue(MatchQueue *q, int slot, int rating, long long now);
+int match_form(MatchQueue *q, long long now, int *room);
+int match_expired(const MatchQueue *q, long long before);
+
+#endif
@@ -0,0 +1,280 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "profiler.h"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+#define SKIP_FRAMES 2               // the SIGPROF handler and the signal trampoline
+
+typedef struct {
+    int thread;
+    int depth;                      // set last, 0 = slot not filled
+    void *frames[PROF_MAX_DEPTH];
+} Sample;
+
+typedef struct {
+    timer_t timer;
+    int ready;
+    char name[16];
+} ProfThread;
+
+static char process_name[32] = "server";
+static ProfThread threads[PROF_MAX_THREADS];
+static int thread_count = 0;
+static pid_t children[PROF_MAX_CHILDREN];
+static int child_count = 0;
+static volatile sig_atomic_t profiling = 0;
+static volatile sig_atomic_t dump_pending = 0;
+static Sample samples[PROF_MAX_SAMPLES];
+static int sample_count = 0;
+static int dropped = 0;
+static int session = 0;
+static int installed = 0;
+static __thread int thread_slot = -1;
+
+static void set_timers(int on) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (on) {
+        its.it_value.tv_nsec = 1000000000L / PROF_HZ;
+        its.it_interval.tv_nsec = 1000000000L / PROF_HZ;
+    }
+    for (int i = 0; i < thread_count && i < PROF_MAX_THREADS; i++) {
+        if (__atomic_load_n(&threads[i].ready, __ATOMIC_ACQUIRE)) {
+            timer_settime(threads[i].timer, 0, &its, NULL);
+        }
+    }
+}
+
+static void sample_handler(int sig) {
+    int saved = errno;
+    if (profiling && thread_slot >= 0) {
+        int n = __atomic_fetch_add(&sample_count, 1, __ATOMIC_RELAXED);
+        if (n < PROF_MAX_SAMPLES) {
+            Sample *s = &samples[n];
+            s->thread = thread_slot;
+            int depth = backtrace(s->frames, PROF_MAX_DEPTH);
+            __atomic_store_n(&s->depth, depth, __ATOMIC_RELEASE);
+        } else {
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+        }
+    }
+    errno = saved;
+}
+
+// A plain SIGUSR2 toggles; the copy forwarded to children carries the new
+// state, so a child that missed one signal cannot end up inverted.
+static void toggle_handler(int sig, siginfo_t *info, void *ctx) {
+    int saved = errno;
+    int on = !profiling;
+    if (info && info->si_code == SI_QUEUE) on = info->si_value.sival_int;
+
+    if (on != profiling) {
+        profiling = on;
+        set_timers(on);
+        if (!on) dump_pending = 1;
+    }
+
+    union sigval value;
+    value.sival_int = on;
+    for (int i = 0; i < child_count; i++) {
+        sigqueue(children[i], SIGUSR2, value);
+    }
+    errno = saved;
+}
+
+// Call once per process: in main, and again in each forked handler
+int profiler_init(const char *process) {
+    snprintf(process_name, sizeof(process_name), "%s", process);
+    thread_count = 0;
+    child_count = 0;
+    sample_count = 0;
+    dropped = 0;
+    session = 0;
+    memset(threads, 0, sizeof(threads));
+    if (installed) return 0;
+
+    // backtrace() loads libgcc on first use, which must not happen in a handler
+    void *prime[2];
+    backtrace(prime, 2);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sample_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    if (sigaction(SIGPROF, &sa, NULL) < 0) return -1;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = toggle_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART | SA_SIGINFO;
+    if (sigaction(SIGUSR2, &sa, NULL) < 0) return -1;
+
+    installed = 1;
+    return 0;
+}
+
+// Call at the start of every thread. The first thread of a process keeps
+// receiving SIGUSR2, later ones block it so their sleeps are not cut short.
+int profiler_register_thread(const char *name) {
+    int slot = __atomic_fetch_add(&thread_count, 1, __ATOMIC_RELAXED);
+    if (slot >= PROF_MAX_THREADS) return -1;
+
+    if (slot > 0) {
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGUSR2);
+        pthread_sigmask(SIG_BLOCK, &set, NULL);
+    }
+
+    ProfThread *t = &threads[slot];
+    snprintf(t->name, sizeof(t->name), "%s", name);
+
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev.sigev_notify_thread_id = syscall(SYS_gettid);
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &t->timer) < 0) return -1;
+
+    thread_slot = slot;
+    __atomic_store_n(&t->ready, 1, __ATOMIC_RELEASE);
+
+    // Threads started while a session runs join it
+    if (profiling) set_timers(1);
+    return 0;
+}
+
+void profiler_add_child(pid_t pid) {
+    if (child_count < PROF_MAX_CHILDREN) children[child_count++] = pid;
+}
+
+// Once a child is reaped, so a recycled pid never gets its signals
+void profiler_remove_child(pid_t pid) {
+    for (int i = 0; i < child_count; i++) {
+        if (children[i] == pid) {
+            children[i] = children[--child_count];
+            break;
+        }
+    }
+}
+
+typedef struct {
+    char *stack;
+    int count;
+} Folded;
+
+static int compare_folded(const void *a, const void *b) {
+    return strcmp(((const Folded *)a)->stack, ((const Folded *)b)->stack);
+}
+
+static int compare_samples(const void *a, const void *b) {
+    const Sample *x = *(const Sample * const *)a, *y = *(const Sample * const *)b;
+    if (x->thread != y->thread) return x->thread - y->thread;
+    if (x->depth != y->depth) return x->depth - y->depth;
+    return memcmp(x->frames, y->frames, x->depth * sizeof(void *));
+}
+
+static void append_frame(char *out, size_t size, void *addr) {
+    size_t len = strlen(out);
+    Dl_info info;
+    int found = dladdr(addr, &info);
+    if (found && info.dli_sname) {
+        snprintf(out + len, size - len, ";%s", info.dli_sname);
+    } else if (found && info.dli_fname) {
+        const char *base = strrchr(info.dli_fname, '/');
+        snprintf(out + len, size - len, ";%s+0x%lx", base ? base + 1 : info.dli_fname,
+                 (unsigned long)((char *)addr - (char *)info.dli_fbase));
+    } else {
+        snprintf(out + len, size - len, ";0x%lx", (unsigned long)addr);
+    }
+}
+
+// Identical stacks are counted once and symbolized once
+static void write_profile(void) {
+    int n = __atomic_load_n(&sample_count, __ATOMIC_ACQUIRE);
+    if (n > PROF_MAX_SAMPLES) n = PROF_MAX_SAMPLES;
+
+    Sample **order = malloc((n ? n : 1) * sizeof(Sample *));
+    if (!order) return;
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        if (__atomic_load_n(&samples[i].depth, __ATOMIC_ACQUIRE) > SKIP_FRAMES) order[kept++] = &samples[i];
+    }
+    qsort(order, kept, sizeof(Sample *), compare_samples);
+
+    mkdir(PROF_DIR, 0755);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.%d.%d.folded", PROF_DIR, process_name, getpid(), session);
+    FILE *f = fopen(path, "w");
+    if (f) {
+        // Different call sites in one function fold to the same line
+        Folded *lines = malloc((kept ? kept : 1) * sizeof(Folded));
+        int line_count = 0;
+        char line[8192];
+        for (int i = 0; lines && i < kept; ) {
+            int j = i + 1;
+            while (j < kept && compare_samples(&order[i], &order[j]) == 0) j++;
+
+            Sample *s = order[i];
+            snprintf(line, sizeof(line), "%s;%s", process_name, threads[s->thread].name);
+            for (int k = s->depth - 1; k >= SKIP_FRAMES; k--) {
+                // Return addresses point past the call, step back into it
+                char *addr = (char *)s->frames[k] - (k > SKIP_FRAMES ? 1 : 0);
+                append_frame(line, sizeof(line), addr);
+            }
+            lines[line_count].stack = strdup(line);
+            lines[line_count].count = j - i;
+            if (lines[line_count].stack) line_count++;
+            i = j;
+        }
+        if (lines) qsort(lines, line_count, sizeof(Folded), compare_folded);
+        for (int i = 0; i < line_count; ) {
+            int count = 0, j = i;
+            while (j < line_count && strcmp(lines[i].stack, lines[j].stack) == 0) count += lines[j++].count;
+            fprintf(f, "%s %d\n", lines[i].stack, count);
+            i = j;
+        }
+        for (int i = 0; i < line_count; i++) free(lines[i].stack);
+        free(lines);
+        fclose(f);
+        fprintf(stderr, "Profile written to %s (%d samples, %d dropped)\n", path, kept, dropped);
+    }
+    free(order);
+
+    for (int i = 0; i < n; i++) samples[i].depth = 0;
+    __atomic_store_n(&dropped, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&sample_count, 0, __ATOMIC_RELEASE);
+    session++;
+}
+
+// Signal handlers only flip flags; the file is written from here
+void profiler_poll(void) {
+    if (!dump_pending || profiling) return;
+    dump_pending = 0;
+    write_profile();
+}
+
+void profiler_shutdown(void) {
+    if (profiling) {
+        profiling = 0;
+        set_timers(0);
+        dump_pending = 1;
+    }
+    profiler_poll();
+}
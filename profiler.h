@@ -0,0 +1,27 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <sys/types.h>
+
+// In-process sampling profiler. SIGUSR2 starts and stops it; while it runs
+// every registered thread gets a SIGPROF per PROF_HZ of its own CPU time and
+// the handler records the stack. Stopping writes folded stacks to
+// PROF_DIR/<process>.<pid>.<n>.folded ("process;thread;frame;... count"),
+// which concatenate into one flame graph. Off, it costs nothing: the timers
+// exist but are disarmed.
+
+#define PROF_DIR "profiles"
+#define PROF_HZ 99
+#define PROF_MAX_DEPTH 48
+#define PROF_MAX_SAMPLES 8192       // per session, further samples are dropped
+#define PROF_MAX_THREADS 8
+#define PROF_MAX_CHILDREN 64
+
+int profiler_init(const char *process);
+int profiler_register_thread(const char *name);
+void profiler_add_child(pid_t pid);
+void profiler_remove_child(pid_t pid);
+void profiler_poll(void);
+void profiler_shutdown(void);
+
+#endif
@@ -0,0 +1,121 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <sys/mman.h>
+#include "replica.h"
+
+static ChangeLog *map_log(int fd) {
+    void *base = mmap(NULL, sizeof(ChangeLog), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, 0);
+    return base == MAP_FAILED ? NULL : base;
+}
+
+// The primary's side: a fresh log and the fd to pass to the standby
+ChangeLog *change_log_create(int *fd) {
+    *fd = memfd_create("wordguess-changes", 0);
+    if (*fd < 0) return NULL;
+    ChangeLog *log = NULL;
+    if (ftruncate(*fd, sizeof(ChangeLog)) == 0) log = map_log(*fd);
+    if (!log) {
+        close(*fd);
+        *fd = -1;
+        return NULL;
+    }
+    pthread_mutexattr_init(&log->lock_attr);
+    pthread_mutexattr_setpshared(&log->lock_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&log->lock, &log->lock_attr);
+    return log;
+}
+
+ChangeLog *change_log_map(int fd) {
+    return map_log(fd);
+}
+
+void change_log_unmap(ChangeLog *log) {
+    munmap(log, sizeof(ChangeLog));
+}
+
+uint64_t change_log_head(const ChangeLog *log) {
+    return __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+}
+
+void change_log_append(ChangeLog *log, ChangeRecord *r) {
+    pthread_mutex_lock(&log->lock);
+    uint64_t pos = log->head;
+    ChangeRecord *slot = &log->records[pos & (CHANGE_LOG_CAPACITY - 1)];
+    // Readers of the record being replaced see it vanish, not half of it
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->seq = pos + 1;
+    memcpy((char *)slot + sizeof(slot->seq), (char *)r + sizeof(r->seq), sizeof(*r) - sizeof(r->seq));
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&log->head, pos + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&log->lock);
+}
+
+// Copies record seq (1-based). Returns 1, 0 if it is not written yet, or
+// -1 if the ring has already moved past it.
+int change_log_read(const ChangeLog *log, uint64_t seq, ChangeRecord *out) {
+    if (seq > change_log_head(log)) return 0;
+    const ChangeRecord *slot = &log->records[(seq - 1) & (CHANGE_LOG_CAPACITY - 1)];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq) return -1;
+    memcpy(out, slot, sizeof(*out));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq ? 1 : -1;
+}
+
+void change_image(const GameState *g, RoomImage *out) {
+    out->round = g->round;
+    out->current_player = g->current_player;
+    out->turn = g->turn;
+    out->difficulty = g->difficulty;
+    memcpy(out->word, g->word, WORD_LEN);
+    memcpy(out->answer_space, g->answer_space, ANSWER_SIZE);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        out->total_score[i] = g->total_score[i];
+        out->round_lives[i] = g->round_lives[i];
+        out->round_eliminated[i] = g->round_eliminated[i];
+        out->ready[i] = g->ready[i];
+        out->connected[i] = g->connected[i];
+        out->hint_used[i] = g->hint_used[i];
+    }
+    out->missed_letters = g->missed_letters;
+    memcpy(out->missed_words, g->missed_words, sizeof(out->missed_words));
+    out->move_count = g->move_count;
+    int n = g->move_count < CHANGE_MOVES ? g->move_count : CHANGE_MOVES;
+    memcpy(out->moves, g->moves + g->move_count - n, n * sizeof(MoveRecord));
+}
+
+// Transitions log at most a volley's worth of moves each, so the last
+// CHANGE_MOVES always cover what is new since the previous record
+void change_apply(GameState *g, const RoomImage *image) {
+    g->round = image->round;
+    g->current_player = image->current_player;
+    g->turn = image->turn;
+    g->difficulty = image->difficulty;
+    memcpy(g->word, image->word, WORD_LEN);
+    memcpy(g->answer_space, image->answer_space, ANSWER_SIZE);
+    memset(g->letter_masks, 0, sizeof(g->letter_masks));
+    for (int i = 0; g->word[i]; i++) {
+        if (isupper((unsigned char)g->word[i])) g->letter_masks[g->word[i] - 'A'] |= 1u << i;
+    }
+    if (g->round >= 1 && g->round <= MAX_ROUNDS) memcpy(g->round_words[g->round - 1], g->word, WORD_LEN);
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        g->total_score[i] = image->total_score[i];
+        g->round_lives[i] = image->round_lives[i];
+        g->round_eliminated[i] = image->round_eliminated[i];
+        g->ready[i] = image->ready[i];
+        g->connected[i] = image->connected[i];
+        g->hint_used[i] = image->hint_used[i];
+    }
+    g->missed_letters = image->missed_letters;
+    memcpy(g->missed_words, image->missed_words, sizeof(g->missed_words));
+    int n = image->move_count < CHANGE_MOVES ? image->move_count : CHANGE_MOVES;
+    memcpy(g->moves + image->move_count - n, image->moves, n * sizeof(MoveRecord));
+    g->move_count = image->move_count;
+    g->game_started = 1;
+}
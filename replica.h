@@ -0,0 +1,86 @@
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "game_state.h"
+
+// Change log feeding a hot standby (-B). Every state transition a room
+// applies is appended with the room's state after it, so the standby
+// replays by overwriting its copy and never runs game logic itself. The
+// log is a ring in a memfd the primary passes to the standby. Writers
+// serialise on a process-shared lock; the standby reads without it and
+// tells records overwritten under it by their sequence numbers.
+
+#define CHANGE_LOG_CAPACITY 16384   // records, power of two
+#define CHANGE_MOVES 8              // latest moves carried by each record
+
+enum {
+    CHANGE_OPEN,                    // room formed: roster and rules
+    CHANGE_ROUND,                   // word dealt
+    CHANGE_MOVE,                    // move outcome, timeout or hint
+    CHANGE_TURN,                    // turn advanced
+    CHANGE_VOLLEY,                  // simultaneous guesses resolved
+    CHANGE_LEFT,                    // player disconnected
+    CHANGE_END,                     // game over, results queued
+    CHANGE_SCORE                    // score store row after an update
+};
+
+// What a room needs to carry on from a turn boundary
+typedef struct {
+    int round;
+    int current_player;
+    int turn;
+    int difficulty;
+    char word[WORD_LEN];
+    char answer_space[ANSWER_SIZE];
+    int total_score[MAX_CLIENTS];
+    int round_lives[MAX_CLIENTS];
+    int round_eliminated[MAX_CLIENTS];
+    int ready[MAX_CLIENTS];
+    int connected[MAX_CLIENTS];
+    int hint_used[MAX_CLIENTS];
+    unsigned int missed_letters;
+    char missed_words[MAX_CLIENTS][WORD_LEN];
+    int move_count;
+    MoveRecord moves[CHANGE_MOVES];     // the last ones before move_count
+} RoomImage;
+
+typedef struct {
+    int player_count;
+    int simultaneous;               // the rules the room plays by
+    int total_rounds;
+    int validate;
+    int turn_ms;
+    char names[MAX_CLIENTS][NAME_SIZE];
+} RoomRoster;
+
+typedef struct {
+    uint64_t seq;                   // position + 1, stored last
+    int room;
+    int kind;                       // CHANGE_*
+    union {
+        RoomImage image;
+        RoomRoster roster;          // CHANGE_OPEN
+        ScoreRecord score;          // CHANGE_SCORE
+    };
+} ChangeRecord;
+
+typedef struct {
+    pthread_mutex_t lock CACHE_ALIGNED;
+    pthread_mutexattr_t lock_attr;
+    uint64_t head CACHE_ALIGNED;    // records appended so far
+    ChangeRecord records[CHANGE_LOG_CAPACITY] CACHE_ALIGNED;
+} ChangeLog;
+
+ChangeLog *change_log_create(int *fd);
+ChangeLog *change_log_map(int fd);
+void change_log_unmap(ChangeLog *log);
+uint64_t change_log_head(const ChangeLog *log);
+void change_log_append(ChangeLog *log, ChangeRecord *r);
+int change_log_read(const ChangeLog *log, uint64_t seq, ChangeRecord *out);
+
+void change_image(const GameState *g, RoomImage *out);
+void change_apply(GameState *g, const RoomImage *image);
+
+#endif
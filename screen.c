@@ -0,0 +1,138 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "screen.h"
+
+#define BLANK ((Cell)' ')
+
+void screen_init(Screen *s) {
+    memset(s, 0, sizeof(*s));
+    screen_clear(s);
+}
+
+void screen_clear(Screen *s) {
+    for (int r = 0; r < SCREEN_ROWS; r++) {
+        for (int c = 0; c < SCREEN_COLS; c++) s->back[r][c] = BLANK;
+    }
+}
+
+static int sequence_len(unsigned char b) {
+    if ((b & 0xE0) == 0xC0) return 2;
+    if ((b & 0xF0) == 0xE0) return 3;
+    if ((b & 0xF8) == 0xF0) return 4;
+    return 1;
+}
+
+// One cell per character, clipped at the right edge. Control characters
+// show as '?'. Returns the columns used.
+int screen_put(Screen *s, int row, int col, const char *text) {
+    if (row < 0 || row >= SCREEN_ROWS) return 0;
+    const unsigned char *p = (const unsigned char *)text;
+    int start = col;
+
+    while (*p && col < SCREEN_COLS) {
+        int n = sequence_len(*p);
+        Cell cell = 0;
+        int i;
+        for (i = 0; i < n && p[i]; i++) cell |= (Cell)p[i] << (8 * i);
+        p += i;
+        if (cell < 0x20 || cell == 0x7F) cell = '?';
+        if (col >= 0) s->back[row][col] = cell;
+        col++;
+    }
+    return col - start;
+}
+
+int screen_printf(Screen *s, int row, int col, const char *fmt, ...) {
+    char line[4 * SCREEN_COLS + 1];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    return screen_put(s, row, col, line);
+}
+
+void screen_cursor(Screen *s, int row, int col) {
+    s->cursor_row = row;
+    s->cursor_col = col < SCREEN_COLS ? col : SCREEN_COLS - 1;
+}
+
+static void drain(Screen *s, int fd) {
+    int off = 0;
+    while (off < s->out_len) {
+        int n = write(fd, s->out + off, s->out_len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        off += n;
+    }
+    s->bytes_written += off;
+    s->out_len = 0;
+}
+
+static void emit(Screen *s, int fd, const char *bytes, int len) {
+    if (s->out_len + len > SCREEN_OUT_SIZE) drain(s, fd);
+    memcpy(s->out + s->out_len, bytes, len);
+    s->out_len += len;
+}
+
+static void emit_cell(Screen *s, int fd, Cell cell) {
+    char bytes[4];
+    int n = 0;
+    while (n < 4 && (cell >> (8 * n)) & 0xFF) {
+        bytes[n] = (cell >> (8 * n)) & 0xFF;
+        n++;
+    }
+    emit(s, fd, bytes, n);
+}
+
+static void emit_move(Screen *s, int fd, int row, int col) {
+    char seq[16];
+    int n = snprintf(seq, sizeof(seq), "\033[%d;%dH", row + 1, col + 1);
+    emit(s, fd, seq, n);
+}
+
+// Writes the difference between the back buffer and the terminal. Short
+// runs of unchanged cells between changes are rewritten, longer ones are
+// skipped with a cursor move. Returns the bytes written.
+int screen_flush(Screen *s, int fd, long long now) {
+    s->out_len = 0;
+    long long before = s->bytes_written;
+    emit(s, fd, "\033[?25l", 6);
+    if (!s->painted) {
+        emit(s, fd, "\033[2J", 4);
+        for (int r = 0; r < SCREEN_ROWS; r++) {
+            for (int c = 0; c < SCREEN_COLS; c++) s->front[r][c] = BLANK;
+        }
+        s->painted = 1;
+    }
+
+    int changed = 0;
+    for (int r = 0; r < SCREEN_ROWS; r++) {
+        int at = -1;                // terminal cursor column on this row, -1 = unknown
+        for (int c = 0; c < SCREEN_COLS; c++) {
+            if (s->back[r][c] == s->front[r][c]) continue;
+            if (at >= 0 && c > at && c - at <= SCREEN_SKIP_MAX) {
+                for (int k = at; k < c; k++) emit_cell(s, fd, s->front[r][k]);
+            } else if (at != c) {
+                emit_move(s, fd, r, c);
+            }
+            emit_cell(s, fd, s->back[r][c]);
+            s->front[r][c] = s->back[r][c];
+            // Past the last column the terminal wraps on the next write
+            at = c + 1 < SCREEN_COLS ? c + 1 : -1;
+            changed++;
+        }
+    }
+    s->last_flush = now;
+    if (changed == 0 && s->out_len == 6) {
+        s->out_len = 0;
+        return 0;
+    }
+
+    emit_move(s, fd, s->cursor_row, s->cursor_col);
+    emit(s, fd, "\033[?25h", 6);
+    drain(s, fd);
+    return s->bytes_written - before;
+}
@@ -0,0 +1,41 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stdint.h>
+
+// Double-buffered terminal renderer for the client. Each frame is drawn
+// from scratch into the back buffer; screen_flush() compares it with what
+// the terminal already shows and sends only the cells that changed, cursor
+// moves included, in one write(). A frame that changes nothing writes
+// nothing, so the caller can redraw as often as it likes and cap flushes
+// at SCREEN_FRAME_MS to coalesce bursts of updates.
+
+#define SCREEN_ROWS 24
+#define SCREEN_COLS 80
+#define SCREEN_FRAME_MS 50          // at most 20 frames a second
+#define SCREEN_OUT_SIZE 16384
+#define SCREEN_SKIP_MAX 6           // unchanged cells rewritten rather than jumped over
+
+typedef uint32_t Cell;              // one column: a UTF-8 sequence in the low bytes
+
+typedef struct {
+    Cell front[SCREEN_ROWS][SCREEN_COLS];      // what the terminal shows
+    Cell back[SCREEN_ROWS][SCREEN_COLS];       // the frame being drawn
+    int cursor_row;                 // where the cursor rests between frames
+    int cursor_col;
+    int painted;                    // front is valid, 0 forces a full repaint
+    long long last_flush;           // CLOCK_MONOTONIC ms
+    long long bytes_written;
+    int out_len;
+    char out[SCREEN_OUT_SIZE];
+} Screen;
+
+void screen_init(Screen *s);
+void screen_clear(Screen *s);
+int screen_put(Screen *s, int row, int col, const char *text);
+int screen_printf(Screen *s, int row, int col, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+void screen_cursor(Screen *s, int row, int col);
+int screen_flush(Screen *s, int fd, long long now);
+
+#endif
@@ -1,859 +1,4501 @@
-#define _POSIX_C_SOURCE 200809L
-#define _XOPEN_SOURCE 700
-#define _DEFAULT_SOURCE
-
-#include <signal.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <pthread.h>
-#include <arpa/inet.h>
-#include <ctype.h>
-#include <time.h>
-#include <sys/select.h>
-#include <stdarg.h>
-#include <sys/mman.h>
-#include <sys/wait.h>
-#include <fcntl.h>
-#include <errno.h>
-
-#define PORT 8080
-#define MAX_CLIENTS 3
-#define WORD_LEN 20
-#define NAME_SIZE 50
-#define ANSWER_SIZE 50
-#define TOTAL_ROUNDS 5
-#define TIMEOUT_SECONDS 15
-#define WORD_DATABASE_SIZE 10
-
-typedef struct {
-    int socket;
-    char name[NAME_SIZE];
-    int total_score;
-    int round_lives;
-    int round_eliminated;
-    int ready;
-    int connected;
-} Player;
-
-typedef struct {
-    char word[WORD_LEN];
-    char answer_space[ANSWER_SIZE];
-    int current_player;
-    int round;
-    Player players[MAX_CLIENTS];
-    int player_count;
-    int game_started;
-    int game_finished;
-    int turn_in_progress;
-    pthread_mutex_t lock;
-    pthread_mutexattr_t lock_attr;
-} GameState;
-
-typedef struct {
-    char message[512];
-    time_t timestamp;
-} LogEntry;
-
-typedef struct {
-    LogEntry entries[2000];
-    int count;
-    pthread_mutex_t lock;
-    pthread_mutexattr_t lock_attr;
-} LogBuffer;
-
-typedef struct {
-    char player_name[NAME_SIZE];
-    int wins;
-} ScoreRecord;
-
-typedef struct {
-    ScoreRecord records[100];
-    int count;
-    pthread_mutex_t lock;
-    pthread_mutexattr_t lock_attr;
-} ScoreData;
-
-GameState *game = NULL;
-LogBuffer *log_buffer = NULL;
-ScoreData *score_data = NULL;
-pthread_t logging_thread;
-pthread_t scheduler_thread;
-int logging_active = 1;
-int scheduler_active = 1;
-FILE *log_file = NULL;
-
-const char *word_database[WORD_DATABASE_SIZE] = {
-    "LEMON", "APPLE", "GRAPE", "MANGO", "PEACH",
-    "ORANGE", "BANANA", "CHERRY", "MELON", "PAPAYA"
-};
-
-void add_log(const char *format, ...) {
-    if (!log_buffer) return;
-    pthread_mutex_lock(&log_buffer->lock);
-    if (log_buffer->count < 2000) {
-        va_list args;
-        va_start(args, format);
-        vsnprintf(log_buffer->entries[log_buffer->count].message, 512, format, args);
-        va_end(args);
-        log_buffer->entries[log_buffer->count].timestamp = time(NULL);
-        log_buffer->count++;
-    }
-    pthread_mutex_unlock(&log_buffer->lock);
-}
-
-void *logger_func(void *arg) {
-    log_file = fopen("game.log", "a");
-    if (!log_file) return NULL;
-    
-    time_t now = time(NULL);
-    fprintf(log_file, "\n=== GAME SESSION STARTED ===\n");
-    fprintf(log_file, "Time: %s\n", ctime(&now));
-    fflush(log_file);
-    
-    int last = 0;
-    while (logging_active || last < log_buffer->count) {
-        pthread_mutex_lock(&log_buffer->lock);
-        while (last < log_buffer->count) {
-            LogEntry *e = &log_buffer->entries[last];
-            char *t = ctime(&e->timestamp);
-            if (t) {
-                t[strlen(t)-1] = '\0';
-                fprintf(log_file, "[%s] %s\n", t, e->message);
-            }
-            fflush(log_file);
-            last++;
-        }
-        pthread_mutex_unlock(&log_buffer->lock);
-        usleep(50000);
-    }
-    
-    fprintf(log_file, "=== SESSION END ===\n\n");
-    fclose(log_file);
-    return NULL;
-}
-
-void load_scores() {
-    pthread_mutex_lock(&score_data->lock);
-    score_data->count = 0;
-    
-    FILE *f = fopen("scores.txt", "r");
-    if (f) {
-        char line[256];
-        while (fgets(line, sizeof(line), f) && score_data->count < 100) {
-            char name[NAME_SIZE];
-            int wins;
-            if (sscanf(line, "%[^,],%d", name, &wins) == 2) {
-                strcpy(score_data->records[score_data->count].player_name, name);
-                score_data->records[score_data->count].wins = wins;
-                score_data->count++;
-            }
-        }
-        fclose(f);
-        add_log("Loaded %d player records from scores.txt", score_data->count);
-    } else {
-        add_log("scores.txt not found, will create new file");
-    }
-    pthread_mutex_unlock(&score_data->lock);
-}
-
-void save_scores() {
-    pthread_mutex_lock(&score_data->lock);
-    
-    FILE *f = fopen("scores.txt", "w");
-    if (f) {
-        for (int i = 0; i < score_data->count; i++) {
-            fprintf(f, "%s,%d\n", 
-                    score_data->records[i].player_name,
-                    score_data->records[i].wins);
-        }
-        fclose(f);
-        add_log("Saved %d player records to scores.txt", score_data->count);
-    }
-    
-    pthread_mutex_unlock(&score_data->lock);
-}
-
-void update_winner(const char *name) {
-    pthread_mutex_lock(&score_data->lock);
-    
-    int found = 0;
-    for (int i = 0; i < score_data->count; i++) {
-        if (strcmp(score_data->records[i].player_name, name) == 0) {
-            score_data->records[i].wins++;
-            found = 1;
-            add_log("Updated %s wins to %d", name, score_data->records[i].wins);
-            break;
-        }
-    }
-    
-    if (!found && score_data->count < 100) {
-        strcpy(score_data->records[score_data->count].player_name, name);
-        score_data->records[score_data->count].wins = 1;
-        score_data->count++;
-        add_log("Added new winner: %s", name);
-    }
-    
-    pthread_mutex_unlock(&score_data->lock);
-}
-
-void send_msg(int sock, const char *msg) {
-    if (sock <= 0) return;
-    char buf[512];
-    snprintf(buf, sizeof(buf), "%s\n", msg);
-    send(sock, buf, strlen(buf), MSG_NOSIGNAL);
-}
-
-void broadcast(const char *msg) {
-    for (int i = 0; i < game->player_count; i++) {
-        if (game->players[i].connected) {
-            send_msg(game->players[i].socket, msg);
-        }
-    }
-}
-
-void send_board() {
-    char msg[100];
-    snprintf(msg, sizeof(msg), "BOARD:%s", game->answer_space);
-    broadcast(msg);
-    add_log("Broadcast board: %s", game->answer_space);
-}
-
-void send_state(int idx) {
-    if (idx < 0 || idx >= game->player_count) return;
-    char msg[100];
-    // CRITICAL: Include elimination status in state message
-    snprintf(msg, sizeof(msg), "STATE:R%d|L%d|S%d|E%d", 
-             game->round, 
-             game->players[idx].round_lives, 
-             game->players[idx].total_score,
-             game->players[idx].round_eliminated);  // E0=active, E1=eliminated
-    send_msg(game->players[idx].socket, msg);
-    add_log("Sent state to %s: R%d L%d S%d E%d", 
-            game->players[idx].name, game->round, 
-            game->players[idx].round_lives, 
-            game->players[idx].total_score,
-            game->players[idx].round_eliminated);
-}
-
-void broadcast_states() {
-    for (int i = 0; i < game->player_count; i++) {
-        if (game->players[i].connected) {
-            send_state(i);
-        }
-    }
-}
-
-void init_answer() {
-    int len = strlen(game->word);
-    for (int i = 0; i < len; i++) {
-        game->answer_space[i] = '_';
-    }
-    game->answer_space[len] = '\0';
-}
-
-void select_word() {
-    srand(time(NULL) + game->round * 123);
-    int idx = rand() % WORD_DATABASE_SIZE;
-    strcpy(game->word, word_database[idx]);
-    add_log("Round %d: Selected word %s", game->round, game->word);
-}
-
-int check_letter(char c) {
-    c = toupper(c);
-    if (!isalpha(c)) return -1;
-    
-    int found = 0;
-    for (int i = 0; i < strlen(game->word); i++) {
-        if (game->word[i] == c && game->answer_space[i] == '_') {
-            found = 1;
-        }
-    }
-    return found ? 1 : 0;
-}
-
-void update_answer(char c) {
-    c = toupper(c);
-    for (int i = 0; i < strlen(game->word); i++) {
-        if (game->word[i] == c && game->answer_space[i] == '_') {
-            game->answer_space[i] = c;
-        }
-    }
-}
-
-int is_complete() {
-    return strchr(game->answer_space, '_') == NULL;
-}
-
-void init_round() {
-    select_word();
-    init_answer();
-    
-    for (int i = 0; i < game->player_count; i++) {
-        game->players[i].ready = 0;
-        game->players[i].round_lives = 3;
-        game->players[i].round_eliminated = 0;  // RESET elimination
-    }
-    
-    game->turn_in_progress = 0;
-    
-    add_log("Round %d initialized - ALL players reset to 3 lives, not eliminated", game->round);
-}
-
-int active_count() {
-    int cnt = 0;
-    for (int i = 0; i < game->player_count; i++) {
-        if (!game->players[i].round_eliminated && game->players[i].connected) {
-            cnt++;
-        }
-    }
-    return cnt;
-}
-
-void show_scores() {
-    char msg[512] = "ROUND_SCORES:";
-    for (int i = 0; i < game->player_count; i++) {
-        char info[100];
-        if (game->players[i].round_eliminated) {
-            snprintf(info, sizeof(info), "%s: ELIMINATED (Total: %d pts)", 
-                     game->players[i].name, game->players[i].total_score);
-        } else {
-            snprintf(info, sizeof(info), "%s: %d pts (%d lives)", 
-                     game->players[i].name, 
-                     game->players[i].total_score, 
-                     game->players[i].round_lives);
-        }
-        if (i > 0) strcat(msg, "|");
-        strcat(msg, info);
-    }
-    broadcast(msg);
-}
-
-void save_final_results() {
-    FILE *f = fopen("final_scores.txt", "w");
-    if (!f) return;
-    
-    time_t now = time(NULL);
-    fprintf(f, "=== GAME FINAL RESULTS ===\n");
-    fprintf(f, "Date: %s\n", ctime(&now));
-    fprintf(f, "Total Rounds: %d\n\n", TOTAL_ROUNDS);
-    
-    Player sorted[MAX_CLIENTS];
-    memcpy(sorted, game->players, sizeof(Player) * game->player_count);
-    
-    for (int i = 0; i < game->player_count - 1; i++) {
-        for (int j = i + 1; j < game->player_count; j++) {
-            if (sorted[j].total_score > sorted[i].total_score) {
-                Player tmp = sorted[i];
-                sorted[i] = sorted[j];
-                sorted[j] = tmp;
-            }
-        }
-    }
-    
-    fprintf(f, "RANKINGS:\n");
-    for (int i = 0; i < game->player_count; i++) {
-        fprintf(f, "%d. %s - %d points\n", 
-                i+1, sorted[i].name, sorted[i].total_score);
-    }
-    
-    fprintf(f, "\nWINNER: %s with %d points!\n", sorted[0].name, sorted[0].total_score);
-    fclose(f);
-    
-    update_winner(sorted[0].name);
-    save_scores();
-    
-    add_log("Game completed - Winner: %s (%d pts)", sorted[0].name, sorted[0].total_score);
-}
-
-int next_player() {
-    int start = game->current_player;
-    int next = (game->current_player + 1) % game->player_count;
-    
-    while (next != start) {
-        if (!game->players[next].round_eliminated && game->players[next].connected) {
-            return next;
-        }
-        next = (next + 1) % game->player_count;
-    }
-    
-    if (!game->players[start].round_eliminated && game->players[start].connected) {
-        return start;
-    }
-    return -1;
-}
-
-void handle_move(int idx, const char *move) {
-    Player *p = &game->players[idx];
-    
-    add_log("%s handling move: %s", p->name, move);
-    
-    if (strncmp(move, "LETTER:", 7) == 0) {
-        char letter = move[7];
-        int result = check_letter(letter);
-        
-        if (result == -1) {
-            send_msg(p->socket, "INVALID");
-            add_log("%s: invalid letter", p->name);
-        } else if (result == 1) {
-            p->total_score++;
-            update_answer(letter);
-            send_msg(p->socket, "CORRECT_LETTER");
-            add_log("%s: correct letter %c (+1 pt, total %d)", 
-                    p->name, letter, p->total_score);
-            
-            usleep(100000);
-            send_board();
-            broadcast_states();
-        } else {
-            p->round_lives--;
-            send_msg(p->socket, "WRONG_LETTER");
-            add_log("%s: wrong letter %c (-1 life, %d left)", 
-                    p->name, letter, p->round_lives);
-            
-            if (p->round_lives <= 0) {
-                p->round_eliminated = 1;
-                send_msg(p->socket, "ELIMINATED");
-                add_log("%s: eliminated (no lives left in round %d)", 
-                        p->name, game->round);
-            }
-            
-            broadcast_states();
-        }
-    }
-    else if (strncmp(move, "WORD:", 5) == 0) {
-        char word[WORD_LEN];
-        strcpy(word, move + 5);
-        for (int i = 0; word[i]; i++) word[i] = toupper(word[i]);
-        
-        if (strcmp(word, game->word) == 0) {
-            p->total_score += 3;
-            strcpy(game->answer_space, game->word);
-            send_msg(p->socket, "CORRECT_WORD");
-            add_log("%s: correct word (+3 pts, total %d)", p->name, p->total_score);
-            
-            usleep(100000);
-            send_board();
-            broadcast_states();
-        } else {
-            p->round_eliminated = 1;
-            p->round_lives = 0;
-            send_msg(p->socket, "WRONG_WORD");
-            add_log("%s: wrong word guess - eliminated from round %d", 
-                    p->name, game->round);
-            send_state(idx);
-        }
-    }
-    
-    p->ready = 1;
-}
-
-void timeout_handler(int idx) {
-    sleep(TIMEOUT_SECONDS);
-    
-    pthread_mutex_lock(&game->lock);
-    Player *p = &game->players[idx];
-    
-    if (!p->ready && game->current_player == idx) {
-        p->total_score--;
-        p->ready = 1;
-        add_log("%s: timed out (-1 pt, total %d)", p->name, p->total_score);
-        send_msg(p->socket, "TIMEOUT");
-        send_state(idx);  // Send state to sync client
-    }
-    pthread_mutex_unlock(&game->lock);
-    exit(0);
-}
-
-void client_handler(int idx) {
-    int sock = game->players[idx].socket;
-    char buf[256];
-    
-    memset(buf, 0, sizeof(buf));
-    int n = recv(sock, buf, sizeof(buf)-1, 0);
-    if (n <= 0) {
-        close(sock);
-        exit(0);
-    }
-    
-    buf[strcspn(buf, "\r\n")] = 0;
-    if (strncmp(buf, "NAME:", 5) != 0) {
-        close(sock);
-        exit(0);
-    }
-    
-    pthread_mutex_lock(&game->lock);
-    strcpy(game->players[idx].name, buf + 5);
-    game->players[idx].total_score = 0;
-    game->players[idx].round_lives = 3;
-    game->players[idx].round_eliminated = 0;
-    game->players[idx].connected = 1;
-    pthread_mutex_unlock(&game->lock);
-    
-    add_log("Player %s connected (slot %d)", game->players[idx].name, idx);
-    
-    while (!game->game_started) usleep(100000);
-    
-    sleep(1);
-    send_board();
-    send_state(idx);
-    
-    while (!game->game_finished) {
-        pthread_mutex_lock(&game->lock);
-        
-        if (game->current_player == idx && 
-            !game->players[idx].round_eliminated && 
-            !game->players[idx].ready &&
-            !game->turn_in_progress) {
-            
-            game->turn_in_progress = 1;
-            
-            char turn_msg[100];
-            snprintf(turn_msg, sizeof(turn_msg), "TURN:%s", game->players[idx].name);
-            pthread_mutex_unlock(&game->lock);
-            
-            broadcast(turn_msg);
-            sleep(1);
-            send_msg(sock, "PROMPT");
-            
-            pid_t timeout_pid = fork();
-            if (timeout_pid == 0) {
-                timeout_handler(idx);
-            }
-            
-            fd_set fds;
-            struct timeval tv;
-            FD_ZERO(&fds);
-            FD_SET(sock, &fds);
-            tv.tv_sec = TIMEOUT_SECONDS + 1;
-            tv.tv_usec = 0;
-            
-            int ready = select(sock + 1, &fds, NULL, NULL, &tv);
-            
-            if (ready > 0) {
-                memset(buf, 0, sizeof(buf));
-                n = recv(sock, buf, sizeof(buf)-1, 0);
-                
-                if (n > 0) {
-                    buf[strcspn(buf, "\r\n")] = 0;
-                    kill(timeout_pid, SIGKILL);
-                    waitpid(timeout_pid, NULL, 0);
-                    
-                    add_log("%s: received move %s", game->players[idx].name, buf);
-                    
-                    pthread_mutex_lock(&game->lock);
-                    handle_move(idx, buf);
-                    game->turn_in_progress = 0;
-                    pthread_mutex_unlock(&game->lock);
-                } else {
-                    pthread_mutex_lock(&game->lock);
-                    game->players[idx].connected = 0;
-                    game->players[idx].round_eliminated = 1;
-                    game->players[idx].ready = 1;
-                    game->turn_in_progress = 0;
-                    pthread_mutex_unlock(&game->lock);
-                    kill(timeout_pid, SIGKILL);
-                    waitpid(timeout_pid, NULL, 0);
-                    break;
-                }
-            } else {
-                waitpid(timeout_pid, NULL, 0);
-                pthread_mutex_lock(&game->lock);
-                game->turn_in_progress = 0;
-                pthread_mutex_unlock(&game->lock);
-            }
-        } else {
-            pthread_mutex_unlock(&game->lock);
-            usleep(200000);
-        }
-    }
-    
-    add_log("Player %s disconnected", game->players[idx].name);
-    close(sock);
-    exit(0);
-}
-
-void *scheduler_func(void *arg) {
-    add_log("Round Robin scheduler started");
-    
-    while (scheduler_active && !game->game_finished) {
-        pthread_mutex_lock(&game->lock);
-        
-        if (!game->game_started) {
-            pthread_mutex_unlock(&game->lock);
-            usleep(100000);
-            continue;
-        }
-        
-        int curr = game->current_player;
-        Player *p = &game->players[curr];
-        
-        if (p->ready) {
-            add_log("Turn complete for %s", p->name);
-            
-            if (is_complete() || active_count() <= 0) {
-                add_log("Round %d complete", game->round);
-                
-                char reveal[100];
-                snprintf(reveal, sizeof(reveal), "REVEAL:%s", game->word);
-                pthread_mutex_unlock(&game->lock);
-                
-                broadcast(reveal);
-                sleep(3);
-                
-                pthread_mutex_lock(&game->lock);
-                show_scores();
-                pthread_mutex_unlock(&game->lock);
-                sleep(4);
-                
-                pthread_mutex_lock(&game->lock);
-                game->round++;
-                
-                if (game->round <= TOTAL_ROUNDS) {
-                    add_log("Starting round %d/%d", game->round, TOTAL_ROUNDS);
-                    
-                    init_round();  // This resets round_eliminated to 0
-                    
-                    game->current_player = 0;
-                    while (game->current_player < game->player_count && 
-                           !game->players[game->current_player].connected) {
-                        game->current_player++;
-                    }
-                    
-                    pthread_mutex_unlock(&game->lock);
-                    
-                    sleep(1);
-                    send_board();
-                    broadcast_states();  // Send states with E0 (not eliminated)
-                    
-                    add_log("Round %d ready", game->round);
-                    
-                    pthread_mutex_lock(&game->lock);
-                } else {
-                    add_log("All %d rounds completed", TOTAL_ROUNDS);
-                    game->game_finished = 1;
-                    pthread_mutex_unlock(&game->lock);
-                    broadcast("END");
-                    save_final_results();
-                    pthread_mutex_lock(&game->lock);
-                }
-            } else {
-                int nxt = next_player();
-                if (nxt >= 0) {
-                    game->current_player = nxt;
-                    game->players[nxt].ready = 0;
-                    add_log("Turn advanced to %s", game->players[nxt].name);
-                } else {
-                    game->game_finished = 1;
-                }
-            }
-        }
-        
-        pthread_mutex_unlock(&game->lock);
-        usleep(100000);
-    }
-    
-    add_log("Scheduler ended");
-    return NULL;
-}
-
-void sigchld_handler(int sig) {
-    int saved = errno;
-    while (waitpid(-1, NULL, WNOHANG) > 0);
-    errno = saved;
-}
-
-void sigint_handler(int sig) {
-    printf("\n\nShutting down server...\n");
-    
-    if (game) {
-        game->game_finished = 1;
-        broadcast("END");
-        if (game->round > 1) {
-            save_final_results();
-        }
-    }
-    
-    logging_active = 0;
-    scheduler_active = 0;
-    
-    add_log("Server shutdown via SIGINT");
-    sleep(1);
-    
-    exit(0);
-}
-
-int main() {
-    int server_fd, new_sock;
-    struct sockaddr_in addr;
-    int addrlen = sizeof(addr);
-    
-    struct sigaction sa;
-    sa.sa_handler = sigchld_handler;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
-    sigaction(SIGCHLD, &sa, NULL);
-    signal(SIGINT, sigint_handler);
-    
-    game = mmap(NULL, sizeof(GameState), PROT_READ|PROT_WRITE, 
-                MAP_SHARED|MAP_ANONYMOUS, -1, 0);
-    log_buffer = mmap(NULL, sizeof(LogBuffer), PROT_READ|PROT_WRITE, 
-                      MAP_SHARED|MAP_ANONYMOUS, -1, 0);
-    score_data = mmap(NULL, sizeof(ScoreData), PROT_READ|PROT_WRITE,
-                      MAP_SHARED|MAP_ANONYMOUS, -1, 0);
-    
-    if (game == MAP_FAILED || log_buffer == MAP_FAILED || score_data == MAP_FAILED) {
-        perror("mmap failed");
-        exit(1);
-    }
-    
-    pthread_mutexattr_init(&game->lock_attr);
-    pthread_mutexattr_setpshared(&game->lock_attr, PTHREAD_PROCESS_SHARED);
-    pthread_mutex_init(&game->lock, &game->lock_attr);
-    
-    pthread_mutexattr_init(&log_buffer->lock_attr);
-    pthread_mutexattr_setpshared(&log_buffer->lock_attr, PTHREAD_PROCESS_SHARED);
-    pthread_mutex_init(&log_buffer->lock, &log_buffer->lock_attr);
-    
-    pthread_mutexattr_init(&score_data->lock_attr);
-    pthread_mutexattr_setpshared(&score_data->lock_attr, PTHREAD_PROCESS_SHARED);
-    pthread_mutex_init(&score_data->lock, &score_data->lock_attr);
-    
-    log_buffer->count = 0;
-    game->player_count = 0;
-    game->current_player = 0;
-    game->round = 1;
-    game->game_started = 0;
-    game->game_finished = 0;
-    game->turn_in_progress = 0;
-    
-    pthread_create(&logging_thread, NULL, logger_func, NULL);
-    
-    load_scores();
-    add_log("Server initialized");
-    
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
-        perror("socket failed");
-        exit(1);
-    }
-    
-    int opt = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(PORT);
-    
-    if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        perror("bind failed");
-        exit(1);
-    }
-    
-    if (listen(server_fd, 3) < 0) {
-        perror("listen failed");
-        exit(1);
-    }
-    
-    printf("╔════════════════════════════════════════╗\n");
-    printf("║   Word Guessing Server Started         ║\n");
-    printf("║   Port: %d                              ║\n", PORT);
-    printf("║   Waiting for %d players...            ║\n", MAX_CLIENTS);
-    printf("╚════════════════════════════════════════╝\n\n");
-    
-    add_log("Server listening on port %d", PORT);
-    
-    while (game->player_count < MAX_CLIENTS) {
-        if ((new_sock = accept(server_fd, (struct sockaddr *)&addr, 
-                              (socklen_t*)&addrlen)) < 0) {
-            perror("accept failed");
-            continue;
-        }
-        
-        pthread_mutex_lock(&game->lock);
-        int idx = game->player_count;
-        game->players[idx].socket = new_sock;
-        game->players[idx].ready = 0;
-        game->players[idx].connected = 0;
-        game->player_count++;
-        pthread_mutex_unlock(&game->lock);
-        
-        printf("Connection %d accepted\n", idx + 1);
-        add_log("Connection %d accepted", idx + 1);
-        
-        pid_t pid = fork();
-        if (pid < 0) {
-            perror("fork failed");
-            close(new_sock);
-            game->player_count--;
-        } else if (pid == 0) {
-            close(server_fd);
-            client_handler(idx);
-            exit(0);
-        }
-    }
-    
-    printf("\n╔════════════════════════════════════════╗\n");
-    printf("║   All %d players connected!            ║\n", MAX_CLIENTS);
-    printf("╚════════════════════════════════════════╝\n\n");
-    
-    int all_ready = 0;
-    while (!all_ready) {
-        pthread_mutex_lock(&game->lock);
-        all_ready = 1;
-        for (int i = 0; i < game->player_count; i++) {
-            if (!game->players[i].connected) {
-                all_ready = 0;
-                break;
-            }
-        }
-        pthread_mutex_unlock(&game->lock);
-        if (!all_ready) usleep(100000);
-    }
-    
-    printf("Players:\n");
-    for (int i = 0; i < game->player_count; i++) {
-        printf("  %d. %s\n", i+1, game->players[i].name);
-    }
-    
-    sleep(2);
-    printf("\nStarting game - %d rounds total...\n\n", TOTAL_ROUNDS);
-    
-    init_round();
-    
-    pthread_create(&scheduler_thread, NULL, scheduler_func, NULL);
-    
-    game->game_started = 1;
-    add_log("Game started with %d players", game->player_count);
-    
-    while (!game->game_finished) {
-        sleep(1);
-    }
-    
-    printf("\n╔════════════════════════════════════════╗\n");
-    printf("║          Game Finished!                ║\n");
-    printf("║   Check final_scores.txt for results   ║\n");
-    printf("╚════════════════════════════════════════╝\n\n");
-    
-    sleep(2);
-    
-    scheduler_active = 0;
-    pthread_join(scheduler_thread, NULL);
-    
-    logging_active = 0;
-    pthread_join(logging_thread, NULL);
-    
-    close(server_fd);
-    
-    pthread_mutex_destroy(&game->lock);
-    pthread_mutex_destroy(&log_buffer->lock);
-    pthread_mutex_destroy(&score_data->lock);
-    
-    munmap(game, sizeof(GameState));
-    munmap(log_buffer, sizeof(LogBuffer));
-    munmap(score_data, sizeof(ScoreData));
-    
-    printf("Server shutdown complete. Ready for next game.\n");
-    
-    return 0;
-}
\ No newline at end of file
+#define _POSIX_C_SOURCE 200809L
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <time.h>
+#include <stdarg.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stddef.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include "dictionary.h"
+#include "game_state.h"
+#include "trace.h"
+#include "profiler.h"
+#include "history.h"
+#include "analytics.h"
+#include "match.h"
+#include "tournament.h"
+#include "replica.h"
+#include "gateway.h"
+
+#define PORT 8080
+#define TOTAL_ROUNDS 5
+#define TIMEOUT_SECONDS 15     // -t: default turn length
+#define WORD_DATABASE_SIZE 10
+#define DICTIONARY_FILE "words.txt"
+#define SKILL_MIN_POINTS -5     // average points per game mapped to the easiest bucket
+#define SKILL_MAX_POINTS 15     // ... and to the hardest
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define MAX_ROOMS 64            // games running at once; further rooms wait in the queue
+#define MATCH_TICK_MS 100       // how often aged waiters are reconsidered
+#define ROOM_STOP_MS 10000      // on shutdown, wait this long for rooms to commit
+#define LISTEN_TAG MATCH_CAPACITY
+#define VOLLEY_PAUSE_MS 1000    // simultaneous mode: results on screen before the next volley
+#define TOURNAMENT_REGISTER_MS 60000    // -R: the first draw waits this long for absent entrants
+#define MAX_SPECTATORS 256
+#define ENTRANT_TAG (LISTEN_TAG + 1)
+#define SPECTATOR_TAG (ENTRANT_TAG + TOURNAMENT_MAX_ENTRANTS)
+#define HEARTBEAT_MS 500        // -P: PING interval while a room is running
+#define HEARTBEAT_DEAD_MS 2000  // -D: silence before a player is disconnected
+#define RTT_MAX_MS 2000         // round trip samples above this are not believed
+#define KEEPALIVE_IDLE_S 2      // TCP keepalive for sockets no room is pinging
+#define KEEPALIVE_INTERVAL_S 1
+#define KEEPALIVE_COUNT 3
+#define CONTROL_TAG (SPECTATOR_TAG + MAX_SPECTATORS)
+#define UPGRADE_TAG (CONTROL_TAG + 1)
+#define STANDBY_TAG (UPGRADE_TAG + 1)
+#define STANDBY_POLL_MS 10      // how often the standby tails the change log
+#define TAKEOVER_WAIT_MS 500    // for the dead primary's rooms to be gone
+#define GATEWAY_TAG (STANDBY_TAG + 1)
+#define GATEWAY_POLL_MS 20      // how often the gateway tails the room feeds
+#define GATEWAY_RING 65536      // framed broadcasts kept per room for its watchers, power of two
+#define GATEWAY_HANDSHAKE_MS 5000   // for a browser to send its whole HTTP request
+#define GATEWAY_RELAY_SIZE 8192     // frames queued for one playing browser
+#define GATEWAY_MAX_CONNS 1048576
+#define CHAT_TEXT_MAX 100       // characters of one chat message, the rest is cut
+#define CHAT_FLUSH_MS 250       // a room sends the chat posted since, as one line
+#define CHAT_RATE 1             // chat messages a second per connection,
+#define CHAT_BURST 5            // after a burst of this many
+#define HANDSHAKE_MS 5000       // for a new connection to send its NAME line
+#define HANDSHAKE_MAX 1024      // connections yet to send NAME before accepting pauses
+#define ACCEPT_RATE 20          // -A: new connections a second per client address,
+#define ACCEPT_BURST_S 5        // after a burst of this many seconds' worth
+#define ACCEPT_RATE_MAX 10000   // highest -A, so a burst's milli-tokens fit in an int
+#define ACCEPT_RETRY_MS 100     // a listener paused for want of descriptors tries again
+#define ADDR_SLOTS 4096         // per-address accept buckets, power of two
+#define INPUT_LINE_RATE 20      // lines a second from a player's connection,
+#define INPUT_LINE_BURST 50     // after a burst of this many
+#define INPUT_BYTE_RATE 2048    // bytes a second, likewise
+#define INPUT_BYTE_BURST 8192
+#define HANDOFF_MAGIC 0x57475550    // "WGUP"
+#define HANDOFF_VERSION 1
+#define HANDOFF_BATCH 200       // sockets per SCM_RIGHTS message, the kernel takes 253
+#define HANDOFF_IO_MS 5000      // a peer stalled this long mid-handoff is given up on
+#define HANDOFF_GRACE_MS 10000  // on top of two turns, for rooms to reach a turn boundary
+
+// A player on the way into a room
+typedef struct {
+    int fd;
+    int rating;
+    char name[NAME_SIZE];
+} Seat;
+
+enum {
+    HANDOFF_HELLO, HANDOFF_ACCEPTED, HANDOFF_REFUSED, HANDOFF_WAITERS, HANDOFF_LISTENER,
+    HANDOFF_STANDBY,                // -B asks to follow this server
+    HANDOFF_SEATS,                  // to the standby: a replicated room's sockets
+    HANDOFF_STOP                    // to the standby: clean shutdown, do not take over
+};
+
+// Control messages of an upgrade (-U). The new server opens with its
+// layout, so the old one refuses a build it could not hand rooms to.
+typedef struct {
+    int magic;
+    int kind;                       // HANDOFF_*
+    int count;                      // records that follow, one socket each
+    int value;                      // HANDOFF_LISTENER: rooms started so far
+    int layout[4];                  // version, then GameState, OutboundPool and Waiter sizes
+    int pid;                        // HANDOFF_SEATS: the room worker
+} HandoffMsg;
+
+// A frozen room, followed by its GameState and OutboundPool. Its players'
+// sockets ride along in seat order.
+typedef struct {
+    int magic;
+    int room_id;
+    int player_count;
+    int simultaneous;               // the rules the game started under
+    int total_rounds;
+    int validate;
+    int turn_ms;
+} RoomHandoff;
+
+// A room received during an upgrade, until the new main forks it. The
+// standby keeps its copies of the primary's rooms in the same form.
+typedef struct {
+    RoomHandoff head;
+    int fds[MAX_CLIENTS];
+    GameState *game;
+    OutboundPool *outbound;         // NULL: start with empty queues
+    pid_t pid;                      // standby: the primary's room worker
+    int seated;                     // standby: sockets received
+} ResumedRoom;
+
+GameState *game = NULL;
+LogBuffer *log_buffer = NULL;
+ScoreData *score_data = NULL;
+SolverState *solver = NULL;
+OutboundPool *outbound = NULL;
+ResultQueue *results = NULL;
+Analytics *analytics = NULL;
+MatchQueue *match_queue = NULL;     // main process only
+Tournament *tournament = NULL;      // -R, main process only
+HeatResult *heat_results = NULL;    // one per room slot
+HeatResult *room_heat = NULL;       // in a room worker playing a tournament heat
+Dictionary *dictionary = NULL;      // what new rooms play with
+Dictionary *next_dictionary = NULL; // built by the reload thread, not yet swapped in
+HistoryWriter history;      // owned by the persistence thread
+pthread_t logging_thread;
+pthread_t scheduler_thread;
+pthread_t flusher_thread;
+pthread_t persist_thread;
+pthread_t reload_thread;
+int logging_active = 1;
+int scheduler_active = 1;
+int flusher_active = 1;
+int persist_active = 1;
+int scheduler_started = 0;
+volatile sig_atomic_t shutdown_requested = 0;
+volatile sig_atomic_t reload_requested = 0;     // SIGHUP
+volatile sig_atomic_t handoff_requested = 0;    // SIGUSR1, room workers only
+int reload_busy = 0;        // a reload thread is building the next dictionary
+int wake_pipe[2] = {-1, -1};    // wakes the flusher after an enqueue
+int validate_words = 0;     // -v: WORD guesses must be dictionary words
+int use_huge_pages = 0;     // -H: back shared state with huge pages
+int trace_every = 0;        // -T: trace one turn in N, 0 = off
+int simultaneous_rounds = 0;    // -S: all active players guess at once
+int total_rounds = TOTAL_ROUNDS;    // -r: rounds per game
+int heartbeat_ms = HEARTBEAT_MS;    // -P
+int dead_after_ms = HEARTBEAT_DEAD_MS;  // -D
+int accept_rate = ACCEPT_RATE;      // -A, 0 = no per-address limit
+int listen_paused = 0;              // main's listener is out of the epoll set
+long long listen_retry_at = 0;
+int refused = 0;                    // connections over the per-address rate, not logged yet
+int turn_ms = TIMEOUT_SECONDS * 1000;   // -t
+void *shared_arena = NULL;
+size_t shared_arena_size = 0;
+void *room_arena = NULL;
+size_t room_arena_size = 0;
+int room_id = 0;            // 0 in the main process, set in each room worker
+int rooms_started = 0;
+int rooms_running = 0;
+pid_t room_pids[MAX_ROOMS];     // 0 = free
+volatile sig_atomic_t room_exited[MAX_ROOMS];
+int server_fd = -1;
+int epoll_fd = -1;
+int control_fd = -1;        // upgrade requests, abstract unix socket
+int upgrade_fd = -1;        // the new server while handing over to it
+long long upgrade_deadline = 0;
+pid_t handler_pids[MAX_CLIENTS];    // in a room worker
+ResumedRoom *resumed = NULL;        // -U: rooms taken over, not yet forked
+int resumed_count = 0;
+ChangeLog *change_log = NULL;       // created when the first standby attaches
+int change_log_fd = -1;
+int standby_fd = -1;                // the attached standby, main process (its persist thread reads it)
+int replicated = 0;                 // room worker: the standby follows this room
+RoomFeed *feeds = NULL;             // one per room slot, tailed by the gateway
+RoomFeed *room_feed = NULL;         // in a room worker while a gateway runs
+ChatBox *chats = NULL;              // one per room slot
+ChatBox *room_chat = NULL;          // in a room worker and its handlers
+int gateway_port = 0;               // -W: WebSocket port, 0 = no gateway
+int gateway_fd = -1;                // main: sockets of browsers that play
+int spectators[MAX_SPECTATORS];     // tournament spectator sockets, -1 = free
+int registered = 0;                 // entrants connected before the first draw
+long long registration_closes = 0;
+FILE *log_file = NULL;
+
+const char *word_database[WORD_DATABASE_SIZE] = {
+    "LEMON", "APPLE", "GRAPE", "MANGO", "PEACH",
+    "ORANGE", "BANANA", "CHERRY", "MELON", "PAPAYA"
+};
+
+size_t align_up(size_t n, size_t a) {
+    return (n + a - 1) & ~(a - 1);
+}
+
+// Shared regions live in prefaulted mappings, cache-line aligned, so no
+// process takes page faults mid-game. With -H they are backed by huge
+// pages if the system has them reserved.
+void *map_arena(size_t total, size_t *size) {
+    void *base = MAP_FAILED;
+    if (use_huge_pages) {
+        *size = align_up(total, HUGE_PAGE_SIZE);
+        base = mmap(NULL, *size, PROT_READ|PROT_WRITE,
+                    MAP_SHARED|MAP_ANONYMOUS|MAP_POPULATE|MAP_HUGETLB, -1, 0);
+        if (base == MAP_FAILED) {
+            fprintf(stderr, "Huge pages unavailable (%s), using normal pages\n", strerror(errno));
+        }
+    }
+    if (base == MAP_FAILED) {
+        *size = align_up(total, sysconf(_SC_PAGESIZE));
+        base = mmap(NULL, *size, PROT_READ|PROT_WRITE,
+                    MAP_SHARED|MAP_ANONYMOUS|MAP_POPULATE, -1, 0);
+    }
+    return base == MAP_FAILED ? NULL : base;
+}
+
+// Server-wide state, mapped once by main and inherited by every room
+int map_shared_state() {
+    size_t log_off = 0;
+    size_t score_off = align_up(log_off + sizeof(LogBuffer), CACHE_LINE);
+    size_t results_off = align_up(score_off + sizeof(ScoreData), CACHE_LINE);
+    size_t analytics_off = align_up(results_off + sizeof(ResultQueue), CACHE_LINE);
+    size_t heats_off = align_up(analytics_off + sizeof(Analytics), CACHE_LINE);
+    size_t feeds_off = align_up(heats_off + MAX_ROOMS * sizeof(HeatResult), CACHE_LINE);
+    size_t chats_off = align_up(feeds_off + MAX_ROOMS * sizeof(RoomFeed), CACHE_LINE);
+    size_t total = chats_off + MAX_ROOMS * sizeof(ChatBox);
+    
+    void *base = map_arena(total, &shared_arena_size);
+    if (!base) return -1;
+    
+    shared_arena = base;
+    log_buffer = (LogBuffer *)((char *)base + log_off);
+    score_data = (ScoreData *)((char *)base + score_off);
+    results = (ResultQueue *)((char *)base + results_off);
+    analytics = (Analytics *)((char *)base + analytics_off);
+    heat_results = (HeatResult *)((char *)base + heats_off);
+    feeds = (RoomFeed *)((char *)base + feeds_off);
+    chats = (ChatBox *)((char *)base + chats_off);
+    return 0;
+}
+
+// One game's state, mapped by its room worker and shared with its handlers
+int map_room_state() {
+    size_t game_off = 0;
+    size_t out_off = align_up(game_off + sizeof(GameState), CACHE_LINE);
+    size_t solver_off = align_up(out_off + sizeof(OutboundPool), CACHE_LINE);
+    size_t total = solver_off + solver_size(dictionary);
+    
+    void *base = map_arena(total, &room_arena_size);
+    if (!base) return -1;
+    
+    room_arena = base;
+    game = (GameState *)((char *)base + game_off);
+    outbound = (OutboundPool *)((char *)base + out_off);
+    solver = (SolverState *)((char *)base + solver_off);
+    return 0;
+}
+
+void add_log(const char *format, ...) {
+    if (!log_buffer) return;
+    pthread_mutex_lock(&log_buffer->lock);
+    if (log_buffer->count < LOG_CAPACITY) {
+        char *message = log_buffer->entries[log_buffer->count].message;
+        int len = room_id ? snprintf(message, 512, "[room %d] ", room_id) : 0;
+        va_list args;
+        va_start(args, format);
+        vsnprintf(message + len, 512 - len, format, args);
+        va_end(args);
+        log_buffer->entries[log_buffer->count].timestamp = time(NULL);
+        log_buffer->count++;
+    }
+    pthread_mutex_unlock(&log_buffer->lock);
+}
+
+void *logger_func(void *arg) {
+    log_file = fopen("game.log", "a");
+    if (!log_file) return NULL;
+    profiler_register_thread("logger");
+    
+    time_t now = time(NULL);
+    fprintf(log_file, "\n=== GAME SESSION STARTED ===\n");
+    fprintf(log_file, "Time: %s\n", ctime(&now));
+    fflush(log_file);
+    
+    int last = 0;
+    while (logging_active || last < log_buffer->count) {
+        pthread_mutex_lock(&log_buffer->lock);
+        while (last < log_buffer->count) {
+            LogEntry *e = &log_buffer->entries[last];
+            char *t = ctime(&e->timestamp);
+            if (t) {
+                t[strlen(t)-1] = '\0';
+                fprintf(log_file, "[%s] %s\n", t, e->message);
+            }
+            fflush(log_file);
+            last++;
+        }
+        // Every room appends here for as long as the server runs
+        log_buffer->count = 0;
+        last = 0;
+        pthread_mutex_unlock(&log_buffer->lock);
+        profiler_poll();
+        usleep(50000);
+    }
+    
+    fprintf(log_file, "=== SESSION END ===\n\n");
+    fclose(log_file);
+    return NULL;
+}
+
+void load_scores() {
+    pthread_mutex_lock(&score_data->lock);
+    score_data->count = 0;
+    
+    FILE *f = fopen("scores.txt", "r");
+    if (f) {
+        char line[256];
+        while (fgets(line, sizeof(line), f) && score_data->count < SCORE_CAPACITY) {
+            char name[NAME_SIZE];
+            int wins, games = 0, points = 0;
+            // Older files only have "name,wins"
+            if (sscanf(line, "%49[^,],%d,%d,%d", name, &wins, &games, &points) >= 2) {
+                strcpy(score_data->records[score_data->count].player_name, name);
+                score_data->records[score_data->count].wins = wins;
+                score_data->records[score_data->count].games = games;
+                score_data->records[score_data->count].points = points;
+                score_data->count++;
+            }
+        }
+        fclose(f);
+        add_log("Loaded %d player records from scores.txt", score_data->count);
+    } else {
+        add_log("scores.txt not found, will create new file");
+    }
+    pthread_mutex_unlock(&score_data->lock);
+}
+
+// Write to path.tmp, then rename over path so readers only ever see a
+// complete file. Only durable snapshots pay for fdatasync.
+FILE *snapshot_open(const char *path, char *tmp, size_t size) {
+    snprintf(tmp, size, "%s.tmp", path);
+    return fopen(tmp, "w");
+}
+
+int snapshot_commit(FILE *f, const char *tmp, const char *path, int durable) {
+    int ok = fflush(f) == 0 && (!durable || fdatasync(fileno(f)) == 0);
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    if (durable) {
+        int dir = open(".", O_RDONLY);
+        if (dir >= 0) {
+            fsync(dir);
+            close(dir);
+        }
+    }
+    return 0;
+}
+
+void save_scores() {
+    char tmp[64];
+    
+    pthread_mutex_lock(&score_data->lock);
+    FILE *f = snapshot_open("scores.txt", tmp, sizeof(tmp));
+    if (f) {
+        for (int i = 0; i < score_data->count; i++) {
+            fprintf(f, "%s,%d,%d,%d\n", 
+                    score_data->records[i].player_name,
+                    score_data->records[i].wins,
+                    score_data->records[i].games,
+                    score_data->records[i].points);
+        }
+    }
+    int count = score_data->count;
+    pthread_mutex_unlock(&score_data->lock);
+    
+    if (f && snapshot_commit(f, tmp, "scores.txt", 1) == 0) {
+        add_log("Saved %d player records to scores.txt", count);
+    }
+}
+
+// Main's persist thread, caller holds score_data->lock. Only while a
+// standby is attached; the change log outlives a detach.
+void replicate_score(int i) {
+    if (__atomic_load_n(&standby_fd, __ATOMIC_ACQUIRE) < 0) return;
+    ChangeRecord r;
+    r.room = 0;
+    r.kind = CHANGE_SCORE;
+    r.score = score_data->records[i];
+    change_log_append(change_log, &r);
+}
+
+void update_winner(const char *name) {
+    pthread_mutex_lock(&score_data->lock);
+    
+    int found = 0;
+    for (int i = 0; i < score_data->count; i++) {
+        if (strcmp(score_data->records[i].player_name, name) == 0) {
+            score_data->records[i].wins++;
+            replicate_score(i);
+            found = 1;
+            add_log("Updated %s wins to %d", name, score_data->records[i].wins);
+            break;
+        }
+    }
+    
+    if (!found && score_data->count < SCORE_CAPACITY) {
+        strcpy(score_data->records[score_data->count].player_name, name);
+        score_data->records[score_data->count].wins = 1;
+        score_data->records[score_data->count].games = 0;
+        score_data->records[score_data->count].points = 0;
+        score_data->count++;
+        replicate_score(score_data->count - 1);
+        add_log("Added new winner: %s", name);
+    }
+    
+    pthread_mutex_unlock(&score_data->lock);
+}
+
+void record_game(const char *name, int points) {
+    pthread_mutex_lock(&score_data->lock);
+    
+    int i;
+    for (i = 0; i < score_data->count; i++) {
+        if (strcmp(score_data->records[i].player_name, name) == 0) break;
+    }
+    
+    if (i == score_data->count) {
+        if (score_data->count >= SCORE_CAPACITY) {
+            pthread_mutex_unlock(&score_data->lock);
+            return;
+        }
+        strcpy(score_data->records[i].player_name, name);
+        score_data->records[i].wins = 0;
+        score_data->records[i].games = 0;
+        score_data->records[i].points = 0;
+        score_data->count++;
+    }
+    score_data->records[i].games++;
+    score_data->records[i].points += points;
+    replicate_score(i);
+    
+    pthread_mutex_unlock(&score_data->lock);
+}
+
+// Map the room's average points per game from the score store onto a
+// dictionary difficulty bucket. Unknown players count as the midpoint.
+int room_difficulty() {
+    int total = 0, known = 0;
+    
+    pthread_mutex_lock(&score_data->lock);
+    for (int i = 0; i < game->player_count; i++) {
+        for (int j = 0; j < score_data->count; j++) {
+            ScoreRecord *r = &score_data->records[j];
+            if (r->games > 0 && strcmp(r->player_name, game->players[i].name) == 0) {
+                total += r->points / r->games;
+                known++;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&score_data->lock);
+    
+    if (known == 0) return DICT_DIFFICULTY_BUCKETS / 2;
+    
+    int avg = total / known;
+    int bucket = (avg - SKILL_MIN_POINTS) * DICT_DIFFICULTY_BUCKETS / 
+                 (SKILL_MAX_POINTS - SKILL_MIN_POINTS);
+    if (bucket < 0) bucket = 0;
+    if (bucket >= DICT_DIFFICULTY_BUCKETS) bucket = DICT_DIFFICULTY_BUCKETS - 1;
+    return bucket;
+}
+
+// Matchmaking rating from the score store: ten per average point per game
+// plus up to fifty for the win rate. Unknown players rate as the midpoint.
+int player_rating(const char *name) {
+    int rating = (MATCH_RATING_MIN + MATCH_RATING_MAX) / 2;
+    
+    pthread_mutex_lock(&score_data->lock);
+    for (int i = 0; i < score_data->count; i++) {
+        ScoreRecord *r = &score_data->records[i];
+        if (r->games > 0 && strcmp(r->player_name, name) == 0) {
+            rating = (10 * r->points + 50 * r->wins) / r->games;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&score_data->lock);
+    return rating;
+}
+
+void publish_state() {
+    snapshot_publish(game);
+}
+
+void read_snapshot(GameSnapshot *out) {
+    snapshot_read(game, out);
+}
+
+// Uncontended acquisitions stay a single trylock; waits show up as spans
+void game_lock() {
+    if (pthread_mutex_trylock(&game->lock) == 0) return;
+    uint64_t t0 = trace_begin();
+    pthread_mutex_lock(&game->lock);
+    trace_end("lock_wait", game->round, game->turn, -1, t0);
+}
+
+// Every writer section ends by republishing the snapshot
+void game_unlock() {
+    publish_state();
+    pthread_mutex_unlock(&game->lock);
+}
+
+long long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void outbound_init() {
+    outbound->free_head = 0;
+    for (int i = 0; i < OUT_SLAB_COUNT; i++) {
+        outbound->slab[i].next = (i + 1 < OUT_SLAB_COUNT) ? i + 1 : -1;
+    }
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        memset(&outbound->queues[i], 0, sizeof(OutQueue));
+        outbound->queues[i].head = -1;
+        outbound->queues[i].tail = -1;
+    }
+}
+
+// Append to the connection's queue, packing small messages into the tail
+// buffer. Never touches the socket, so it cannot block on the peer.
+void send_msg(int sock, const char *msg) {
+    if (sock <= 0 || !outbound) return;
+    
+    int idx;
+    for (idx = 0; idx < game->player_count; idx++) {
+        if (game->players[idx].socket == sock) break;
+    }
+    if (idx == game->player_count) return;
+    
+    char buf[OUT_SLAB_SIZE];
+    int len = snprintf(buf, sizeof(buf), "%s\n", msg);
+    if (len >= (int)sizeof(buf)) {
+        len = sizeof(buf) - 1;
+        buf[len - 1] = '\n';
+    }
+    
+    pthread_mutex_lock(&outbound->lock);
+    OutQueue *q = &outbound->queues[idx];
+    
+    if (q->queued_bytes + len > OUT_HARD_LIMIT) {
+        q->dropped++;
+        pthread_mutex_unlock(&outbound->lock);
+        return;
+    }
+    
+    OutBuffer *tail = q->tail >= 0 ? &outbound->slab[q->tail] : NULL;
+    if (!tail || tail->len + len > OUT_SLAB_SIZE) {
+        int b = outbound->free_head;
+        if (b < 0) {
+            q->dropped++;
+            pthread_mutex_unlock(&outbound->lock);
+            return;
+        }
+        outbound->free_head = outbound->slab[b].next;
+        outbound->slab[b].len = 0;
+        outbound->slab[b].next = -1;
+        if (tail) tail->next = b;
+        else q->head = b;
+        q->tail = b;
+        tail = &outbound->slab[b];
+    }
+    memcpy(tail->data + tail->len, buf, len);
+    tail->len += len;
+    q->queued_bytes += len;
+    pthread_mutex_unlock(&outbound->lock);
+    
+    if (wake_pipe[1] >= 0) {
+        char c = 1;
+        if (write(wake_pipe[1], &c, 1) < 0 && errno != EAGAIN) {
+            // Flusher also wakes on its poll timeout
+        }
+    }
+}
+
+void broadcast(const char *msg) {
+    uint64_t t0 = trace_begin();
+    for (int i = 0; i < game->player_count; i++) {
+        if (game->connected[i]) {
+            send_msg(game->players[i].socket, msg);
+        }
+    }
+    if (room_feed) feed_append(room_feed, msg);
+    trace_end("broadcast", game->round, game->turn, -1, t0);
+}
+
+// Refills at rate tokens a second up to burst, counted in thousandths.
+// Starts full.
+typedef struct {
+    int tokens;
+    long long at;
+} TokenBucket;
+
+// Takes n tokens. Returns 0, taking none, if there are fewer.
+int bucket_take(TokenBucket *b, int n, int rate, int burst, long long now) {
+    long long tokens = b->at ? b->tokens + (now - b->at) * rate : burst * 1000LL;
+    b->tokens = tokens < burst * 1000LL ? tokens : burst * 1000LL;
+    b->at = now;
+    if (b->tokens < n * 1000LL) return 0;
+    b->tokens -= n * 1000;
+    return 1;
+}
+
+// Main, as a room takes the slot (or 0 as it leaves); chat still pending
+// was for the room before
+void chat_open(ChatBox *c, int room) {
+    pthread_mutex_lock(&c->lock);
+    c->room = room;
+    c->len = 0;
+    pthread_mutex_unlock(&c->lock);
+}
+
+// Printable ASCII only, '|' being the separator
+char chat_char(char c) {
+    return c == '|' || c < 0x20 || c > 0x7E ? '?' : c;
+}
+
+// Adds name|text to the room's next chat line, text cut to CHAT_TEXT_MAX.
+// Once the line is full, chat is dropped until the flush. Returns -1 if
+// it was.
+int chat_post(ChatBox *c, int room, const char *name, const char *text) {
+    char entry[NAME_SIZE + CHAT_TEXT_MAX + 2];
+    int len = 0;
+    entry[len++] = '|';
+    for (; *name && len < NAME_SIZE; name++) entry[len++] = chat_char(*name);
+    entry[len++] = '|';
+    int start = len;
+    for (; *text && *text != '\r' && *text != '\n' && len - start < CHAT_TEXT_MAX; text++) {
+        entry[len++] = chat_char(*text);
+    }
+    if (len == start) return 0;
+    
+    int posted = 0;
+    pthread_mutex_lock(&c->lock);
+    // The first entry goes in without its leading separator
+    int skip = c->len == 0;
+    if (c->room == room && c->len + len - skip <= CHAT_BATCH_SIZE) {
+        memcpy(c->text + c->len, entry + skip, len - skip);
+        c->len += len - skip;
+        posted = 1;
+    }
+    pthread_mutex_unlock(&c->lock);
+    return posted ? 0 : -1;
+}
+
+// Room's flusher thread, every CHAT_FLUSH_MS: everything posted since, as
+// CHAT:name|text|name|text... Players with output still queued are left
+// out, so chat never sits in front of a prompt. Never takes game->lock.
+void flush_chat() {
+    char line[OUT_SLAB_SIZE];
+    memcpy(line, "CHAT:", 5);
+    pthread_mutex_lock(&room_chat->lock);
+    int len = room_chat->len;
+    memcpy(line + 5, room_chat->text, len);
+    room_chat->len = 0;
+    pthread_mutex_unlock(&room_chat->lock);
+    if (!len) return;
+    line[5 + len] = '\0';
+    
+    for (int i = 0; i < game->player_count; i++) {
+        if (!game->connected[i]) continue;
+        pthread_mutex_lock(&outbound->lock);
+        int idle = outbound->queues[i].head < 0;
+        pthread_mutex_unlock(&outbound->lock);
+        if (idle) send_msg(game->players[i].socket, line);
+    }
+    if (room_feed) feed_append(room_feed, line);
+}
+
+// CHAT:<text> from a player, in or out of turn
+void take_chat(int idx, const char *text) {
+    static TokenBucket bucket;      // each handler is its own process
+    if (!bucket_take(&bucket, 1, CHAT_RATE, CHAT_BURST, now_ms())) return;
+    chat_post(room_chat, room_id, game->players[idx].name, text);
+}
+
+// Charges what a handler just read from its player against the inbound
+// limits, far above anything the client sends. One over them is cut off:
+// shutdown() reaches the room's copies of the socket too, so every path
+// goes on as if the peer had closed. Returns 1 if it was.
+int flooding(int idx, int sock, const char *buf, int len) {
+    static TokenBucket bytes, lines;    // each handler is its own process
+    int n = 0;
+    for (int i = 0; i < len; i++) n += buf[i] == '\n';
+    long long now = now_ms();
+    if (bucket_take(&bytes, len, INPUT_BYTE_RATE, INPUT_BYTE_BURST, now) &&
+        bucket_take(&lines, n, INPUT_LINE_RATE, INPUT_LINE_BURST, now)) {
+        return 0;
+    }
+    shutdown(sock, SHUT_RDWR);
+    add_log("%s: over %d lines or %d bytes a second, disconnected", game->players[idx].name,
+            INPUT_LINE_RATE, INPUT_BYTE_RATE);
+    return 1;
+}
+
+// The senders below read the published snapshot. Writers holding
+// game->lock call publish_state() before using them.
+void send_board() {
+    GameSnapshot snap;
+    read_snapshot(&snap);
+    char msg[100];
+    snprintf(msg, sizeof(msg), "BOARD:%s", snap.answer_space);
+    broadcast(msg);
+    add_log("Broadcast board: %s", snap.answer_space);
+}
+
+void format_state(const GameSnapshot *snap, int idx, char *msg, size_t size) {
+    // CRITICAL: Include elimination status in state message
+    snprintf(msg, size, "STATE:R%d|L%d|S%d|E%d", 
+             snap->round, 
+             snap->players[idx].round_lives, 
+             snap->players[idx].total_score,
+             snap->players[idx].round_eliminated);  // E0=active, E1=eliminated
+}
+
+void send_state(int idx) {
+    if (idx < 0 || idx >= game->player_count) return;
+    GameSnapshot snap;
+    read_snapshot(&snap);
+    char msg[100];
+    format_state(&snap, idx, msg, sizeof(msg));
+    send_msg(game->players[idx].socket, msg);
+    add_log("Sent state to %s: %s", game->players[idx].name, msg + 6);
+}
+
+void broadcast_states() {
+    GameSnapshot snap;
+    read_snapshot(&snap);
+    for (int i = 0; i < snap.player_count; i++) {
+        if (snap.players[i].connected) {
+            char msg[100];
+            format_state(&snap, i, msg, sizeof(msg));
+            send_msg(game->players[i].socket, msg);
+            add_log("Sent state to %s: %s", game->players[i].name, msg + 6);
+        }
+    }
+}
+
+void init_answer() {
+    int len = strlen(game->word);
+    memset(game->letter_masks, 0, sizeof(game->letter_masks));
+    for (int i = 0; i < len; i++) {
+        game->answer_space[i] = '_';
+        if (isupper((unsigned char)game->word[i])) game->letter_masks[game->word[i] - 'A'] |= 1u << i;
+    }
+    game->answer_space[len] = '\0';
+}
+
+void select_word() {
+    srand(time(NULL) + game->round * 123);
+    int idx = dict_sample(dictionary, game->difficulty, rand());
+    if (idx < 0) {
+        strcpy(game->word, word_database[rand() % WORD_DATABASE_SIZE]);
+    } else {
+        snprintf(game->word, WORD_LEN, "%.*s", dictionary->lengths[idx], dictionary->words[idx]);
+    }
+    add_log("Round %d: Selected word %s (difficulty bucket %d)", 
+            game->round, game->word, game->difficulty);
+}
+
+int check_letter(char c) {
+    c = toupper(c);
+    if (!isalpha(c)) return -1;
+    
+    int found = 0;
+    for (int i = 0; i < strlen(game->word); i++) {
+        if (game->word[i] == c && game->answer_space[i] == '_') {
+            found = 1;
+        }
+    }
+    return found ? 1 : 0;
+}
+
+void update_answer(char c) {
+    c = toupper(c);
+    for (int i = 0; i < strlen(game->word); i++) {
+        if (game->word[i] == c && game->answer_space[i] == '_') {
+            game->answer_space[i] = c;
+        }
+    }
+}
+
+int is_complete() {
+    return strchr(game->answer_space, '_') == NULL;
+}
+
+void init_round() {
+    select_word();
+    init_answer();
+    if (game->round <= MAX_ROUNDS) strcpy(game->round_words[game->round - 1], game->word);
+    solver_reset(solver, dictionary, game->answer_space);
+    
+    // A client demoted for lagging sits the round out; only
+    // check_watermarks() restores it, once its queue has drained
+    int lagging[MAX_CLIENTS];
+    pthread_mutex_lock(&outbound->lock);
+    for (int i = 0; i < game->player_count; i++) lagging[i] = outbound->queues[i].lagging;
+    pthread_mutex_unlock(&outbound->lock);
+    
+    for (int i = 0; i < game->player_count; i++) {
+        if (game->connected[i] && !lagging[i]) analytics_round(analytics, game->players[i].stats_row);
+        game->ready[i] = lagging[i] != 0;
+        game->round_lives[i] = 3;
+        game->round_eliminated[i] = lagging[i] != 0;    // RESET elimination
+        game->hint_used[i] = 0;
+    }
+    game->missed_letters = 0;
+    memset(game->missed_words, 0, sizeof(game->missed_words));
+    
+    game->turn_in_progress = 0;
+    
+    add_log("Round %d initialized - ALL players reset to 3 lives, not eliminated", game->round);
+}
+
+int active_count() {
+    int cnt = 0;
+    for (int i = 0; i < game->player_count; i++) {
+        if (!game->round_eliminated[i] && game->connected[i]) {
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+void show_scores() {
+    GameSnapshot snap;
+    read_snapshot(&snap);
+    char msg[512] = "ROUND_SCORES:";
+    for (int i = 0; i < snap.player_count; i++) {
+        char info[100];
+        if (snap.players[i].round_eliminated) {
+            snprintf(info, sizeof(info), "%s: ELIMINATED (Total: %d pts)", 
+                     game->players[i].name, snap.players[i].total_score);
+        } else {
+            snprintf(info, sizeof(info), "%s: %d pts (%d lives)", 
+                     game->players[i].name, 
+                     snap.players[i].total_score, 
+                     snap.players[i].round_lives);
+        }
+        if (i > 0) strcat(msg, "|");
+        strcat(msg, info);
+    }
+    broadcast(msg);
+}
+
+void write_final_results(const GameResult *r) {
+    char tmp[64];
+    FILE *f = snapshot_open("final_scores.txt", tmp, sizeof(tmp));
+    if (!f) return;
+    
+    fprintf(f, "=== GAME FINAL RESULTS ===\n");
+    fprintf(f, "Date: %s\n", ctime(&r->finished));
+    fprintf(f, "Total Rounds: %d\n\n", r->rounds);
+    
+    fprintf(f, "RANKINGS:\n");
+    for (int i = 0; i < r->player_count; i++) {
+        fprintf(f, "%d. %s - %d points\n", i+1, r->names[i], r->scores[i]);
+    }
+    fprintf(f, "\nWINNER: %s with %d points!\n", r->names[0], r->scores[0]);
+    
+    // A report, scores.txt is the durable record
+    snapshot_commit(f, tmp, "final_scores.txt", 0);
+}
+
+// Queue a finished game for the persistence thread. Blocks only while the
+// queue is full.
+long long persist_submit(const GameResult *r) {
+    pthread_mutex_lock(&results->lock);
+    while (results->count == RESULT_QUEUE_CAPACITY) {
+        pthread_cond_wait(&results->done, &results->lock);
+    }
+    results->results[(results->head + results->count) % RESULT_QUEUE_CAPACITY] = *r;
+    results->count++;
+    long long ticket = ++results->submitted;
+    pthread_cond_signal(&results->ready);
+    pthread_mutex_unlock(&results->lock);
+    return ticket;
+}
+
+// Seat indices, best total score first
+void rank_players(int *sorted) {
+    for (int i = 0; i < game->player_count; i++) sorted[i] = i;
+    
+    for (int i = 0; i < game->player_count - 1; i++) {
+        for (int j = i + 1; j < game->player_count; j++) {
+            if (game->total_score[sorted[j]] > game->total_score[sorted[i]]) {
+                int tmp = sorted[i];
+                sorted[i] = sorted[j];
+                sorted[j] = tmp;
+            }
+        }
+    }
+}
+
+void save_final_results() {
+    int sorted[MAX_CLIENTS];
+    rank_players(sorted);
+    
+    GameResult r;
+    memset(&r, 0, sizeof(r));
+    r.player_count = game->player_count;
+    r.rounds = total_rounds;
+    r.finished = time(NULL);
+    for (int i = 0; i < game->player_count; i++) {
+        strcpy(r.names[i], game->players[sorted[i]].name);
+        r.scores[i] = game->total_score[sorted[i]];
+        r.seats[i] = sorted[i];
+        analytics_game(analytics, game->players[sorted[i]].stats_row, r.scores[i]);
+    }
+    
+    game_lock();
+    r.word_count = game->round < total_rounds ? game->round : total_rounds;
+    if (r.word_count > MAX_ROUNDS) r.word_count = MAX_ROUNDS;
+    memcpy(r.words, game->round_words, sizeof(r.words));
+    r.move_count = game->move_count;
+    memcpy(r.moves, game->moves, r.move_count * sizeof(MoveRecord));
+    game_unlock();
+    
+    persist_submit(&r);
+    
+    add_log("Game completed - Winner: %s (%d pts)", r.names[0], r.scores[0]);
+}
+
+// Ranked as for the game result, also when the game ended early
+void report_heat() {
+    int sorted[MAX_CLIENTS];
+    rank_players(sorted);
+    for (int i = 0; i < game->player_count; i++) {
+        strcpy(room_heat->names[i], game->players[sorted[i]].name);
+        room_heat->scores[i] = game->total_score[sorted[i]];
+    }
+    room_heat->player_count = game->player_count;
+}
+
+// Group commit: everything queued when the thread wakes is appended to the
+// history store and applied to the score table, then made durable with one
+// history sync and one scores.txt snapshot.
+void *persist_func(void *arg) {
+    profiler_register_thread("persist");
+    GameResult batch[RESULT_QUEUE_CAPACITY];
+    
+    while (1) {
+        pthread_mutex_lock(&results->lock);
+        while (results->count == 0 && persist_active) {
+            pthread_cond_wait(&results->ready, &results->lock);
+        }
+        int n = results->count;
+        if (n == 0) {
+            pthread_mutex_unlock(&results->lock);
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            batch[i] = results->results[(results->head + i) % RESULT_QUEUE_CAPACITY];
+        }
+        results->head = (results->head + n) % RESULT_QUEUE_CAPACITY;
+        results->count = 0;
+        long long upto = results->submitted;
+        pthread_cond_broadcast(&results->done);
+        pthread_mutex_unlock(&results->lock);
+        
+        for (int i = 0; i < n; i++) {
+            if (history_append(&history, &batch[i]) < 0) {
+                add_log("History append failed: %s", strerror(errno));
+            }
+            for (int j = 0; j < batch[i].player_count; j++) {
+                record_game(batch[i].names[j], batch[i].scores[j]);
+            }
+            update_winner(batch[i].names[0]);
+        }
+        history_sync(&history);
+        write_final_results(&batch[n - 1]);
+        analytics_save(analytics, ANALYTICS_FILE);
+        save_scores();
+        add_log("Committed %d game result(s) in one batch", n);
+        
+        pthread_mutex_lock(&results->lock);
+        results->committed = upto;
+        pthread_cond_broadcast(&results->done);
+        pthread_mutex_unlock(&results->lock);
+    }
+    
+    return NULL;
+}
+
+// Returns once everything queued so far is on disk
+void persist_stop() {
+    pthread_mutex_lock(&results->lock);
+    persist_active = 0;
+    pthread_cond_broadcast(&results->ready);
+    pthread_mutex_unlock(&results->lock);
+    pthread_join(persist_thread, NULL);
+}
+
+// Worker threads block SIGINT and SIGHUP so they interrupt the main
+// thread's accept()
+void start_thread(pthread_t *thread, void *(*func)(void *)) {
+    sigset_t set, old;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &set, &old);
+    pthread_create(thread, NULL, func, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+int next_player() {
+    int start = game->current_player;
+    int next = (game->current_player + 1) % game->player_count;
+    
+    while (next != start) {
+        if (!game->round_eliminated[next] && game->connected[next]) {
+            return next;
+        }
+        next = (next + 1) % game->player_count;
+    }
+    
+    if (!game->round_eliminated[start] && game->connected[start]) {
+        return start;
+    }
+    return -1;
+}
+
+// Caller holds game->lock, so the image is one consistent state
+void replicate(int kind) {
+    if (!replicated) return;
+    ChangeRecord r;
+    r.room = room_id;
+    r.kind = kind;
+    change_image(game, &r.image);
+    change_log_append(change_log, &r);
+}
+
+// Caller holds game->lock
+void record_move(int idx, int kind, char letter) {
+    analytics_move(analytics, game->players[idx].stats_row, kind);
+    if (game->move_count >= MAX_MOVES) return;
+    MoveRecord *m = &game->moves[game->move_count++];
+    m->round = game->round;
+    m->player = idx;
+    m->kind = kind;
+    m->letter = letter;
+}
+
+void handle_move(int idx, const char *move) {
+    Player *p = &game->players[idx];
+    
+    add_log("%s handling move: %s", p->name, move);
+    
+    if (strncmp(move, "LETTER:", 7) == 0) {
+        char letter = move[7];
+        int result = check_letter(letter);
+        
+        record_move(idx, result == 1 ? MOVE_LETTER_HIT : result == 0 ? MOVE_LETTER_MISS : MOVE_INVALID,
+                    toupper(letter));
+        
+        if (result == -1) {
+            send_msg(p->socket, "INVALID");
+            add_log("%s: invalid letter", p->name);
+        } else if (result == 1) {
+            game->total_score[idx]++;
+            update_answer(letter);
+            solver_guess_letter(solver, dictionary, game->answer_space, letter);
+            publish_state();
+            send_msg(p->socket, "CORRECT_LETTER");
+            add_log("%s: correct letter %c (+1 pt, total %d)", 
+                    p->name, letter, game->total_score[idx]);
+            
+            usleep(100000);
+            send_board();
+            broadcast_states();
+        } else {
+            game->round_lives[idx]--;
+            game->missed_letters |= 1u << (toupper(letter) - 'A');
+            solver_guess_letter(solver, dictionary, game->answer_space, letter);
+            send_msg(p->socket, "WRONG_LETTER");
+            add_log("%s: wrong letter %c (-1 life, %d left)", 
+                    p->name, letter, game->round_lives[idx]);
+            
+            if (game->round_lives[idx] <= 0) {
+                game->round_eliminated[idx] = 1;
+                analytics_elimination(analytics, p->stats_row);
+                send_msg(p->socket, "ELIMINATED");
+                add_log("%s: eliminated (no lives left in round %d)", 
+                        p->name, game->round);
+            }
+            
+            publish_state();
+            broadcast_states();
+        }
+    }
+    else if (strncmp(move, "WORD:", 5) == 0) {
+        char word[WORD_LEN];
+        snprintf(word, sizeof(word), "%s", move + 5);
+        for (int i = 0; word[i]; i++) word[i] = toupper(word[i]);
+        
+        if (strcmp(word, game->word) == 0) {
+            record_move(idx, MOVE_WORD_HIT, 0);
+            game->total_score[idx] += 3;
+            strcpy(game->answer_space, game->word);
+            publish_state();
+            send_msg(p->socket, "CORRECT_WORD");
+            add_log("%s: correct word (+3 pts, total %d)", p->name, game->total_score[idx]);
+            
+            usleep(100000);
+            send_board();
+            broadcast_states();
+        } else if (validate_words && dict_contains(dictionary, word) < 0) {
+            record_move(idx, MOVE_INVALID, 0);
+            send_msg(p->socket, "INVALID");
+            add_log("%s: %s is not a dictionary word (no penalty)", p->name, word);
+        } else {
+            record_move(idx, MOVE_WORD_MISS, 0);
+            game->round_eliminated[idx] = 1;
+            analytics_elimination(analytics, p->stats_row);
+            game->round_lives[idx] = 0;
+            memcpy(game->missed_words[idx], word, WORD_LEN);
+            solver_exclude_word(solver, dictionary, word);
+            publish_state();
+            send_msg(p->socket, "WRONG_WORD");
+            add_log("%s: wrong word guess - eliminated from round %d", 
+                    p->name, game->round);
+            send_state(idx);
+        }
+    }
+    
+    game->ready[idx] = 1;
+    replicate(CHANGE_MOVE);
+}
+
+void send_hint(int idx) {
+    Player *p = &game->players[idx];
+    if (game->hint_used[idx]) {
+        send_msg(p->socket, "INVALID");
+        return;
+    }
+    
+    char letter = solver_best_letter(solver);
+    char msg[64];
+    snprintf(msg, sizeof(msg), "HINT:%c|%u", letter ? letter : '-', solver->remaining);
+    game->hint_used[idx] = 1;
+    record_move(idx, MOVE_HINT, letter);
+    replicate(CHANGE_MOVE);
+    send_msg(p->socket, msg);
+    add_log("%s: hint %c (%u candidate words left)", p->name, letter ? letter : '-', solver->remaining);
+}
+
+// "STATS" for the caller, "STATS:<name>" for anyone with recorded games
+void send_stats(int idx, const char *request) {
+    int row = game->players[idx].stats_row;
+    if (request[5] == ':') row = analytics_find(analytics, request + 6);
+    
+    char msg[OUT_SLAB_SIZE];
+    analytics_format(analytics, row, msg, sizeof(msg));
+    send_msg(game->players[idx].socket, msg);
+}
+
+// Any bytes from the client count as a heartbeat
+void heard_from(int idx) {
+    __atomic_store_n(&game->last_heard[idx], now_ms(), __ATOMIC_RELAXED);
+}
+
+// PONG echoes the PING's send time, which gives the round trip. Smoothed
+// like TCP's srtt; clients answering a bare PONG are treated as local.
+// Returns 1 if the line was a PONG.
+int take_pong(int idx, const char *line) {
+    if (strncmp(line, "PONG", 4) != 0 || (line[4] != '\0' && line[4] != ':' &&
+                                          line[4] != '\r' && line[4] != '\n')) {
+        return 0;
+    }
+    long long sent = line[4] == ':' ? atoll(line + 5) : 0;
+    long long sample = now_ms() - sent;
+    if (sent > 0 && sample >= 0 && sample <= RTT_MAX_MS) {
+        int rtt = game->rtt_ms[idx];
+        game->rtt_ms[idx] = rtt ? (7 * rtt + sample) / 8 : sample;
+    }
+    return 1;
+}
+
+// PROMPT:<deadline>|<now>|<rtt> in this server's CLOCK_MONOTONIC ms. The
+// client counts down from its own receive time and stops a round trip
+// early, so a move it still accepts reaches us before the deadline.
+void send_prompt(int idx, long long deadline) {
+    char msg[80];
+    snprintf(msg, sizeof(msg), "PROMPT:%lld|%lld|%d", deadline, now_ms(), game->rtt_ms[idx]);
+    send_msg(game->players[idx].socket, msg);
+}
+
+// Only STATS and CHAT are taken outside a turn and PONG swallowed; anything
+// else stays queued in the socket for the next turn. Waits up to timeout_ms for
+// input. Returns 1 if a line was consumed, -1 once the peer is gone.
+int serve_idle_request(int idx, int sock, int timeout_ms) {
+    static int held = 0;        // bytes left queued for the turn at the last look
+    struct pollfd pfd = {sock, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) <= 0 || !(pfd.revents & (POLLIN | POLLHUP | POLLERR))) return 0;
+    
+    char peek[256];
+    int n = recv(sock, peek, sizeof(peek) - 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) return -1;
+    if (n < 0) return 0;
+    peek[n] = '\0';
+    char *end = strchr(peek, '\n');
+    int stats = strncmp(peek, "STATS", 5) == 0 && (peek[5] == ':' || peek[5] == '\n' || peek[5] == '\r');
+    int pong = strncmp(peek, "PONG", 4) == 0 && strchr(":\r\n", peek[4]);
+    int chat = strncmp(peek, "CHAT:", 5) == 0;
+    if (!end || (!stats && !pong && !chat)) {
+        // An early move waits for the turn; PONGs piling up behind it
+        // still show the client is alive
+        int avail = 0;
+        ioctl(sock, FIONREAD, &avail);
+        if (avail > held) heard_from(idx);
+        held = avail;
+        // The socket stays readable, so wait here instead of in poll()
+        usleep(timeout_ms * 1000);
+        return 0;
+    }
+    
+    int len = end - peek + 1;
+    if (recv(sock, peek, len, 0) != len) return 0;
+    if (flooding(idx, sock, peek, len)) return -1;
+    held = 0;
+    heard_from(idx);
+    peek[strcspn(peek, "\r\n")] = '\0';
+    if (stats) send_stats(idx, peek);
+    else if (chat) take_chat(idx, peek + 5);
+    else take_pong(idx, peek);
+    return 1;
+}
+
+// A handler's pauses keep serving the socket, so PONGs are read and the
+// heartbeat deadline runs from real traffic, not from the handler's sleeps
+void idle_wait(int idx, int sock, int ms) {
+    long long until = now_ms() + ms;
+    long long left;
+    while ((left = until - now_ms()) > 0) {
+        if (serve_idle_request(idx, sock, left) < 0) return;
+    }
+}
+
+// Write as much of one connection's queue as the socket takes right now.
+// Returns 1 if data is still pending.
+int flush_queue(int idx) {
+    int sock = game->players[idx].socket;
+    
+    while (1) {
+        pthread_mutex_lock(&outbound->lock);
+        OutQueue *q = &outbound->queues[idx];
+        if (q->head < 0) {
+            pthread_mutex_unlock(&outbound->lock);
+            return 0;
+        }
+        // Only the flusher consumes, so the head bytes stay valid unlocked
+        OutBuffer *b = &outbound->slab[q->head];
+        const char *data = b->data + q->offset;
+        int len = b->len - q->offset;
+        pthread_mutex_unlock(&outbound->lock);
+        
+        uint64_t t0 = trace_begin();
+        ssize_t sent = send(sock, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        trace_end("send", game->round, game->turn, idx, t0);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            return 1;
+        }
+        
+        pthread_mutex_lock(&outbound->lock);
+        if (sent < 0) {
+            // Peer is gone, the handler notices on recv; discard its queue
+            sent = b->len - q->offset;
+        }
+        q->offset += sent;
+        q->queued_bytes -= sent;
+        if (q->offset >= b->len && q->head != q->tail) {
+            int next = b->next;
+            b->next = outbound->free_head;
+            outbound->free_head = q->head;
+            q->head = next;
+            q->offset = 0;
+        } else if (q->offset >= b->len) {
+            b->next = outbound->free_head;
+            outbound->free_head = q->head;
+            q->head = q->tail = -1;
+            q->offset = 0;
+        }
+        pthread_mutex_unlock(&outbound->lock);
+    }
+}
+
+// The handler's next recv returns EOF; a turn it never started is over
+void disconnect_player(int idx) {
+    game_lock();
+    game->connected[idx] = 0;
+    game->round_eliminated[idx] = 1;
+    if (game->current_player == idx && !game->turn_in_progress) game->ready[idx] = 1;
+    replicate(CHANGE_LEFT);
+    game_unlock();
+    shutdown(game->players[idx].socket, SHUT_RDWR);
+}
+
+// Demote clients over the high watermark to spectators, restore them once
+// below the low watermark, disconnect them if they stay stalled.
+void check_watermarks(int idx) {
+    long long now = now_ms();
+    int demote = 0, restore = 0, drop = 0;
+    
+    pthread_mutex_lock(&outbound->lock);
+    OutQueue *q = &outbound->queues[idx];
+    if (!q->lagging && q->queued_bytes > OUT_HIGH_WATERMARK) {
+        q->lagging = 1;
+        q->lagging_since = now;
+        demote = 1;
+    } else if (q->lagging == 1 && q->queued_bytes < OUT_LOW_WATERMARK) {
+        q->lagging = 0;
+        restore = 1;
+    } else if (q->lagging == 1 && now - q->lagging_since > OUT_STALL_MS) {
+        q->lagging = 2;
+        drop = 1;
+    }
+    int queued = q->queued_bytes;
+    pthread_mutex_unlock(&outbound->lock);
+    
+    Player *p = &game->players[idx];
+    if (demote) {
+        game_lock();
+        game->round_eliminated[idx] = 1;
+        // A turn it never started would otherwise stall the scheduler
+        if (game->current_player == idx && !game->turn_in_progress) game->ready[idx] = 1;
+        game_unlock();
+        add_log("%s: %d bytes queued, demoted to spectator", p->name, queued);
+    } else if (restore) {
+        add_log("%s: caught up, plays again next round", p->name);
+    } else if (drop) {
+        disconnect_player(idx);
+        add_log("%s: stalled for %d ms, disconnected", p->name, OUT_STALL_MS);
+    }
+}
+
+// A client that answered no PING for dead_after_ms is gone even if TCP has
+// not noticed yet. Marked like a stalled one, so next_player() skips it at
+// once and its handler sees EOF instead of waiting out the turn.
+void check_heartbeat(int idx, long long now) {
+    if (!game->game_started || game->game_finished || game->frozen || !game->connected[idx]) return;
+    long long silent = now - __atomic_load_n(&game->last_heard[idx], __ATOMIC_RELAXED);
+    if (silent <= dead_after_ms) return;
+    
+    disconnect_player(idx);
+    add_log("%s: silent for %lld ms, disconnected", game->players[idx].name, silent);
+}
+
+void *flusher_func(void *arg) {
+    profiler_register_thread("flusher");
+    add_log("Outbound flusher started");
+    long long stop_deadline = 0;
+    long long next_ping = 0;
+    long long next_chat = 0;
+    
+    while (1) {
+        struct pollfd fds[MAX_CLIENTS + 1];
+        int nfds = 0;
+        int pending = 0;
+        long long now = now_ms();
+        
+        fds[nfds].fd = wake_pipe[0];
+        fds[nfds].events = POLLIN;
+        nfds++;
+        
+        if (flusher_active && now >= next_ping) {
+            char ping[32];
+            snprintf(ping, sizeof(ping), "PING:%lld", now);
+            for (int i = 0; i < game->player_count; i++) {
+                if (game->connected[i]) send_msg(game->players[i].socket, ping);
+            }
+            next_ping = now + heartbeat_ms;
+        }
+        if (now >= next_chat) {
+            flush_chat();
+            next_chat = now + CHAT_FLUSH_MS;
+        }
+        
+        for (int i = 0; i < game->player_count; i++) {
+            check_heartbeat(i, now);
+            if (flush_queue(i)) {
+                fds[nfds].fd = game->players[i].socket;
+                fds[nfds].events = POLLOUT;
+                nfds++;
+                pending = 1;
+            }
+            check_watermarks(i);
+        }
+        
+        // On shutdown give slow peers a bounded time to drain
+        if (!flusher_active) {
+            if (!stop_deadline) stop_deadline = now_ms() + 2000;
+            if (!pending || now_ms() > stop_deadline) break;
+        }
+        
+        int wait = (next_ping < next_chat ? next_ping : next_chat) - now_ms();
+        poll(fds, nfds, wait < 0 ? 0 : wait < 100 ? wait : 100);
+        if (fds[0].revents & POLLIN) {
+            char drain[64];
+            while (read(wake_pipe[0], drain, sizeof(drain)) > 0);
+        }
+    }
+    
+    return NULL;
+}
+
+// The deadline passed without a move: -1 point and the turn is over
+void time_out_turn(int idx) {
+    game_lock();
+    Player *p = &game->players[idx];
+    
+    if (!game->ready[idx] && game->current_player == idx) {
+        game->total_score[idx]--;
+        game->ready[idx] = 1;
+        record_move(idx, MOVE_TIMEOUT, 0);
+        replicate(CHANGE_MOVE);
+        publish_state();
+        add_log("%s: timed out (-1 pt, total %d)", p->name, game->total_score[idx]);
+        send_msg(p->socket, "TIMEOUT");
+        send_state(idx);  // Send state to sync client
+    }
+    game->turn_in_progress = 0;
+    game_unlock();
+}
+
+// Simultaneous mode: read this player's guess for the open volley, answering
+// HINT and STATS on the way. The guess is only stored; the scheduler
+// resolves all of them together. Returns -1 if the connection was lost.
+int submit_volley_move(int idx, int sock) {
+    char buf[256];
+    
+    while (1) {
+        GameSnapshot snap;
+        read_snapshot(&snap);
+        if (!snap.volley_open || snap.players[idx].ready) return 0;
+        
+        struct pollfd pfd = {sock, POLLIN, 0};
+        int ready = poll(&pfd, 1, 100);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) continue;
+        
+        memset(buf, 0, sizeof(buf));
+        int n = recv(sock, buf, sizeof(buf) - 1, 0);
+        if (n <= 0 || flooding(idx, sock, buf, n)) {
+            game_lock();
+            game->connected[idx] = 0;
+            game->round_eliminated[idx] = 1;
+            game->ready[idx] = 1;
+            replicate(CHANGE_LEFT);
+            game_unlock();
+            return -1;
+        }
+        heard_from(idx);
+        
+        char *save = NULL;
+        for (char *line = strtok_r(buf, "\r\n", &save); line; line = strtok_r(NULL, "\r\n", &save)) {
+            if (take_pong(idx, line)) {
+                continue;
+            } else if (strcmp(line, "HINT") == 0) {
+                game_lock();
+                send_hint(idx);
+                game_unlock();
+            } else if (strncmp(line, "STATS", 5) == 0 && (line[5] == '\0' || line[5] == ':')) {
+                send_stats(idx, line);
+            } else if (strncmp(line, "CHAT:", 5) == 0) {
+                take_chat(idx, line + 5);
+            } else {
+                game_lock();
+                // A guess read after the deadline is dropped and times out
+                int taken = game->volley_open && !game->ready[idx] && now_ms() <= game->volley_deadline;
+                if (taken) {
+                    snprintf(game->pending[idx], sizeof(game->pending[idx]), "%s", line);
+                    game->pending_seq[idx] = ++game->submit_seq;
+                    game->ready[idx] = 1;
+                }
+                long long waited = now_ms() - game->volley_opened;
+                game_unlock();
+                if (taken) {
+                    analytics_turn(analytics, game->players[idx].stats_row, waited);
+                    add_log("%s: received move %s", game->players[idx].name, line);
+                }
+                return 0;
+            }
+        }
+    }
+}
+
+// The matchmaker already read NAME; the room worker filled in the seat
+void client_handler(int idx) {
+    int sock = game->players[idx].socket;
+    char buf[256];
+    int n;
+    
+    while (!game->game_started && game->connected[idx]) {
+        if (serve_idle_request(idx, sock, 100) < 0) disconnect_player(idx);
+    }
+    
+    idle_wait(idx, sock, 1000);
+    send_board();
+    send_state(idx);
+    
+    while (!game->game_finished && !game->frozen) {
+        profiler_poll();
+        
+        // Poll the snapshot, take the writer lock only to claim the turn
+        GameSnapshot snap;
+        read_snapshot(&snap);
+        
+        if (simultaneous_rounds) {
+            if (snap.volley_open && !snap.players[idx].ready && !snap.players[idx].round_eliminated) {
+                if (submit_volley_move(idx, sock) < 0) break;
+            } else if (serve_idle_request(idx, sock, 50) < 0) {
+                disconnect_player(idx);
+                break;
+            }
+            continue;
+        }
+        
+        int my_turn = snap.current_player == idx && 
+                      !snap.players[idx].round_eliminated && 
+                      !snap.players[idx].ready &&
+                      !snap.turn_in_progress;
+        
+        if (my_turn) {
+            game_lock();
+            my_turn = game->current_player == idx && 
+                      !game->round_eliminated[idx] && 
+                      !game->ready[idx] &&
+                      !game->turn_in_progress &&
+                      !game->frozen;
+            if (my_turn) game->turn_in_progress = 1;
+            game_unlock();
+        }
+        
+        if (my_turn) {
+            int round = game->round;
+            int turn = game->turn;
+            uint64_t turn_start = trace_begin();
+            
+            char turn_msg[100];
+            snprintf(turn_msg, sizeof(turn_msg), "TURN:%s", game->players[idx].name);
+            
+            broadcast(turn_msg);
+            uint64_t t0 = trace_begin();
+            idle_wait(idx, sock, 1000);
+            trace_end("prompt_sleep", round, turn, idx, t0);
+            long long prompted = now_ms();
+            long long deadline = prompted + turn_ms;
+            send_prompt(idx, deadline);
+            
+            // HINT requests do not end the turn, keep reading until a move
+            // or the deadline, which is enforced here to the millisecond
+            int moved = 0;
+            int lost = 0;
+            
+            while (!moved && !lost) {
+                long long left = deadline - now_ms();
+                if (left <= 0) break;
+                
+                struct pollfd pfd = {sock, POLLIN, 0};
+                int ready = poll(&pfd, 1, left);
+                if (ready < 0 && errno == EINTR) continue;
+                if (ready <= 0) break;
+                
+                memset(buf, 0, sizeof(buf));
+                n = recv(sock, buf, sizeof(buf)-1, 0);
+                if (n <= 0 || flooding(idx, sock, buf, n)) {
+                    lost = 1;
+                    break;
+                }
+                heard_from(idx);
+                
+                char *save = NULL;
+                char *line = strtok_r(buf, "\r\n", &save);
+                while (line && !moved) {
+                    if (take_pong(idx, line)) {
+                        // Heartbeat only, already counted
+                    } else if (strcmp(line, "HINT") == 0) {
+                        game_lock();
+                        send_hint(idx);
+                        game_unlock();
+                    } else if (strncmp(line, "STATS", 5) == 0 && (line[5] == '\0' || line[5] == ':')) {
+                        send_stats(idx, line);
+                    } else if (strncmp(line, "CHAT:", 5) == 0) {
+                        take_chat(idx, line + 5);
+                    } else {
+                        analytics_turn(analytics, game->players[idx].stats_row, now_ms() - prompted);
+                        add_log("%s: received move %s (%lld ms before the deadline)",
+                                game->players[idx].name, line, deadline - now_ms());
+                        
+                        t0 = trace_begin();
+                        game_lock();
+                        handle_move(idx, line);
+                        game->turn_in_progress = 0;
+                        game_unlock();
+                        trace_end("move", round, turn, idx, t0);
+                        moved = 1;
+                    }
+                    line = strtok_r(NULL, "\r\n", &save);
+                }
+            }
+            
+            if (lost) {
+                game_lock();
+                game->connected[idx] = 0;
+                game->round_eliminated[idx] = 1;
+                game->ready[idx] = 1;
+                game->turn_in_progress = 0;
+                replicate(CHANGE_LEFT);
+                game_unlock();
+                break;
+            } else if (!moved) {
+                t0 = trace_begin();
+                time_out_turn(idx);
+                trace_end("timeout", round, turn, idx, t0);
+            }
+            trace_end("turn", round, turn, idx, turn_start);
+        } else if (serve_idle_request(idx, sock, 200) < 0) {
+            disconnect_player(idx);
+            break;
+        }
+    }
+    
+    // A frozen room's players are not gone, the room worker hands them over
+    if (!game->frozen) add_log("Player %s disconnected", game->players[idx].name);
+    profiler_shutdown();
+    close(sock);
+    exit(0);
+}
+
+// Reveal, scores, then the next round or the end of the game. Called and
+// returns with game->lock held; drops it around the pauses.
+void finish_round() {
+    add_log("Round %d complete", game->round);
+    
+    // Solved rounds step the next word up a bucket, failed ones down
+    if (is_complete() && game->difficulty < DICT_DIFFICULTY_BUCKETS - 1) {
+        game->difficulty++;
+    } else if (!is_complete() && game->difficulty > 0) {
+        game->difficulty--;
+    }
+    
+    char reveal[100];
+    snprintf(reveal, sizeof(reveal), "REVEAL:%s", game->word);
+    game_unlock();
+    
+    broadcast(reveal);
+    sleep(3);
+    
+    show_scores();
+    sleep(4);
+    
+    game_lock();
+    game->round++;
+    
+    if (game->round <= total_rounds) {
+        add_log("Starting round %d/%d", game->round, total_rounds);
+        
+        init_round();  // This resets round_eliminated to 0
+        
+        game->current_player = 0;
+        game->turn++;
+        while (game->current_player < game->player_count && 
+               !game->connected[game->current_player]) {
+            game->current_player++;
+        }
+        replicate(CHANGE_ROUND);
+        
+        game_unlock();
+        
+        sleep(1);
+        send_board();
+        broadcast_states();  // Send states with E0 (not eliminated)
+        
+        add_log("Round %d ready", game->round);
+        
+        game_lock();
+    } else {
+        add_log("All %d rounds completed", total_rounds);
+        game->game_finished = 1;
+        game_unlock();
+        broadcast("END");
+        save_final_results();
+        game_lock();
+        replicate(CHANGE_END);
+    }
+}
+
+// Resolve every guess of the closed volley in the order it arrived, each
+// against the board as it stood when the volley opened. Everyone who names
+// a hidden letter scores it; of several correct WORD guesses the first
+// scores 3 and later ones 1. Players who sent nothing time out.
+// Caller holds game->lock.
+void resolve_volley() {
+    int order[MAX_CLIENTS];
+    int n = 0;
+    for (int i = 0; i < game->player_count; i++) {
+        if (game->pending_seq[i] == 0) continue;
+        int j = n++;
+        while (j > 0 && game->pending_seq[order[j - 1]] > game->pending_seq[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    
+    unsigned int hidden = 0;
+    for (int i = 0; game->answer_space[i]; i++) {
+        if (game->answer_space[i] == '_') hidden |= 1u << i;
+    }
+    
+    const char *result[MAX_CLIENTS] = {NULL};
+    int eliminated[MAX_CLIENTS] = {0};
+    unsigned int revealed = 0;
+    unsigned int guessed = 0;
+    int word_solved = 0;
+    
+    for (int k = 0; k < n; k++) {
+        int idx = order[k];
+        Player *p = &game->players[idx];
+        const char *move = game->pending[idx];
+        add_log("%s handling move: %s", p->name, move);
+        
+        if (strncmp(move, "LETTER:", 7) == 0 && isalpha((unsigned char)move[7])) {
+            char letter = toupper((unsigned char)move[7]);
+            unsigned int hits = game->letter_masks[letter - 'A'] & hidden;
+            guessed |= 1u << (letter - 'A');
+            if (hits) {
+                record_move(idx, MOVE_LETTER_HIT, letter);
+                game->total_score[idx]++;
+                revealed |= hits;
+                result[idx] = "CORRECT_LETTER";
+                add_log("%s: correct letter %c (+1 pt, total %d)", p->name, letter, game->total_score[idx]);
+            } else {
+                record_move(idx, MOVE_LETTER_MISS, letter);
+                game->round_lives[idx]--;
+                game->missed_letters |= 1u << (letter - 'A');
+                result[idx] = "WRONG_LETTER";
+                eliminated[idx] = game->round_lives[idx] <= 0;
+                add_log("%s: wrong letter %c (-1 life, %d left)", p->name, letter, game->round_lives[idx]);
+            }
+        } else if (strncmp(move, "WORD:", 5) == 0) {
+            char word[WORD_LEN];
+            snprintf(word, sizeof(word), "%s", move + 5);
+            for (int i = 0; word[i]; i++) word[i] = toupper(word[i]);
+            
+            if (strcmp(word, game->word) == 0) {
+                record_move(idx, MOVE_WORD_HIT, 0);
+                game->total_score[idx] += word_solved ? 1 : 3;
+                result[idx] = "CORRECT_WORD";
+                add_log("%s: correct word (+%d pts, total %d)", p->name, word_solved ? 1 : 3,
+                        game->total_score[idx]);
+                word_solved = 1;
+            } else if (validate_words && dict_contains(dictionary, word) < 0) {
+                record_move(idx, MOVE_INVALID, 0);
+                result[idx] = "INVALID";
+                add_log("%s: %s is not a dictionary word (no penalty)", p->name, word);
+            } else {
+                record_move(idx, MOVE_WORD_MISS, 0);
+                game->round_lives[idx] = 0;
+                memcpy(game->missed_words[idx], word, WORD_LEN);
+                solver_exclude_word(solver, dictionary, word);
+                result[idx] = "WRONG_WORD";
+                eliminated[idx] = 1;
+                add_log("%s: wrong word guess - eliminated from round %d", p->name, game->round);
+            }
+        } else {
+            record_move(idx, MOVE_INVALID, strncmp(move, "LETTER:", 7) == 0 ? toupper((unsigned char)move[7]) : 0);
+            result[idx] = "INVALID";
+            add_log("%s: invalid move", p->name);
+        }
+    }
+    
+    for (int i = 0; i < game->player_count; i++) {
+        if (game->pending_seq[i] || !game->connected[i] || game->round_eliminated[i]) continue;
+        game->total_score[i]--;
+        record_move(i, MOVE_TIMEOUT, 0);
+        result[i] = "TIMEOUT";
+        add_log("%s: timed out (-1 pt, total %d)", game->players[i].name, game->total_score[i]);
+    }
+    
+    if (word_solved) {
+        strcpy(game->answer_space, game->word);
+    } else {
+        for (int i = 0; game->word[i]; i++) {
+            if (revealed & (1u << i)) game->answer_space[i] = game->word[i];
+        }
+    }
+    for (int c = 0; c < 26; c++) {
+        if (guessed & (1u << c)) solver_guess_letter(solver, dictionary, game->answer_space, 'A' + c);
+    }
+    
+    for (int i = 0; i < game->player_count; i++) {
+        if (!result[i]) continue;
+        send_msg(game->players[i].socket, result[i]);
+        if (eliminated[i]) {
+            game->round_eliminated[i] = 1;
+            analytics_elimination(analytics, game->players[i].stats_row);
+            if (strcmp(result[i], "WRONG_WORD") != 0) send_msg(game->players[i].socket, "ELIMINATED");
+        }
+    }
+    publish_state();
+}
+
+// Simultaneous mode: prompt every active player at once, collect guesses
+// until all are in or the deadline passes, then resolve them as one batch.
+// The deadline is enforced here, no timeout process per player.
+void run_volley() {
+    usleep(VOLLEY_PAUSE_MS * 1000);
+    
+    game_lock();
+    if (is_complete() || active_count() <= 0) {
+        finish_round();
+        game_unlock();
+        return;
+    }
+    game->turn++;
+    game->submit_seq = 0;
+    game->volley_opened = now_ms();
+    game->volley_deadline = game->volley_opened + turn_ms;
+    int prompt[MAX_CLIENTS];
+    for (int i = 0; i < game->player_count; i++) {
+        game->pending_seq[i] = 0;
+        prompt[i] = !game->round_eliminated[i] && game->connected[i];
+        game->ready[i] = !prompt[i];
+    }
+    game->volley_open = 1;
+    int round = game->round, turn = game->turn;
+    game_unlock();
+    
+    uint64_t t0 = trace_begin();
+    for (int i = 0; i < game->player_count; i++) {
+        if (!prompt[i]) continue;
+        char turn_msg[100];
+        snprintf(turn_msg, sizeof(turn_msg), "TURN:%s", game->players[i].name);
+        send_msg(game->players[i].socket, turn_msg);
+        send_prompt(i, game->volley_deadline);
+    }
+    add_log("Volley %d open for %d players", turn, active_count());
+    
+    long long left;
+    while (scheduler_active && (left = game->volley_deadline - now_ms()) > 0) {
+        GameSnapshot snap;
+        read_snapshot(&snap);
+        int waiting = 0;
+        for (int i = 0; i < snap.player_count; i++) {
+            waiting |= snap.players[i].connected && !snap.players[i].round_eliminated && !snap.players[i].ready;
+        }
+        if (!waiting) break;
+        usleep((left < 20 ? left : 20) * 1000);
+    }
+    trace_end("volley", round, turn, -1, t0);
+    
+    t0 = trace_begin();
+    game_lock();
+    game->volley_open = 0;
+    resolve_volley();
+    replicate(CHANGE_VOLLEY);
+    game_unlock();
+    trace_end("resolve", round, turn, -1, t0);
+    
+    send_board();
+    broadcast_states();
+}
+
+// Upgrade: stop the room between turns. Returns 1 once it is frozen.
+int freeze_room() {
+    game_lock();
+    if (!game->turn_in_progress && !game->volley_open && !game->game_finished) game->frozen = 1;
+    int frozen = game->frozen;
+    game_unlock();
+    if (frozen) add_log("Room %d frozen for the upgrade in round %d", room_id, game->round);
+    return frozen;
+}
+
+void *scheduler_func(void *arg) {
+    profiler_register_thread("scheduler");
+    add_log(simultaneous_rounds ? "Simultaneous round scheduler started" : "Round Robin scheduler started");
+    if (simultaneous_rounds) sleep(1);     // handlers send the opening board first
+    
+    while (scheduler_active && !game->game_finished) {
+        if (handoff_requested && freeze_room()) break;
+        if (simultaneous_rounds) {
+            run_volley();
+            continue;
+        }
+        
+        GameSnapshot snap;
+        read_snapshot(&snap);
+        if (!snap.game_started || !snap.players[snap.current_player].ready) {
+            usleep(100000);
+            continue;
+        }
+        
+        game_lock();
+        int curr = game->current_player;
+        Player *p = &game->players[curr];
+        
+        if (game->ready[curr]) {
+            add_log("Turn complete for %s", p->name);
+            
+            if (is_complete() || active_count() <= 0) {
+                finish_round();
+            } else {
+                int nxt = next_player();
+                if (nxt >= 0) {
+                    game->current_player = nxt;
+                    game->ready[nxt] = 0;
+                    game->turn++;
+                    replicate(CHANGE_TURN);
+                    add_log("Turn advanced to %s", game->players[nxt].name);
+                } else {
+                    game->game_finished = 1;
+                    replicate(CHANGE_END);
+                }
+            }
+        }
+        
+        game_unlock();
+        usleep(100000);
+    }
+    
+    add_log("Scheduler ended");
+    return NULL;
+}
+
+// Main reaps room workers here and releases their slots in reap_rooms()
+void sigchld_handler(int sig) {
+    int saved = errno;
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        for (int i = 0; i < MAX_ROOMS; i++) {
+            if (room_pids[i] == pid) room_exited[i] = 1;
+        }
+    }
+    errno = saved;
+}
+
+// Only flags the request, main() shuts down outside signal context
+void sigint_handler(int sig) {
+    shutdown_requested = 1;
+}
+
+void sighup_handler(int sig) {
+    reload_requested = 1;
+}
+
+void sigusr1_handler(int sig) {
+    handoff_requested = 1;
+}
+
+// Builds the next dictionary away from the accept loop. A missing or empty
+// file keeps the current words rather than falling back to the built-ins.
+void *reload_func(void *arg) {
+    long long t0 = now_ms();
+    Dictionary *fresh = calloc(1, sizeof(Dictionary));
+    FILE *probe = fopen(DICTIONARY_FILE, "r");
+    if (probe) fclose(probe);
+    
+    if (!fresh || !probe || dict_load(fresh, DICTIONARY_FILE, word_database, WORD_DATABASE_SIZE) < 0 ||
+        fresh->count <= WORD_DATABASE_SIZE) {
+        if (fresh) dict_free(fresh);
+        free(fresh);
+        add_log("Dictionary reload failed: %s unreadable or empty, keeping the current words", DICTIONARY_FILE);
+    } else {
+        add_log("Dictionary rebuilt from %s in %lld ms", DICTIONARY_FILE, now_ms() - t0);
+        __atomic_store_n(&next_dictionary, fresh, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&reload_busy, 0, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+void start_reload() {
+    reload_requested = 0;
+    if (__atomic_load_n(&reload_busy, __ATOMIC_ACQUIRE)) {
+        add_log("Dictionary reload already in progress");
+        return;
+    }
+    reload_busy = 1;
+    start_thread(&reload_thread, reload_func);
+    pthread_detach(reload_thread);
+}
+
+// RCU-style swap. Only main's loop reads the dictionary, and at the top of
+// it nothing holds the old one, so it is freed at once. Running rooms
+// forked their own copy and finish their game with it; rooms formed from
+// now on get the new words, with no pause anywhere.
+void publish_dictionary() {
+    Dictionary *fresh = __atomic_exchange_n(&next_dictionary, NULL, __ATOMIC_ACQUIRE);
+    if (!fresh) return;
+    
+    Dictionary *old = dictionary;
+    dictionary = fresh;
+    add_log("Dictionary swapped: %u words (was %u), used from the next room", fresh->count, old->count);
+    printf("Dictionary reloaded: %u words\n", fresh->count);
+    fflush(stdout);
+    dict_free(old);
+    free(old);
+}
+
+void init_shared_lock(pthread_mutex_t *lock, pthread_mutexattr_t *attr) {
+    pthread_mutexattr_init(attr);
+    pthread_mutexattr_setpshared(attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(lock, attr);
+}
+
+int seated(const Seat *seats, int n, int fd) {
+    for (int i = 0; i < n; i++) {
+        if (seats[i].fd == fd) return 1;
+    }
+    return 0;
+}
+
+// Upgrade sockets live in the abstract namespace: "wordguess-<port>" for
+// requests to the running server, with ".next" for the rooms it sends on
+socklen_t control_address(struct sockaddr_un *addr, const char *suffix) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    int n = snprintf(addr->sun_path + 1, sizeof(addr->sun_path) - 1, "wordguess-%d%s", PORT, suffix);
+    return offsetof(struct sockaddr_un, sun_path) + 1 + n;
+}
+
+int control_listen(const char *suffix) {
+    struct sockaddr_un addr;
+    socklen_t len = control_address(&addr, suffix);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (bind(fd, (struct sockaddr *)&addr, len) < 0 || listen(fd, MAX_ROOMS) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void set_io_timeout(int fd) {
+    struct timeval tv = {HANDOFF_IO_MS / 1000, (HANDOFF_IO_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+int control_connect(const char *suffix) {
+    struct sockaddr_un addr;
+    socklen_t len = control_address(&addr, suffix);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, len) < 0) {
+        close(fd);
+        return -1;
+    }
+    set_io_timeout(fd);
+    return fd;
+}
+
+// Writes all of data, with the sockets attached to its first byte
+int send_with_fds(int sock, const void *data, size_t len, const int *fds, int nfds) {
+    char control[CMSG_SPACE(sizeof(int) * HANDOFF_BATCH)];
+    struct iovec iov = {(void *)data, len};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (nfds > 0) {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+        struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+        memcpy(CMSG_DATA(c), fds, sizeof(int) * nfds);
+    }
+    
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        sent += n;
+        iov.iov_base = (char *)data + sent;
+        iov.iov_len = len - sent;
+        msg.msg_control = NULL;
+        msg.msg_controllen = 0;
+    }
+    return 0;
+}
+
+// Reads exactly len bytes and keeps up to max_fds sockets that came with
+// them. Returns the number of sockets, or -1 with none left open.
+int recv_with_fds(int sock, void *data, size_t len, int *fds, int max_fds) {
+    size_t got = 0;
+    int nfds = 0;
+    while (got < len) {
+        char control[CMSG_SPACE(sizeof(int) * HANDOFF_BATCH)];
+        struct iovec iov = {(char *)data + got, len - got};
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        
+        ssize_t n = recvmsg(sock, &msg, 0);
+        if (n < 0 && errno == EINTR) continue;
+        for (struct cmsghdr *c = n > 0 ? CMSG_FIRSTHDR(&msg) : NULL; c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+            int count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            int *passed = (int *)CMSG_DATA(c);
+            for (int i = 0; i < count; i++) {
+                if (nfds < max_fds) fds[nfds++] = passed[i];
+                else close(passed[i]);
+            }
+        }
+        if (n <= 0) {
+            for (int i = 0; i < nfds; i++) close(fds[i]);
+            return -1;
+        }
+        got += n;
+    }
+    return nfds;
+}
+
+void handoff_layout(int *layout) {
+    layout[0] = HANDOFF_VERSION;
+    layout[1] = sizeof(GameState);
+    layout[2] = sizeof(OutboundPool);
+    layout[3] = sizeof(Waiter);
+}
+
+// A replicated room must not outlive main: the standby resumes it from the
+// change log and would otherwise race it for the sockets
+void die_with(pid_t parent) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != parent) _exit(1);
+}
+
+// A forked room keeps only its own players' sockets
+void close_main_sockets(const Seat *seats, int n) {
+    rooms_running = 0;
+    memset(room_pids, 0, sizeof(room_pids));
+    close(server_fd);
+    close(epoll_fd);
+    if (control_fd >= 0) close(control_fd);
+    if (standby_fd >= 0) close(standby_fd);
+    if (gateway_fd >= 0) close(gateway_fd);
+    control_fd = -1;
+    __atomic_store_n(&standby_fd, -1, __ATOMIC_RELEASE);
+    gateway_fd = -1;
+    
+    // Other waiters', entrants' and spectators' sockets must not be held
+    // open by this process
+    for (int slot = 0; slot < MATCH_CAPACITY; slot++) {
+        int fd = match_queue->slots[slot].fd;
+        if (match_queue->slots[slot].state != SLOT_FREE && !seated(seats, n, fd)) close(fd);
+    }
+    if (tournament) {
+        for (int i = 0; i < tournament->count; i++) {
+            int fd = tournament->entrants[i].fd;
+            if (fd >= 0 && !seated(seats, n, fd)) close(fd);
+        }
+        for (int i = 0; i < MAX_SPECTATORS; i++) {
+            if (spectators[i] >= 0) close(spectators[i]);
+        }
+    }
+}
+
+void open_room(int id) {
+    char process[32];
+    snprintf(process, sizeof(process), "room-%d", id);
+    trace_open(process);
+    profiler_init(process);
+    profiler_register_thread("main");
+    
+    if (map_room_state() < 0) {
+        perror("mmap failed");
+        exit(1);
+    }
+    if (pipe(wake_pipe) < 0) {
+        perror("pipe failed");
+        exit(1);
+    }
+    fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+}
+
+void init_room_locks() {
+    init_shared_lock(&game->lock, &game->lock_attr);
+    init_shared_lock(&game->roster_lock, &game->roster_lock_attr);
+    init_shared_lock(&outbound->lock, &outbound->lock_attr);
+}
+
+// Handlers leave once they see the room frozen. One that does not is
+// killed, so nothing else touches the sockets once they are handed over.
+void wait_handlers() {
+    long long deadline = now_ms() + 2000;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (handler_pids[i] <= 0) continue;
+        while (kill(handler_pids[i], 0) == 0 && now_ms() < deadline) usleep(10000);
+        if (kill(handler_pids[i], 0) == 0) kill(handler_pids[i], SIGKILL);
+        handler_pids[i] = 0;
+    }
+}
+
+// Sends the frozen room to the new server and waits for it to confirm.
+// Returns -1 if nobody took it.
+int hand_off_room(int id) {
+    int fd = control_connect(".next");
+    if (fd < 0) return -1;
+    
+    RoomHandoff head = {HANDOFF_MAGIC, id, game->player_count, simultaneous_rounds,
+                        total_rounds, validate_words, turn_ms};
+    int fds[MAX_CLIENTS];
+    for (int i = 0; i < game->player_count; i++) fds[i] = game->players[i].socket;
+    char ack = 0;
+    int rc = send_with_fds(fd, &head, sizeof(head), fds, game->player_count) < 0 ||
+             send_with_fds(fd, game, sizeof(GameState), NULL, 0) < 0 ||
+             send_with_fds(fd, outbound, sizeof(OutboundPool), NULL, 0) < 0 ||
+             recv(fd, &ack, 1, 0) != 1 ? -1 : 0;
+    close(fd);
+    return rc;
+}
+
+// Threads and handlers of one game. A fresh room deals the first word; a
+// resumed one carries on from the turn boundary it was frozen at. Freezing
+// for an upgrade ends here, in the new server or, failing that, by playing
+// on in this one.
+void play_room(int id, int fresh) {
+    pid_t worker = getpid();
+    while (1) {
+        scheduler_active = 1;
+        flusher_active = 1;
+        start_thread(&flusher_thread, flusher_func);
+        
+        for (int i = 0; i < game->player_count; i++) {
+            if (!game->connected[i]) continue;
+            pid_t pid = fork();
+            if (pid < 0) {
+                perror("fork failed");
+                game_lock();
+                game->connected[i] = 0;
+                game->round_eliminated[i] = 1;
+                game_unlock();
+            } else if (pid == 0) {
+                if (replicated) die_with(worker);
+                char process[32];
+                snprintf(process, sizeof(process), "room-%d.handler-%d", id, i);
+                trace_open(process);
+                profiler_init(process);
+                profiler_register_thread("main");
+                client_handler(i);
+                exit(0);
+            } else {
+                handler_pids[i] = pid;
+                profiler_add_child(pid);
+            }
+        }
+        
+        if (fresh) {
+            sleep(2);
+            game->difficulty = room_difficulty();
+            add_log("Room difficulty bucket %d from player history", game->difficulty);
+            game_lock();
+            init_round();
+            game->game_started = 1;
+            replicate(CHANGE_ROUND);
+            game_unlock();
+        }
+        
+        start_thread(&scheduler_thread, scheduler_func);
+        scheduler_started = 1;
+        add_log(fresh ? "Game started with %d players" : "Game resumed with %d players", game->player_count);
+        
+        while (!game->game_finished && !shutdown_requested && !game->frozen) {
+            sleep(1);
+        }
+        if (!game->frozen) break;
+        
+        pthread_join(scheduler_thread, NULL);
+        scheduler_started = 0;
+        wait_handlers();
+        flusher_active = 0;
+        pthread_join(flusher_thread, NULL);
+        if (hand_off_room(id) == 0) {
+            add_log("Room %d handed over to the new server", id);
+            printf("Room %d handed over\n", id);
+            fflush(stdout);
+            profiler_shutdown();
+            trace_close();
+            exit(0);
+        }
+        
+        add_log("Room %d could not be handed over, playing on", id);
+        handoff_requested = 0;
+        game_lock();
+        game->frozen = 0;
+        game_unlock();
+        fresh = 0;
+    }
+    
+    if (shutdown_requested) {
+        add_log("Room shutdown via SIGINT");
+        
+        // The scheduler may have just finished the game and queued it itself
+        game_lock();
+        int was_finished = game->game_finished;
+        game->game_finished = 1;
+        game_unlock();
+        if (!was_finished) {
+            broadcast("END");
+            if (game->round > 1) save_final_results();
+        }
+    } else {
+        printf("Room %d finished, results in final_scores.txt\n", id);
+        fflush(stdout);
+    }
+    
+    sleep(2);
+    
+    scheduler_active = 0;
+    if (scheduler_started) pthread_join(scheduler_thread, NULL);
+    flusher_active = 0;
+    pthread_join(flusher_thread, NULL);
+    if (room_heat) report_heat();
+    add_log("Room closed");
+    profiler_shutdown();
+    
+    pthread_mutex_destroy(&game->lock);
+    pthread_mutex_destroy(&game->roster_lock);
+    pthread_mutex_destroy(&outbound->lock);
+    munmap(room_arena, room_arena_size);
+    trace_close();
+    exit(0);
+}
+
+// Runs one game in its own process: the room's shared state, its flusher
+// and scheduler threads and one handler process per player. Results reach
+// main's persistence thread through the shared result queue.
+void room_worker(int id, const Seat *seats, int n) {
+    room_id = id;
+    close_main_sockets(seats, n);
+    open_room(id);
+    init_room_locks();
+    outbound_init();
+    
+    pthread_mutex_lock(&game->roster_lock);
+    for (int i = 0; i < n; i++) {
+        game->players[i].socket = seats[i].fd;
+        snprintf(game->players[i].name, NAME_SIZE, "%s", seats[i].name);
+        game->players[i].stats_row = analytics_row(analytics, seats[i].name);
+        game->round_lives[i] = 3;
+        game->connected[i] = 1;
+        game->last_heard[i] = now_ms();
+        add_log("Player %s seated (slot %d, rating %d)", seats[i].name, i, seats[i].rating);
+    }
+    game->player_count = n;
+    game->round = 1;
+    pthread_mutex_unlock(&game->roster_lock);
+    publish_state();
+    
+    play_room(id, 1);
+}
+
+// A room frozen by the previous server, continued under this one with the
+// rules it started with. Locks are reinitialised, sockets, analytics rows
+// and the solver (an index into this build's dictionary) rebuilt, the
+// latter from the board and the round's wrong guesses.
+void resume_room(ResumedRoom *rr) {
+    room_id = rr->head.room_id;
+    close_main_sockets(NULL, 0);
+    simultaneous_rounds = rr->head.simultaneous;
+    total_rounds = rr->head.total_rounds;
+    validate_words = rr->head.validate;
+    turn_ms = rr->head.turn_ms;
+    open_room(room_id);
+    memcpy(game, rr->game, sizeof(GameState));
+    if (rr->outbound) memcpy(outbound, rr->outbound, sizeof(OutboundPool));
+    init_room_locks();
+    if (!rr->outbound) outbound_init();
+    
+    long long now = now_ms();
+    for (int i = 0; i < game->player_count; i++) {
+        game->players[i].socket = rr->fds[i];
+        game->players[i].stats_row = analytics_row(analytics, game->players[i].name);
+        game->last_heard[i] = now;     // nobody read them while the room was frozen
+    }
+    solver_reset(solver, dictionary, game->answer_space);
+    for (int c = 0; c < 26; c++) {
+        if (game->missed_letters & (1u << c)) solver_guess_letter(solver, dictionary, game->answer_space, 'A' + c);
+    }
+    for (int i = 0; i < game->player_count; i++) {
+        if (game->missed_words[i][0]) solver_exclude_word(solver, dictionary, game->missed_words[i]);
+    }
+    game->frozen = 0;
+    publish_state();
+    add_log("Room %d resumed in round %d/%d", room_id, game->round, total_rounds);
+    
+    // A standby's copy of a room that had not dealt its first word yet
+    play_room(room_id, !game->game_started);
+}
+
+void drop_connection(int slot) {
+    int fd = match_queue->slots[slot].fd;
+    // Room workers hold duplicates, so closing alone would not deregister it
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    match_release(match_queue, slot);
+}
+
+// Kernel-side dead peer detection. Keepalive probes cover sockets that sit
+// idle in the queue or between tournament heats; TCP_USER_TIMEOUT aborts a
+// connection whose sent data (PINGs included) stays unacknowledged, so a
+// vanished host errors out within the heartbeat deadline either way. The
+// gateway passes 0, the system default: a browser that reads slowly is
+// dropped by its ring or its room's heartbeat, not by the kernel.
+void tune_keepalive(int fd, unsigned int user_timeout) {
+    int on = 1;
+    int idle = KEEPALIVE_IDLE_S;
+    int interval = KEEPALIVE_INTERVAL_S;
+    int count = KEEPALIVE_COUNT;
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+    setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &user_timeout, sizeof(user_timeout));
+}
+
+// A new connection waits for its NAME line in a handshake slot
+void admit_connection(int fd) {
+    int slot = match_alloc(match_queue, fd, now_ms());
+    if (slot < 0) {
+        close(fd);
+        add_log("Matchmaking queue full, connection refused");
+        return;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.u32 = slot;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// Connections wait in the kernel backlog while the listener is paused
+void pause_listener(int paused) {
+    if (listen_paused == paused) return;
+    listen_paused = paused;
+    struct epoll_event ev;
+    ev.events = paused ? 0 : EPOLLIN;
+    ev.data.u32 = LISTEN_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, server_fd, &ev);
+}
+
+// Per-address accept buckets, direct mapped. An entry changes hands once
+// its address has been quiet long enough to refill; until then colliding
+// addresses share it.
+int address_admits(uint32_t addr, long long now) {
+    static struct {
+        uint32_t addr;
+        TokenBucket bucket;
+    } slots[ADDR_SLOTS];
+    int burst = accept_rate * ACCEPT_BURST_S;
+    int i = (addr * 2654435761u) >> 20 & (ADDR_SLOTS - 1);
+    if (slots[i].addr != addr && now - slots[i].bucket.at >= ACCEPT_BURST_S * 1000LL) {
+        slots[i].addr = addr;
+        slots[i].bucket.at = 0;
+    }
+    return bucket_take(&slots[i].bucket, 1, accept_rate, burst, now);
+}
+
+// Drain the backlog. Sockets stay blocking for the room; the handshake
+// reads them with MSG_DONTWAIT. An address over its rate is closed on at
+// once, before it costs a slot. With HANDSHAKE_MAX connections yet to send
+// NAME, the pool full, or no descriptors left the listener pauses instead,
+// until sweep_handshakes() finds room again.
+void accept_connections() {
+    static int starved = 0;     // out of descriptors, logged once until an accept succeeds
+    long long now = now_ms();
+    while (match_queue->handshakes < HANDSHAKE_MAX && match_queue->free_head >= 0) {
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        int fd = accept(server_fd, (struct sockaddr *)&addr, &len);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                if (!starved) add_log("accept failed: %s, retrying every %d ms", strerror(errno), ACCEPT_RETRY_MS);
+                starved = 1;
+                listen_retry_at = now + ACCEPT_RETRY_MS;
+                pause_listener(1);
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                add_log("accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+        starved = 0;
+        if (accept_rate && !address_admits(addr.sin_addr.s_addr, now)) {
+            close(fd);
+            refused++;
+            continue;
+        }
+        tune_keepalive(fd, dead_after_ms);
+        admit_connection(fd);
+    }
+    listen_retry_at = now;
+    pause_listener(1);
+}
+
+// Every loop: handshakes past HANDSHAKE_MS give their slots back, and a
+// paused listener is resumed once there is room
+void sweep_handshakes() {
+    static long long refused_logged = 0;
+    long long now = now_ms();
+    int slot, expired = 0;
+    while ((slot = match_expired(match_queue, now - HANDSHAKE_MS)) >= 0) {
+        drop_connection(slot);
+        expired++;
+    }
+    if (expired) add_log("%d connection(s) sent no NAME within %d ms, closed", expired, HANDSHAKE_MS);
+    if (refused && now - refused_logged >= 1000) {
+        add_log("%d connection(s) refused, over %d a second from one address", refused, accept_rate);
+        refused = 0;
+        refused_logged = now;
+    }
+    if (listen_paused && upgrade_fd < 0 && now >= listen_retry_at &&
+        match_queue->handshakes < HANDSHAKE_MAX && match_queue->free_head >= 0) {
+        pause_listener(0);
+    }
+}
+
+// Direct write from the accept loop, for sockets no room is using. A peer
+// that cannot take a whole line at once is not kept.
+int send_line(int fd, const char *msg) {
+    char buf[OUT_SLAB_SIZE];
+    int len = snprintf(buf, sizeof(buf), "%s\n", msg);
+    if (len >= (int)sizeof(buf)) {
+        len = sizeof(buf) - 1;
+        buf[len - 1] = '\n';
+    }
+    return send(fd, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL) == len ? 0 : -1;
+}
+
+// Readable socket main is holding: discards what the client sent (a late
+// PONG, a STATS) and returns 1 only if the peer actually closed
+int peer_closed(int fd) {
+    char drain[256];
+    while (1) {
+        int n = recv(fd, drain, sizeof(drain), MSG_DONTWAIT);
+        if (n > 0) continue;
+        return n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+    }
+}
+
+void drop_spectator(int s) {
+    if (spectators[s] < 0) return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, spectators[s], NULL);
+    close(spectators[s]);
+    spectators[s] = -1;
+}
+
+// An entrant's connection closed while main held it
+void entrant_left(int idx) {
+    Entrant *e = &tournament->entrants[idx];
+    if (e->fd < 0) return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, e->fd, NULL);
+    close(e->fd);
+    e->fd = -1;
+    if (e->status == ENTRANT_READY) {
+        // Before the first draw the seat stays open for a reconnect
+        if (tournament->stage == 0) {
+            e->status = ENTRANT_ABSENT;
+            registered--;
+        } else {
+            e->status = ENTRANT_OUT;
+        }
+        add_log("Entrant %s withdrew", e->name);
+    }
+}
+
+// Standings lines go to spectators and to every entrant not in a heat
+void tournament_broadcast(const char *msg) {
+    for (int s = 0; s < MAX_SPECTATORS; s++) {
+        if (spectators[s] >= 0 && send_line(spectators[s], msg) < 0) drop_spectator(s);
+    }
+    for (int i = 0; i < tournament->count; i++) {
+        Entrant *e = &tournament->entrants[i];
+        if (e->fd >= 0 && e->status != ENTRANT_PLAYING && send_line(e->fd, msg) < 0) entrant_left(i);
+    }
+}
+
+void save_standings() {
+    char tmp[64];
+    FILE *f = snapshot_open(TOURNAMENT_FILE, tmp, sizeof(tmp));
+    if (!f) return;
+    tournament_report(tournament, f);
+    snapshot_commit(f, tmp, TOURNAMENT_FILE, 0);
+}
+
+// A roster name takes its entrant's seat while the seat is free. Anyone
+// else, including an entrant already out, watches the standings instead.
+// Either way the handshake slot is done: the socket now belongs to the
+// tournament and is only watched for hangups.
+void tournament_register(int slot) {
+    Waiter *w = &match_queue->slots[slot];
+    int fd = w->fd;
+    int idx = tournament_find(tournament, w->name);
+    char msg[64];
+    int tag;
+    
+    if (idx >= 0 && tournament->entrants[idx].status == ENTRANT_ABSENT) {
+        Entrant *e = &tournament->entrants[idx];
+        e->fd = fd;
+        e->status = ENTRANT_READY;
+        registered++;
+        tag = ENTRANT_TAG + idx;
+        snprintf(msg, sizeof(msg), "REGISTERED:%d|%d", idx + 1, tournament->count);
+        add_log("Entrant %s registered (seed %d, %d of %d)", e->name, idx + 1, registered, tournament->count);
+    } else {
+        int s = 0;
+        while (s < MAX_SPECTATORS && spectators[s] >= 0) s++;
+        if (s == MAX_SPECTATORS) {
+            drop_connection(slot);
+            return;
+        }
+        spectators[s] = fd;
+        tag = SPECTATOR_TAG + s;
+        snprintf(msg, sizeof(msg), "SPECTATING:%d", tournament->count);
+    }
+    match_release(match_queue, slot);
+    
+    struct epoll_event ev;
+    ev.events = EPOLLRDHUP;
+    ev.data.u32 = tag;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    if (send_line(fd, msg) < 0) {
+        if (tag >= SPECTATOR_TAG) drop_spectator(tag - SPECTATOR_TAG);
+        else entrant_left(idx);
+    }
+}
+
+// Consumes the NAME line only, up to its newline; anything the client sent
+// after it stays in the socket for the room's handler.
+void read_name(int slot) {
+    Waiter *w = &match_queue->slots[slot];
+    char *at = w->line + w->line_len;
+    int space = sizeof(w->line) - 1 - w->line_len;
+    
+    int n = recv(w->fd, at, space, MSG_PEEK | MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+    if (n <= 0) {
+        drop_connection(slot);
+        return;
+    }
+    char *end = memchr(at, '\n', n);
+    int take = end ? end - at + 1 : n;
+    if (recv(w->fd, at, take, MSG_DONTWAIT) != take) {
+        drop_connection(slot);
+        return;
+    }
+    w->line_len += take;
+    if (!end) {
+        if (w->line_len == (int)sizeof(w->line) - 1) drop_connection(slot);
+        return;
+    }
+    
+    w->line[w->line_len] = '\0';
+    w->line[strcspn(w->line, "\r\n")] = '\0';
+    if (strncmp(w->line, "NAME:", 5) != 0 || w->line[5] == '\0') {
+        drop_connection(slot);
+        return;
+    }
+    int len = strlen(w->line + 5);
+    if (len >= NAME_SIZE) len = NAME_SIZE - 1;
+    memcpy(w->name, w->line + 5, len);
+    w->name[len] = '\0';
+    
+    if (tournament) {
+        tournament_register(slot);
+        return;
+    }
+    
+    int rating = player_rating(w->name);
+    match_enqueue(match_queue, slot, rating, now_ms());
+    // Queued players are only watched for hangups
+    struct epoll_event ev;
+    ev.events = EPOLLRDHUP;
+    ev.data.u32 = slot;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, w->fd, &ev);
+    add_log("Player %s queued (rating %d, %d waiting)", w->name, rating, match_queue->queued);
+}
+
+// A standby (-B) gets the change log and a duplicate of the listener.
+// Rooms formed from now on are replicated: their sockets go to it as well,
+// and they die with main, so the standby never races a live room.
+void attach_standby(int fd, HandoffMsg *reply) {
+    int fds[2] = {change_log_fd, server_fd};
+    if (send_with_fds(fd, reply, sizeof(*reply), fds, 2) < 0) {
+        close(fd);
+        return;
+    }
+    __atomic_store_n(&standby_fd, fd, __ATOMIC_RELEASE);
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.u32 = STANDBY_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, standby_fd, &ev);
+    add_log("Standby attached at change %llu", (unsigned long long)change_log_head(change_log));
+    printf("Standby attached\n");
+    fflush(stdout);
+}
+
+void detach_standby() {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, standby_fd, NULL);
+    close(standby_fd);
+    __atomic_store_n(&standby_fd, -1, __ATOMIC_RELEASE);
+    add_log("Standby detached, new rooms are no longer replicated");
+}
+
+// Clean shutdown or upgrade: the standby must not mistake it for a crash
+void release_standby() {
+    if (standby_fd < 0) return;
+    HandoffMsg msg = {HANDOFF_MAGIC, HANDOFF_STOP, 0, 0, {0}, 0};
+    send_with_fds(standby_fd, &msg, sizeof(msg), NULL, 0);
+    close(standby_fd);
+    __atomic_store_n(&standby_fd, -1, __ATOMIC_RELEASE);
+}
+
+// Tells the standby about a room just forked: roster and rules through
+// the change log, sockets over the control connection
+void follow_room(int id, const Seat *seats, int n, pid_t pid) {
+    ChangeRecord r;
+    r.room = id;
+    r.kind = CHANGE_OPEN;
+    memset(&r.roster, 0, sizeof(r.roster));
+    r.roster.player_count = n;
+    r.roster.simultaneous = simultaneous_rounds;
+    r.roster.total_rounds = total_rounds;
+    r.roster.validate = validate_words;
+    r.roster.turn_ms = turn_ms;
+    for (int i = 0; i < n; i++) memcpy(r.roster.names[i], seats[i].name, NAME_SIZE);
+    change_log_append(change_log, &r);
+    
+    int fds[MAX_CLIENTS];
+    for (int i = 0; i < n; i++) fds[i] = seats[i].fd;
+    HandoffMsg msg = {HANDOFF_MAGIC, HANDOFF_SEATS, n, id, {0}, pid};
+    if (send_with_fds(standby_fd, &msg, sizeof(msg), fds, n) < 0) detach_standby();
+}
+
+// Forks a room worker for the seated players. heat is the tournament heat
+// index + 1, or 0 for a matchmade room. Returns -1 if the room did not start.
+int spawn_room(const Seat *seats, int n, int heat) {
+    int r = 0;
+    while (room_pids[r]) r++;
+    int id = ++rooms_started;
+    heat_results[r].heat = heat;
+    heat_results[r].player_count = 0;
+    if (gateway_port) {
+        const char *names[MAX_CLIENTS];
+        for (int i = 0; i < n; i++) names[i] = seats[i].name;
+        feed_open(&feeds[r], id, names, n);
+    }
+    chat_open(&chats[r], id);
+    
+    // SIGCHLD stays blocked until the pid is recorded, or a room that dies
+    // at once would be reaped before it has a slot
+    sigset_t set, old;
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &set, &old);
+    fflush(stdout);
+    pid_t parent = getpid();
+    pid_t pid = fork();
+    if (pid == 0) {
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        if (heat) room_heat = &heat_results[r];
+        if (gateway_port) room_feed = &feeds[r];
+        room_chat = &chats[r];
+        replicated = standby_fd >= 0;
+        if (replicated) die_with(parent);
+        room_worker(id, seats, n);
+    }
+    if (pid > 0) {
+        room_pids[r] = pid;
+        room_exited[r] = 0;
+        rooms_running++;
+        profiler_add_child(pid);
+        if (standby_fd >= 0) follow_room(id, seats, n, pid);
+    }
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    
+    if (pid < 0) {
+        perror("fork failed");
+        heat_results[r].heat = 0;
+        add_log("Room %d could not start, %d players dropped", id, n);
+        return -1;
+    }
+    if (heat) printf("Room %d (stage %d, heat %d):", id, tournament->stage, heat);
+    else printf("Room %d:", id);
+    for (int i = 0; i < n; i++) printf(" %s", seats[i].name);
+    printf("\n");
+    fflush(stdout);
+    add_log("Room %d formed with %d players", id, n);
+    return 0;
+}
+
+void form_rooms() {
+    int room[MATCH_ROOM_MAX];
+    Seat seats[MATCH_ROOM_MAX];
+    int n;
+    while (rooms_running < MAX_ROOMS && (n = match_form(match_queue, now_ms(), room)) > 0) {
+        for (int i = 0; i < n; i++) {
+            Waiter *w = &match_queue->slots[room[i]];
+            seats[i].fd = w->fd;
+            seats[i].rating = w->rating;
+            memcpy(seats[i].name, w->name, NAME_SIZE);
+        }
+        spawn_room(seats, n, 0);
+        // The room worker has its own copies of the sockets
+        for (int i = 0; i < n; i++) drop_connection(room[i]);
+    }
+}
+
+void finish_tournament() {
+    const char *name = tournament->champion >= 0 ? tournament->entrants[tournament->champion].name : "none";
+    char msg[NAME_SIZE + 16];
+    snprintf(msg, sizeof(msg), "CHAMPION:%s", name);
+    tournament_broadcast(msg);
+    save_standings();
+    
+    printf("Tournament finished after %d stage(s), champion: %s\n", tournament->stage, name);
+    fflush(stdout);
+    add_log("Tournament finished, champion: %s", name);
+    shutdown_requested = 1;
+}
+
+void next_stage() {
+    if (tournament_plan(tournament) == 0) {
+        finish_tournament();
+        return;
+    }
+    
+    int players = 0;
+    for (int h = 0; h < tournament->heat_count; h++) players += tournament->heats[h].count;
+    char msg[64];
+    snprintf(msg, sizeof(msg), "STAGE:%d|%d|%d", tournament->stage, tournament->heat_count, players);
+    tournament_broadcast(msg);
+    save_standings();
+    
+    printf("Tournament stage %d: %d players in %d heat(s)\n", tournament->stage, players, tournament->heat_count);
+    fflush(stdout);
+    add_log("Stage %d drawn: %d players in %d heat(s), %d advance per heat",
+            tournament->stage, players, tournament->heat_count, tournament->advance);
+}
+
+// The room is gone and its connections are back with main: watch them
+// again, tell every player where the heat left them and publish the result
+void heat_finished(int h, const HeatResult *r) {
+    Tournament *t = tournament;
+    Heat *heat = &t->heats[h];
+    tournament_heat_done(t, h, r->names, r->scores, r->player_count);
+    
+    for (int m = 0; m < heat->count; m++) {
+        int idx = heat->members[m];
+        Entrant *e = &t->entrants[idx];
+        if (e->stage != t->stage || e->fd < 0) continue;     // withdrew before the heat
+        
+        struct epoll_event ev;
+        ev.events = EPOLLRDHUP;
+        ev.data.u32 = ENTRANT_TAG + idx;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, e->fd, &ev);
+        
+        // The champion hears it with everyone else
+        char verdict[32];
+        if (e->status == ENTRANT_CHAMPION) continue;
+        if (e->status == ENTRANT_READY) {
+            snprintf(verdict, sizeof(verdict), "ADVANCE:%d", t->stage + 1);
+        } else {
+            snprintf(verdict, sizeof(verdict), "OUT:%d|%d", t->stage, e->place);
+        }
+        if (send_line(e->fd, verdict) < 0) entrant_left(idx);
+    }
+    
+    char msg[OUT_SLAB_SIZE];
+    int len = snprintf(msg, sizeof(msg), "HEAT_RESULT:%d|%d|", t->stage, h + 1);
+    for (int i = 0; i < r->player_count; i++) {
+        len += snprintf(msg + len, sizeof(msg) - len, "%s%s=%d", i ? "," : "", r->names[i], r->scores[i]);
+    }
+    tournament_broadcast(msg);
+    save_standings();
+    add_log("Stage %d heat %d finished (%d of %d)", t->stage, h + 1, t->heats_done, t->heat_count);
+    
+    if (t->heats_done == t->heat_count) next_stage();
+}
+
+// Entrants who withdrew since the draw are left out, and a heat left with
+// fewer than two players is settled without a game
+void start_heat(int h) {
+    Tournament *t = tournament;
+    Heat *heat = &t->heats[h];
+    Seat seats[MAX_CLIENTS];
+    int n = 0;
+    t->heats_started++;
+    
+    for (int m = 0; m < heat->count; m++) {
+        Entrant *e = &t->entrants[heat->members[m]];
+        if (e->status != ENTRANT_READY) continue;
+        // The room has the connection to itself until the heat is over
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, e->fd, NULL);
+        e->status = ENTRANT_PLAYING;
+        seats[n].fd = e->fd;
+        seats[n].rating = player_rating(e->name);
+        memcpy(seats[n].name, e->name, NAME_SIZE);
+        n++;
+    }
+    
+    if (n >= 2) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "HEAT:%d|%d|%d", t->stage, h + 1, t->heat_count);
+        // A seat whose line does not go through is the room's to notice
+        for (int i = 0; i < n; i++) send_line(seats[i].fd, msg);
+        if (spawn_room(seats, n, h + 1) == 0) return;
+    }
+    HeatResult none;
+    memset(&none, 0, sizeof(none));
+    heat_finished(h, &none);
+}
+
+// Draws the first stage once every entrant has registered or registration
+// has closed, then keeps the room pool filled with the current stage's heats
+void tournament_tick() {
+    if (tournament->finished) return;
+    if (tournament->stage == 0) {
+        if (registered < tournament->count && now_ms() < registration_closes) return;
+        next_stage();
+    }
+    while (!tournament->finished && tournament->heats_started < tournament->heat_count &&
+           rooms_running < MAX_ROOMS) {
+        start_heat(tournament->heats_started);
+    }
+}
+
+void reap_rooms() {
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        if (room_pids[i] && room_exited[i]) {
+            profiler_remove_child(room_pids[i]);
+            room_pids[i] = 0;
+            room_exited[i] = 0;
+            rooms_running--;
+            if (gateway_port) feed_close(&feeds[i]);
+            chat_open(&chats[i], 0);
+            if (heat_results[i].heat) {
+                int h = heat_results[i].heat - 1;
+                heat_results[i].heat = 0;
+                heat_finished(h, &heat_results[i]);
+            }
+        }
+    }
+}
+
+// Upgrade requests are taken whenever no upgrade is under way
+void open_control() {
+    control_fd = control_listen("");
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = CONTROL_TAG;
+    if (control_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, control_fd, &ev) < 0) {
+        add_log("Upgrade socket unavailable: %s", strerror(errno));
+    }
+}
+
+// A new build (-U) asks to take over. Accepting stops the accept loop,
+// so connections wait in the listen backlog, and asks every room to
+// freeze at its next turn boundary and send itself over. Main hands over
+// the queue and the listener once the last room has gone.
+void begin_upgrade(int fd, HandoffMsg *reply) {
+    if (send_with_fds(fd, reply, sizeof(*reply), NULL, 0) < 0) {
+        close(fd);
+        return;
+    }
+    
+    upgrade_fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, control_fd, NULL);
+    close(control_fd);
+    control_fd = -1;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, server_fd, NULL);
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.u32 = UPGRADE_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, upgrade_fd, &ev);
+    
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        if (room_pids[i] && !room_exited[i]) kill(room_pids[i], SIGUSR1);
+    }
+    // A turn under way and the round's closing pauses run to the end first
+    upgrade_deadline = now_ms() + 2 * turn_ms + HANDOFF_GRACE_MS;
+    add_log("Upgrade requested: handing over %d room(s) and %d queued player(s)",
+            rooms_running, match_queue->queued);
+    printf("Upgrade requested, handing over %d room(s)\n", rooms_running);
+    fflush(stdout);
+}
+
+// Requests on the control socket: an upgrade (-U) or a standby (-B)
+void control_request() {
+    int fd = accept(control_fd, NULL, NULL);
+    if (fd < 0) return;
+    set_io_timeout(fd);
+    
+    HandoffMsg hello;
+    HandoffMsg reply = {HANDOFF_MAGIC, HANDOFF_ACCEPTED, 0, 0, {0}, 0};
+    handoff_layout(reply.layout);
+    const char *refusal = NULL;
+    if (recv_with_fds(fd, &hello, sizeof(hello), NULL, 0) < 0 || hello.magic != HANDOFF_MAGIC ||
+        (hello.kind != HANDOFF_HELLO && hello.kind != HANDOFF_STANDBY)) {
+        refusal = "bad request";
+    } else if (memcmp(hello.layout, reply.layout, sizeof(reply.layout)) != 0) {
+        refusal = "the other build's room layout differs";
+    } else if (tournament) {
+        refusal = "a tournament is running";
+    } else if (hello.kind == HANDOFF_STANDBY && standby_fd >= 0) {
+        refusal = "a standby is already attached";
+    } else if (hello.kind == HANDOFF_STANDBY && !change_log &&
+               !(change_log = change_log_create(&change_log_fd))) {
+        refusal = "the change log could not be created";
+    }
+    if (refusal) {
+        reply.kind = HANDOFF_REFUSED;
+        send_with_fds(fd, &reply, sizeof(reply), NULL, 0);
+        close(fd);
+        add_log("%s refused: %s", hello.kind == HANDOFF_STANDBY ? "Standby" : "Upgrade", refusal);
+        return;
+    }
+    if (hello.kind == HANDOFF_STANDBY) attach_standby(fd, &reply);
+    else begin_upgrade(fd, &reply);
+}
+
+// The new server went away mid-upgrade. Rooms not yet frozen fail to hand
+// over and play on here; any it already took are gone with it.
+void abort_upgrade() {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, upgrade_fd, NULL);
+    close(upgrade_fd);
+    upgrade_fd = -1;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = LISTEN_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &ev);
+    listen_paused = 0;
+    open_control();
+    add_log("Upgrade aborted: the new server disconnected");
+    printf("Upgrade aborted, serving on\n");
+    fflush(stdout);
+}
+
+// Rooms that cannot reach a turn boundary in time end their game as on
+// shutdown, so results are still saved
+void check_upgrade() {
+    if (!upgrade_deadline || now_ms() < upgrade_deadline) return;
+    upgrade_deadline = 0;
+    add_log("Upgrade: %d room(s) did not freeze in time, ending their games", rooms_running);
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        if (room_pids[i] && !room_exited[i]) kill(room_pids[i], SIGINT);
+    }
+}
+
+// Queued and half-named connections, HANDOFF_BATCH at a time, with the
+// partial NAME line so none of what they sent is lost
+void hand_off_waiters() {
+    int handed = 0;
+    int slot = 0;
+    while (slot < MATCH_CAPACITY) {
+        static Waiter batch[HANDOFF_BATCH];
+        int fds[HANDOFF_BATCH];
+        int n = 0;
+        for (; slot < MATCH_CAPACITY && n < HANDOFF_BATCH; slot++) {
+            if (match_queue->slots[slot].state == SLOT_FREE) continue;
+            batch[n] = match_queue->slots[slot];
+            fds[n++] = match_queue->slots[slot].fd;
+        }
+        if (n == 0) break;
+        
+        HandoffMsg msg = {HANDOFF_MAGIC, HANDOFF_WAITERS, n, 0, {0}, 0};
+        if (send_with_fds(upgrade_fd, &msg, sizeof(msg), NULL, 0) < 0 ||
+            send_with_fds(upgrade_fd, batch, n * sizeof(Waiter), fds, n) < 0) {
+            add_log("Upgrade: the new server stopped reading, %d queued player(s) dropped",
+                    match_queue->queued);
+            break;
+        }
+        handed += n;
+    }
+    for (slot = 0; slot < MATCH_CAPACITY; slot++) {
+        if (match_queue->slots[slot].state != SLOT_FREE) drop_connection(slot);
+    }
+    add_log("Upgrade: %d waiting connection(s) handed over", handed);
+}
+
+// Last message of an upgrade, sent once results and analytics are on disk
+void hand_off_listener() {
+    HandoffMsg msg = {HANDOFF_MAGIC, HANDOFF_LISTENER, 1, rooms_started, {0}, 0};
+    if (send_with_fds(upgrade_fd, &msg, sizeof(msg), &server_fd, 1) < 0) {
+        add_log("Upgrade: the listener could not be handed over");
+    }
+    close(upgrade_fd);
+    upgrade_fd = -1;
+}
+
+void receive_room(int rooms_fd) {
+    int fd = accept(rooms_fd, NULL, NULL);
+    if (fd < 0) return;
+    if (resumed_count == MAX_ROOMS) {
+        close(fd);
+        return;
+    }
+    set_io_timeout(fd);
+    
+    ResumedRoom *rr = &resumed[resumed_count];
+    rr->game = malloc(sizeof(GameState));
+    rr->outbound = malloc(sizeof(OutboundPool));
+    int n = -1;
+    if (rr->game && rr->outbound) {
+        n = recv_with_fds(fd, &rr->head, sizeof(rr->head), rr->fds, MAX_CLIENTS);
+    }
+    int ok = n >= 0 && rr->head.magic == HANDOFF_MAGIC && n == rr->head.player_count &&
+             recv_with_fds(fd, rr->game, sizeof(GameState), NULL, 0) == 0 &&
+             recv_with_fds(fd, rr->outbound, sizeof(OutboundPool), NULL, 0) == 0 &&
+             send(fd, "K", 1, MSG_NOSIGNAL) == 1;
+    close(fd);
+    
+    if (!ok) {
+        for (int i = 0; i < n; i++) close(rr->fds[i]);
+        free(rr->game);
+        free(rr->outbound);
+        add_log("Upgrade: a room arrived incomplete and was dropped");
+        return;
+    }
+    add_log("Upgrade: room %d taken over with %d players", rr->head.room_id, n);
+    resumed_count++;
+}
+
+// Waiters go back into this process's queue as they were, their queue
+// time included: both servers read the same CLOCK_MONOTONIC
+void adopt_waiters(int fd, int n) {
+    static Waiter batch[HANDOFF_BATCH];
+    int fds[HANDOFF_BATCH];
+    int got = n <= HANDOFF_BATCH ? recv_with_fds(fd, batch, n * sizeof(Waiter), fds, n) : -1;
+    if (got != n) {
+        for (int i = 0; i < got; i++) close(fds[i]);
+        add_log("Upgrade: a batch of %d waiting connection(s) was lost", n);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        int slot = match_alloc(match_queue, fds[i], now_ms());
+        if (slot < 0) {
+            close(fds[i]);
+            continue;
+        }
+        Waiter *w = &match_queue->slots[slot];
+        w->line_len = batch[i].line_len;
+        memcpy(w->line, batch[i].line, sizeof(w->line));
+        memcpy(w->name, batch[i].name, sizeof(w->name));
+        if (batch[i].state == SLOT_QUEUED) match_enqueue(match_queue, slot, batch[i].rating, batch[i].since);
+    }
+}
+
+// -U: takes over from the server running on this port. Rooms arrive on
+// their own connections while the old main waits for them to freeze; its
+// queue and listener come last. Returns -1 if the old server vanished
+// before handing over the listener, which main then binds itself.
+int receive_handoff() {
+    int rooms_fd = control_listen(".next");
+    int fd = control_connect("");
+    HandoffMsg msg = {HANDOFF_MAGIC, HANDOFF_HELLO, 0, 0, {0}, 0};
+    handoff_layout(msg.layout);
+    if (rooms_fd < 0 || fd < 0 || send_with_fds(fd, &msg, sizeof(msg), NULL, 0) < 0 ||
+        recv_with_fds(fd, &msg, sizeof(msg), NULL, 0) < 0) {
+        fprintf(stderr, "No server on port %d to upgrade, or another upgrade is under way\n", PORT);
+        exit(1);
+    }
+    if (msg.kind != HANDOFF_ACCEPTED) {
+        fprintf(stderr, "Upgrade refused by the running server, see its game.log\n");
+        exit(1);
+    }
+    printf("Upgrade accepted, waiting for rooms to freeze...\n");
+    fflush(stdout);
+    
+    // No timeout now: the old server may wait a whole turn for a room
+    struct timeval none = {0, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &none, sizeof(none));
+    resumed = calloc(MAX_ROOMS, sizeof(ResumedRoom));
+    int done = 0;
+    while (!done) {
+        struct pollfd pfd[2] = {{fd, POLLIN, 0}, {rooms_fd, POLLIN, 0}};
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfd[1].revents & POLLIN) receive_room(rooms_fd);
+        if (!(pfd[0].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+        
+        int listener;
+        int n = recv_with_fds(fd, &msg, sizeof(msg), &listener, 1);
+        if (n < 0 || msg.magic != HANDOFF_MAGIC) break;
+        if (msg.kind == HANDOFF_WAITERS) {
+            adopt_waiters(fd, msg.count);
+        } else if (msg.kind == HANDOFF_LISTENER && n == 1) {
+            server_fd = listener;
+            rooms_started = msg.value;
+            done = 1;
+        } else if (n > 0) {
+            close(listener);
+        }
+    }
+    close(fd);
+    
+    // A room's connection may still sit in the backlog: it is sent before
+    // the room exits and the old main waits for every room to exit
+    fcntl(rooms_fd, F_SETFL, O_NONBLOCK);
+    struct pollfd pfd = {rooms_fd, POLLIN, 0};
+    while (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) receive_room(rooms_fd);
+    close(rooms_fd);
+    
+    add_log("Upgrade: took over %d room(s) and %d queued player(s)%s", resumed_count,
+            match_queue->queued, done ? "" : ", the old server left without its listener");
+    return done ? 0 : -1;
+}
+
+// Forks the rooms taken over in an upgrade, each keeping its room number
+void resume_rooms() {
+    for (int k = 0; k < resumed_count; k++) {
+        ResumedRoom *rr = &resumed[k];
+        int r = 0;
+        while (room_pids[r]) r++;
+        heat_results[r].heat = 0;
+        if (gateway_port) {
+            const char *names[MAX_CLIENTS];
+            for (int i = 0; i < rr->head.player_count; i++) names[i] = rr->game->players[i].name;
+            feed_open(&feeds[r], rr->head.room_id, names, rr->head.player_count);
+        }
+        chat_open(&chats[r], rr->head.room_id);
+        
+        sigset_t set, old;
+        sigemptyset(&set);
+        sigaddset(&set, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &set, &old);
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            sigprocmask(SIG_SETMASK, &old, NULL);
+            for (int j = k + 1; j < resumed_count; j++) {
+                for (int i = 0; i < resumed[j].head.player_count; i++) close(resumed[j].fds[i]);
+            }
+            if (gateway_port) room_feed = &feeds[r];
+            room_chat = &chats[r];
+            resume_room(rr);
+        }
+        if (pid > 0) {
+            room_pids[r] = pid;
+            room_exited[r] = 0;
+            rooms_running++;
+            profiler_add_child(pid);
+        }
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        
+        for (int i = 0; i < rr->head.player_count; i++) close(rr->fds[i]);
+        if (pid < 0) {
+            perror("fork failed");
+            add_log("Room %d could not be resumed, %d players dropped", rr->head.room_id, rr->head.player_count);
+        } else {
+            printf("Room %d resumed:", rr->head.room_id);
+            for (int i = 0; i < rr->head.player_count; i++) printf(" %s", rr->game->players[i].name);
+            printf("\n");
+        }
+        free(rr->game);
+        free(rr->outbound);
+    }
+    fflush(stdout);
+    free(resumed);
+    resumed = NULL;
+    resumed_count = 0;
+}
+
+// The standby's copy of a primary room, created on first sight
+ResumedRoom *mirror_room(int id, int create) {
+    for (int k = 0; k < resumed_count; k++) {
+        if (resumed[k].head.room_id == id) return &resumed[k];
+    }
+    if (!create || resumed_count == MAX_ROOMS) return NULL;
+    ResumedRoom *rr = &resumed[resumed_count];
+    memset(rr, 0, sizeof(*rr));
+    rr->game = calloc(1, sizeof(GameState));
+    if (!rr->game) return NULL;
+    rr->head.room_id = id;
+    resumed_count++;
+    return rr;
+}
+
+void forget_room(ResumedRoom *rr) {
+    for (int i = 0; i < rr->seated; i++) close(rr->fds[i]);
+    free(rr->game);
+    *rr = resumed[--resumed_count];
+}
+
+void mirror_score(const ScoreRecord *score) {
+    pthread_mutex_lock(&score_data->lock);
+    int i = 0;
+    while (i < score_data->count && strcmp(score_data->records[i].player_name, score->player_name) != 0) i++;
+    if (i < SCORE_CAPACITY) {
+        score_data->records[i] = *score;
+        if (i == score_data->count) score_data->count++;
+    }
+    pthread_mutex_unlock(&score_data->lock);
+}
+
+// Takeover: scores.txt is the primary's last durable word, and a row that
+// is further along there than here means a change never reached the log.
+// Those rows are taken from the file, so the first save does not undo them.
+void check_saved_scores() {
+    FILE *f = fopen("scores.txt", "r");
+    if (!f) return;
+    char line[256];
+    int behind = 0;
+    while (fgets(line, sizeof(line), f)) {
+        ScoreRecord saved = {{0}, 0, 0, 0};
+        if (sscanf(line, "%49[^,],%d,%d,%d", saved.player_name, &saved.wins, &saved.games, &saved.points) < 2) continue;
+        pthread_mutex_lock(&score_data->lock);
+        int i = 0;
+        while (i < score_data->count && strcmp(score_data->records[i].player_name, saved.player_name) != 0) i++;
+        int ahead = i == score_data->count || saved.games > score_data->records[i].games ||
+                    saved.wins > score_data->records[i].wins;
+        pthread_mutex_unlock(&score_data->lock);
+        if (ahead) {
+            mirror_score(&saved);
+            behind++;
+        }
+    }
+    fclose(f);
+    if (behind) add_log("Takeover: %d score row(s) were behind scores.txt, taken from the file", behind);
+}
+
+void apply_change(const ChangeRecord *r) {
+    if (r->kind == CHANGE_SCORE) {
+        mirror_score(&r->score);
+        return;
+    }
+    ResumedRoom *rr = mirror_room(r->room, r->kind == CHANGE_OPEN);
+    if (!rr) return;        // formed before this standby attached
+    
+    if (r->kind == CHANGE_OPEN) {
+        const RoomRoster *roster = &r->roster;
+        rr->head.magic = HANDOFF_MAGIC;
+        if (r->room > rooms_started) rooms_started = r->room;
+        rr->head.player_count = roster->player_count;
+        rr->head.simultaneous = roster->simultaneous;
+        rr->head.total_rounds = roster->total_rounds;
+        rr->head.validate = roster->validate;
+        rr->head.turn_ms = roster->turn_ms;
+        rr->game->player_count = roster->player_count;
+        rr->game->round = 1;
+        for (int i = 0; i < roster->player_count; i++) {
+            memcpy(rr->game->players[i].name, roster->names[i], NAME_SIZE);
+            rr->game->round_lives[i] = 3;
+            rr->game->connected[i] = 1;
+        }
+    } else if (r->kind == CHANGE_END) {
+        forget_room(rr);
+    } else if (rr->head.magic == HANDOFF_MAGIC) {
+        change_apply(rr->game, &r->image);
+    }
+}
+
+// Applies every record from next on. Returns the next one to read.
+uint64_t tail_changes(uint64_t next) {
+    ChangeRecord r;
+    int got;
+    while ((got = change_log_read(change_log, next, &r)) != 0) {
+        if (got > 0) {
+            apply_change(&r);
+            next++;
+            continue;
+        }
+        // Lapped by the writers: transitions are missing, so no copy can
+        // be trusted. The primary saves scores.txt after every game.
+        add_log("Standby fell behind the change log, dropping %d room copies", resumed_count);
+        while (resumed_count > 0) forget_room(&resumed[0]);
+        load_scores();
+        next = change_log_head(change_log) + 1;
+    }
+    return next;
+}
+
+// Exited, whoever reaps it: the dead primary's rooms go to init
+int process_gone(pid_t pid) {
+    char path[32];
+    char stat[128];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return 1;
+    size_t n = fread(stat, 1, sizeof(stat) - 1, f);
+    fclose(f);
+    stat[n] = '\0';
+    char *state = strrchr(stat, ')');
+    return !state || state[1] == '\0' || state[2] == 'Z' || state[2] == 'X';
+}
+
+// -B: hot standby for the server running on this port. It holds duplicates
+// of the listener and of every replicated room's sockets, so they outlive
+// the primary, and tails the change log into a copy of each room and of
+// the score store. Returns when the primary is gone and this process
+// takes over; exits if the primary shuts down or upgrades cleanly.
+void run_standby() {
+    int fd = control_connect("");
+    HandoffMsg msg = {HANDOFF_MAGIC, HANDOFF_STANDBY, 0, 0, {0}, 0};
+    handoff_layout(msg.layout);
+    int fds[2];
+    int n = fd < 0 || send_with_fds(fd, &msg, sizeof(msg), NULL, 0) < 0 ? -1 :
+            recv_with_fds(fd, &msg, sizeof(msg), fds, 2);
+    if (n < 0) {
+        fprintf(stderr, "No server on port %d to stand by for\n", PORT);
+        exit(1);
+    }
+    if (msg.kind != HANDOFF_ACCEPTED || n != 2) {
+        fprintf(stderr, "Standby refused by the running server, see its game.log\n");
+        exit(1);
+    }
+    change_log = change_log_map(fds[0]);
+    close(fds[0]);
+    server_fd = fds[1];
+    if (!change_log) {
+        perror("change log unavailable");
+        exit(1);
+    }
+    
+    uint64_t next = change_log_head(change_log) + 1;
+    load_scores();
+    resumed = calloc(MAX_ROOMS, sizeof(ResumedRoom));
+    struct timeval none = {0, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &none, sizeof(none));
+    add_log("Standing by, following the change log from %llu", (unsigned long long)next);
+    printf("Standing by for the server on port %d\n", PORT);
+    fflush(stdout);
+    
+    while (!shutdown_requested) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, STANDBY_POLL_MS) > 0) {
+            int seats[MAX_CLIENTS];
+            int got = recv_with_fds(fd, &msg, sizeof(msg), seats, MAX_CLIENTS);
+            if (got < 0) break;
+            if (msg.kind == HANDOFF_STOP) {
+                add_log("Primary stopped cleanly");
+                shutdown_requested = 1;
+            }
+            ResumedRoom *rr = msg.kind == HANDOFF_SEATS ? mirror_room(msg.value, 1) : NULL;
+            if (rr) {
+                for (int i = 0; i < rr->seated; i++) close(rr->fds[i]);
+                memcpy(rr->fds, seats, got * sizeof(int));
+                rr->seated = got;
+                rr->pid = msg.pid;
+            } else {
+                for (int i = 0; i < got; i++) close(seats[i]);
+            }
+        }
+        next = tail_changes(next);
+    }
+    close(fd);
+    if (shutdown_requested) {
+        add_log("Standby exiting");
+        printf("Standby exiting\n");
+        logging_active = 0;
+        pthread_join(logging_thread, NULL);
+        exit(0);
+    }
+    
+    // The primary's rooms die with it; none may still write a socket or
+    // the log once their copies resume here
+    long long deadline = now_ms() + TAKEOVER_WAIT_MS;
+    for (int k = 0; k < resumed_count; k++) {
+        while (!process_gone(resumed[k].pid) && now_ms() < deadline) usleep(5000);
+        if (!process_gone(resumed[k].pid)) kill(resumed[k].pid, SIGKILL);
+    }
+    tail_changes(next);
+    change_log_unmap(change_log);
+    change_log = NULL;
+    check_saved_scores();
+    for (int k = resumed_count - 1; k >= 0; k--) {
+        if (resumed[k].head.magic != HANDOFF_MAGIC || resumed[k].seated != resumed[k].head.player_count) {
+            forget_room(&resumed[k]);
+        }
+    }
+    add_log("Primary gone: taking over the listener and %d room(s)", resumed_count);
+    printf("Primary gone, taking over %d room(s)\n", resumed_count);
+    fflush(stdout);
+}
+
+// Gateway process (-W). Connections are found by descriptor in one table,
+// so an idle watcher costs its socket and a table entry.
+enum { CONN_FREE, CONN_REQUEST, CONN_WATCHER, CONN_PLAYER, CONN_PAIR };
+
+// A browser that plays: its WebSocket and the socket pair end it talks to
+// its room through
+typedef struct {
+    int ws;
+    int pair;
+    int in_len;                         // client frames not yet complete
+    unsigned char in[WS_FRAME_MAX];
+    int line_len;                       // from the room, not yet a whole line
+    char line[OUT_SLAB_SIZE];
+    int out_len;                        // framed for the browser
+    int out_sent;
+    char out[GATEWAY_RELAY_SIZE];
+} Relay;
+
+typedef struct {
+    int kind;                           // CONN_*
+    int channel;                        // watcher: room slot
+    int prev, next;                     // watcher: the channel's list, by descriptor
+    uint64_t cursor;                    // watcher: next ring byte it is sent
+    long long deadline;                 // request: to be complete by then
+    char *request;                      // request: bytes so far; watcher: a frame not complete yet
+    int request_len;
+    Relay *relay;                       // player and pair
+    char *name;                         // watcher: what it chats as, once it sent NAME
+    TokenBucket chat;                   // watcher
+    TokenBucket input;                  // watcher: bytes, as for players
+} Conn;
+
+// A room slot as the gateway sees it. Each line of the feed is framed once
+// into the ring, and every watcher is sent the ring from its own cursor.
+typedef struct {
+    int room;                           // 0 = idle
+    uint64_t read;                      // feed bytes taken
+    uint64_t head;                      // ring bytes written
+    char *ring;
+    int watchers;                       // first watcher, -1 = none
+    char roster[FEED_ROSTER_SIZE];
+    char board[OUT_SLAB_SIZE];          // latest BOARD line, for late watchers
+} Channel;
+
+Conn *conns = NULL;
+int conn_capacity = 0;
+int conn_count = 0;
+int conn_top = 0;                   // highest descriptor in use
+Channel channels[MAX_ROOMS];
+int gateway_epoll = -1;
+int gateway_listener = -1;
+int gateway_main = -1;              // the gateway's end of its socket pair with main
+int accept_paused = 0;              // out of descriptors, listener off until the next sweep
+
+void conn_open(int fd, int kind, uint32_t events, int op) {
+    conns[fd].kind = kind;
+    if (op == EPOLL_CTL_ADD) conn_count++;
+    if (fd > conn_top) conn_top = fd;
+    struct epoll_event ev;
+    ev.events = events | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = fd;
+    epoll_ctl(gateway_epoll, op, fd, &ev);
+}
+
+void conn_close(int fd) {
+    Conn *c = &conns[fd];
+    if (c->kind == CONN_FREE) return;
+    if (c->kind == CONN_WATCHER) {
+        Channel *ch = &channels[c->channel];
+        if (c->prev >= 0) conns[c->prev].next = c->next;
+        else ch->watchers = c->next;
+        if (c->next >= 0) conns[c->next].prev = c->prev;
+    }
+    free(c->request);
+    free(c->name);
+    memset(c, 0, sizeof(*c));
+    close(fd);
+    conn_count--;
+}
+
+void relay_close(Relay *r) {
+    conn_close(r->ws);
+    conn_close(r->pair);
+    free(r);
+}
+
+// Best effort, the connection is closed right after
+void ws_goodbye(int fd, int code) {
+    char payload[2] = {code >> 8, code & 0xFF};
+    char frame[8];
+    int len = ws_encode(WS_CLOSE, payload, 2, frame);
+    send(fd, frame, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+void http_reply(int fd, const char *status, const char *body) {
+    char msg[HTTP_REQUEST_MAX + MAX_ROOMS * (FEED_ROSTER_SIZE + 16)];
+    int len = snprintf(msg, sizeof(msg),
+                       "HTTP/1.1 %s\r\nContent-Type: text/plain\r\nContent-Length: %d\r\n"
+                       "Connection: close\r\n\r\n%s", status, (int)strlen(body), body);
+    send(fd, msg, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+// Sends the watcher what it has not had yet, straight from the ring. One a
+// whole ring behind is dropped.
+void fan_out(int fd) {
+    Conn *c = &conns[fd];
+    Channel *ch = &channels[c->channel];
+    if (ch->head - c->cursor > GATEWAY_RING) {
+        conn_close(fd);
+        return;
+    }
+    while (c->cursor < ch->head) {
+        int off = c->cursor & (GATEWAY_RING - 1);
+        int len = ch->head - c->cursor < (uint64_t)(GATEWAY_RING - off) ? (int)(ch->head - c->cursor) : GATEWAY_RING - off;
+        ssize_t n = send(fd, ch->ring + off, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) {
+            conn_close(fd);
+            return;
+        }
+        c->cursor += n;
+    }
+}
+
+// The room is over or main is gone: watchers get what is left and a close
+void channel_end(Channel *ch, int code) {
+    while (ch->watchers >= 0) {
+        int fd = ch->watchers;
+        fan_out(fd);
+        if (ch->watchers != fd) continue;
+        if (conns[fd].cursor == ch->head) ws_goodbye(fd, code);
+        conn_close(fd);
+    }
+    ch->room = 0;
+}
+
+void ring_put(Channel *ch, const char *data, int len) {
+    for (int i = 0; i < len; i++) ch->ring[(ch->head + i) & (GATEWAY_RING - 1)] = data[i];
+    ch->head += len;
+}
+
+// New broadcast lines of every room, framed once and fanned out. A room
+// that has exited is read to the end, END and final scores included,
+// before feed_read reports it gone and its watchers are closed.
+void tail_feeds() {
+    char lines[FEED_CAPACITY];
+    char frame[FEED_CAPACITY / 4 + 4];
+    for (int s = 0; s < MAX_ROOMS; s++) {
+        Channel *ch = &channels[s];
+        if (!ch->room) {
+            int room = feed_room(&feeds[s]);
+            if (!room) continue;
+            if (!ch->ring && !(ch->ring = malloc(GATEWAY_RING))) continue;
+            ch->room = room;
+            ch->read = 0;
+            ch->head = 0;
+            ch->board[0] = '\0';
+            memcpy(ch->roster, feeds[s].roster, FEED_ROSTER_SIZE);
+        }
+        
+        int n = feed_read(&feeds[s], ch->room, &ch->read, lines, sizeof(lines));
+        if (n < 0) channel_end(ch, 1000);
+        if (n <= 0) continue;
+        for (char *line = lines, *end; line < lines + n; line = end + 1) {
+            end = memchr(line, '\n', lines + n - line);
+            *end = '\0';
+            if (strncmp(line, "BOARD:", 6) == 0) snprintf(ch->board, sizeof(ch->board), "%.*s", (int)sizeof(ch->board) - 1, line);
+            ring_put(ch, frame, ws_encode(WS_TEXT, line, end - line, frame));
+        }
+        for (int fd = ch->watchers, next; fd >= 0; fd = next) {
+            next = conns[fd].next;
+            fan_out(fd);
+        }
+    }
+}
+
+// GET /watch/<room>: the roster and board now, then every broadcast line
+void gateway_watch(int fd, int room, const HttpRequest *req) {
+    int s = 0;
+    while (s < MAX_ROOMS && (room <= 0 || channels[s].room != room)) s++;
+    if (s == MAX_ROOMS) {
+        http_reply(fd, "404 Not Found", "No such room\n");
+        conn_close(fd);
+        return;
+    }
+    Channel *ch = &channels[s];
+    char msg[1024];
+    char line[FEED_ROSTER_SIZE + 32];
+    int len = ws_accept(req->key, msg, sizeof(msg));
+    int n = snprintf(line, sizeof(line), "WATCHING:%d|%s", room, ch->roster);
+    len += ws_encode(WS_TEXT, line, n, msg + len);
+    if (ch->board[0]) len += ws_encode(WS_TEXT, ch->board, strlen(ch->board), msg + len);
+    if (send(fd, msg, len, MSG_DONTWAIT | MSG_NOSIGNAL) != len) {
+        conn_close(fd);
+        return;
+    }
+    
+    Conn *c = &conns[fd];
+    c->channel = s;
+    c->cursor = ch->head;
+    c->prev = -1;
+    c->next = ch->watchers;
+    if (ch->watchers >= 0) conns[ch->watchers].prev = fd;
+    ch->watchers = fd;
+    conn_open(fd, CONN_WATCHER, EPOLLIN | EPOLLOUT, EPOLL_CTL_MOD);
+}
+
+// GET /play: a socket pair stands in for the browser's connection, and its
+// other end goes to main, which takes it like an accepted one
+void gateway_play(int fd, const HttpRequest *req) {
+    int sv[2];
+    Relay *r = calloc(1, sizeof(Relay));
+    if (!r || socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        free(r);
+        http_reply(fd, "503 Service Unavailable", "Try again later\n");
+        conn_close(fd);
+        return;
+    }
+    char reply[256];
+    int len = ws_accept(req->key, reply, sizeof(reply));
+    int one = 1;
+    if (sv[0] >= conn_capacity || send(fd, reply, len, MSG_DONTWAIT | MSG_NOSIGNAL) != len ||
+        gateway_main < 0 || send_with_fds(gateway_main, &one, sizeof(one), &sv[1], 1) < 0) {
+        close(sv[0]);
+        close(sv[1]);
+        free(r);
+        conn_close(fd);
+        return;
+    }
+    close(sv[1]);
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    
+    r->ws = fd;
+    r->pair = sv[0];
+    conns[fd].relay = r;
+    conns[sv[0]].relay = r;
+    conn_open(fd, CONN_PLAYER, EPOLLIN | EPOLLOUT, EPOLL_CTL_MOD);
+    conn_open(sv[0], CONN_PAIR, EPOLLIN, EPOLL_CTL_ADD);
+}
+
+void gateway_request(int fd) {
+    Conn *c = &conns[fd];
+    if (!c->request && !(c->request = malloc(HTTP_REQUEST_MAX + 1))) {
+        conn_close(fd);
+        return;
+    }
+    int end = 0;
+    while (!end) {
+        int n = recv(fd, c->request + c->request_len, HTTP_REQUEST_MAX - c->request_len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) {
+            conn_close(fd);
+            return;
+        }
+        c->request_len += n;
+        end = http_request_end(c->request, c->request_len);
+        if (!end && c->request_len == HTTP_REQUEST_MAX) {
+            http_reply(fd, "431 Request Header Fields Too Large", "");
+            conn_close(fd);
+            return;
+        }
+    }
+    
+    // Clients wait for the 101 before sending frames, so nothing follows
+    HttpRequest req;
+    c->request[end] = '\0';
+    int bad = http_parse(c->request, &req) < 0;
+    free(c->request);
+    c->request = NULL;
+    c->request_len = 0;
+    if (bad) {
+        http_reply(fd, "400 Bad Request", "");
+    } else if (strcmp(req.path, "/rooms") == 0) {
+        char body[MAX_ROOMS * (FEED_ROSTER_SIZE + 16)];
+        int len = 0;
+        for (int s = 0; s < MAX_ROOMS; s++) {
+            if (channels[s].room) len += sprintf(body + len, "ROOM:%d|%s\n", channels[s].room, channels[s].roster);
+        }
+        body[len] = '\0';
+        http_reply(fd, "200 OK", body);
+    } else if (strcmp(req.path, "/play") != 0 && strncmp(req.path, "/watch/", 7) != 0) {
+        http_reply(fd, "404 Not Found", "");
+    } else if (!req.key[0]) {
+        http_reply(fd, "426 Upgrade Required", "");
+    } else if (req.path[1] == 'p') {
+        gateway_play(fd, &req);
+        return;
+    } else {
+        gateway_watch(fd, atoi(req.path + 7), &req);
+        return;
+    }
+    conn_close(fd);
+}
+
+// Watchers are only expected to close. NAME:<name> and CHAT:<text> are all
+// a watcher says; other frames are ignored, and one this server does not
+// take ends it. Input collects in c->request until whole frames can be
+// decoded, so a frame split across reads is finished by the next one. It
+// chats as ~name, so it cannot pass for a player, and within the same limits.
+void watcher_says(int fd, const char *payload, int len) {
+    Conn *c = &conns[fd];
+    char line[WS_MAX_PAYLOAD + 1];
+    memcpy(line, payload, len);
+    line[len] = '\0';
+    if (strncmp(line, "NAME:", 5) == 0 && line[5]) {
+        free(c->name);
+        if ((c->name = malloc(NAME_SIZE))) snprintf(c->name, NAME_SIZE, "~%.*s", NAME_SIZE - 2, line + 5);
+    } else if (strncmp(line, "CHAT:", 5) == 0 && bucket_take(&c->chat, 1, CHAT_RATE, CHAT_BURST, now_ms())) {
+        chat_post(&chats[c->channel], channels[c->channel].room, c->name ? c->name : "~watcher", line + 5);
+    }
+}
+
+void watcher_input(int fd) {
+    Conn *c = &conns[fd];
+    if (!c->request && !(c->request = malloc(WS_FRAME_MAX))) {
+        conn_close(fd);
+        return;
+    }
+    while (1) {
+        int n = recv(fd, c->request + c->request_len, WS_FRAME_MAX - c->request_len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) {
+            conn_close(fd);
+            return;
+        }
+        if (!bucket_take(&c->input, n, INPUT_BYTE_RATE, INPUT_BYTE_BURST, now_ms())) {
+            ws_goodbye(fd, 1008);
+            conn_close(fd);
+            return;
+        }
+        c->request_len += n;
+        
+        int off = 0, used, op = 0, len;
+        char *payload;
+        while ((used = ws_decode((unsigned char *)c->request + off, c->request_len - off, &op, &payload, &len)) > 0) {
+            off += used;
+            if (op == WS_CLOSE) break;
+            if (op == WS_TEXT) watcher_says(fd, payload, len);
+        }
+        if (used < 0 || op == WS_CLOSE) {
+            if (used > 0 && c->cursor == channels[c->channel].head) ws_goodbye(fd, 1000);
+            conn_close(fd);
+            return;
+        }
+        memmove(c->request, c->request + off, c->request_len - off);
+        c->request_len -= off;
+    }
+}
+
+// Queues one frame for the browser. Returns -1 if it is too far behind.
+int relay_frame(Relay *r, int opcode, const char *payload, int len) {
+    if (r->out_len + len + 4 > GATEWAY_RELAY_SIZE) return -1;
+    r->out_len += ws_encode(opcode, payload, len, r->out + r->out_len);
+    return 0;
+}
+
+int relay_flush(Relay *r) {
+    while (r->out_sent < r->out_len) {
+        ssize_t n = send(r->ws, r->out + r->out_sent, r->out_len - r->out_sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        if (n <= 0) return -1;
+        r->out_sent += n;
+    }
+    r->out_len = r->out_sent = 0;
+    return 0;
+}
+
+// The room's lines, one text frame each. Reading stops while the browser
+// is behind; its next EPOLLOUT picks it up again.
+void relay_from_room(Relay *r) {
+    while (GATEWAY_RELAY_SIZE - r->out_len >= 2 * (int)sizeof(r->line)) {
+        int n = recv(r->pair, r->line + r->line_len, sizeof(r->line) - r->line_len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            relay_flush(r);
+            ws_goodbye(r->ws, 1000);
+            relay_close(r);
+            return;
+        }
+        r->line_len += n;
+        
+        int start = 0;
+        for (int i = 0; i < r->line_len; i++) {
+            if (r->line[i] != '\n') continue;
+            int len = i - start;
+            if (len > 0 && r->line[i - 1] == '\r') len--;
+            relay_frame(r, WS_TEXT, r->line + start, len);
+            start = i + 1;
+        }
+        // A line longer than the buffer goes out in pieces
+        if (start == 0 && r->line_len == (int)sizeof(r->line)) {
+            relay_frame(r, WS_TEXT, r->line, r->line_len);
+            start = r->line_len;
+        }
+        memmove(r->line, r->line + start, r->line_len - start);
+        r->line_len -= start;
+    }
+    if (relay_flush(r) < 0) relay_close(r);
+}
+
+// The browser's text frames are protocol lines for the room. One sending
+// faster than the pair drains, or past what the browser reads, is dropped.
+void relay_from_browser(Relay *r) {
+    while (1) {
+        int n = recv(r->ws, r->in + r->in_len, sizeof(r->in) - r->in_len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            relay_close(r);
+            return;
+        }
+        r->in_len += n;
+        
+        int off = 0, used, op, len;
+        char *payload;
+        while ((used = ws_decode(r->in + off, r->in_len - off, &op, &payload, &len)) > 0) {
+            off += used;
+            if (op == WS_CLOSE) {
+                relay_frame(r, WS_CLOSE, payload, len < 2 ? 0 : 2);
+                relay_flush(r);
+                relay_close(r);
+                return;
+            }
+            if (op == WS_PONG) continue;
+            if (op == WS_PING) {
+                if (relay_frame(r, WS_PONG, payload, len) < 0) break;
+                continue;
+            }
+            char line[WS_MAX_PAYLOAD + 1];
+            memcpy(line, payload, len);
+            if (len == 0 || line[len - 1] != '\n') line[len++] = '\n';
+            if (send(r->pair, line, len, MSG_DONTWAIT | MSG_NOSIGNAL) != len) break;
+        }
+        if (used != 0) {
+            ws_goodbye(r->ws, 1008);
+            relay_close(r);
+            return;
+        }
+        memmove(r->in, r->in + off, r->in_len - off);
+        r->in_len -= off;
+    }
+    if (relay_flush(r) < 0) relay_close(r);
+}
+
+void gateway_accept() {
+    while (1) {
+        int fd = accept(gateway_listener, NULL, NULL);
+        if (fd < 0) {
+            // Level triggered, so a full table would spin until a sweep
+            if (errno == EMFILE || errno == ENFILE) {
+                epoll_ctl(gateway_epoll, EPOLL_CTL_DEL, gateway_listener, NULL);
+                accept_paused = 1;
+                add_log("Gateway out of descriptors with %d connections", conn_count);
+            }
+            return;
+        }
+        if (fd >= conn_capacity) {
+            close(fd);
+            continue;
+        }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        tune_keepalive(fd, 0);
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        conns[fd].deadline = now_ms() + GATEWAY_HANDSHAKE_MS;
+        conn_open(fd, CONN_REQUEST, EPOLLIN, EPOLL_CTL_ADD);
+    }
+}
+
+// Once a second: requests past their deadline go, the listener comes back
+void gateway_sweep(long long now) {
+    for (int fd = 0; fd <= conn_top; fd++) {
+        if (conns[fd].kind == CONN_REQUEST && conns[fd].deadline < now) conn_close(fd);
+    }
+    while (conn_top > 0 && conns[conn_top].kind == CONN_FREE) conn_top--;
+    if (accept_paused && gateway_listener >= 0) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = gateway_listener;
+        epoll_ctl(gateway_epoll, EPOLL_CTL_ADD, gateway_listener, &ev);
+        accept_paused = 0;
+    }
+}
+
+// Main stopped or handed over. Watchers go, since their rooms' feeds stop
+// here too; players stay relayed until their rooms, wherever they now
+// run, close the pairs.
+void gateway_detach() {
+    close(gateway_listener);
+    close(gateway_main);
+    gateway_listener = -1;
+    gateway_main = -1;
+    for (int s = 0; s < MAX_ROOMS; s++) channel_end(&channels[s], 1001);
+    add_log("Gateway: server gone, relaying %d connection(s) until they close", conn_count);
+}
+
+void run_gateway(int listen_fd, int main_fd) {
+    struct sigaction sa;
+    sa.sa_handler = SIG_IGN;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, NULL);     // main's end of the pair tells it to stop
+    
+    struct rlimit lim;
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max < GATEWAY_MAX_CONNS ? lim.rlim_max : GATEWAY_MAX_CONNS;
+    setrlimit(RLIMIT_NOFILE, &lim);
+    getrlimit(RLIMIT_NOFILE, &lim);
+    conn_capacity = lim.rlim_cur < GATEWAY_MAX_CONNS ? lim.rlim_cur : GATEWAY_MAX_CONNS;
+    conns = calloc(conn_capacity, sizeof(Conn));
+    gateway_epoll = epoll_create1(0);
+    if (!conns || gateway_epoll < 0) {
+        perror("gateway setup failed");
+        exit(1);
+    }
+    for (int s = 0; s < MAX_ROOMS; s++) channels[s].watchers = -1;
+    
+    gateway_listener = listen_fd;
+    gateway_main = main_fd;
+    set_io_timeout(gateway_main);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = gateway_listener;
+    epoll_ctl(gateway_epoll, EPOLL_CTL_ADD, gateway_listener, &ev);
+    ev.data.fd = gateway_main;
+    epoll_ctl(gateway_epoll, EPOLL_CTL_ADD, gateway_main, &ev);
+    add_log("Gateway listening for WebSockets on port %d (up to %d connections)", gateway_port, conn_capacity);
+    
+    long long next_sweep = now_ms() + 1000;
+    while (gateway_main >= 0 || conn_count > 0) {
+        struct epoll_event events[256];
+        int n = epoll_wait(gateway_epoll, events, 256, GATEWAY_POLL_MS);
+        profiler_poll();
+        
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            uint32_t got = events[i].events;
+            if (fd == gateway_listener) {
+                gateway_accept();
+            } else if (fd == gateway_main) {
+                gateway_detach();
+            } else if (conns[fd].kind == CONN_REQUEST) {
+                gateway_request(fd);
+            } else if (conns[fd].kind == CONN_WATCHER) {
+                if (got & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) watcher_input(fd);
+                if (conns[fd].kind == CONN_WATCHER && (got & EPOLLOUT)) fan_out(fd);
+            } else if (conns[fd].kind == CONN_PLAYER) {
+                Relay *r = conns[fd].relay;
+                if (got & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) relay_from_browser(r);
+                if (conns[fd].kind == CONN_PLAYER && (got & EPOLLOUT)) relay_from_room(r);
+            } else if (conns[fd].kind == CONN_PAIR) {
+                relay_from_room(conns[fd].relay);
+            }
+        }
+        
+        if (gateway_main >= 0) tail_feeds();
+        long long now = now_ms();
+        if (now >= next_sweep) {
+            gateway_sweep(now);
+            next_sweep = now + 1000;
+        }
+    }
+    profiler_shutdown();
+    exit(0);
+}
+
+// Forks the gateway with its listener and a socket pair, on which it hands
+// main the sockets of browsers that play
+void start_gateway() {
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    // An upgrade's gateway binds while the old one still listens
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(gateway_port);
+    int sv[2];
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, SOMAXCONN) < 0 || socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        perror("WebSocket gateway unavailable");
+        if (fd >= 0) close(fd);
+        return;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(sv[0]);
+        close_main_sockets(NULL, 0);
+        profiler_init("gateway");
+        profiler_register_thread("main");
+        run_gateway(fd, sv[1]);
+    }
+    close(fd);
+    close(sv[1]);
+    if (pid < 0) {
+        perror("fork failed");
+        close(sv[0]);
+        return;
+    }
+    profiler_add_child(pid);
+    gateway_fd = sv[0];
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = GATEWAY_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, gateway_fd, &ev);
+}
+
+// A browser came to play: its socket pair end is handled like a socket
+// from accept()
+void gateway_players() {
+    int count;
+    int fds[HANDOFF_BATCH];
+    int n = recv_with_fds(gateway_fd, &count, sizeof(count), fds, HANDOFF_BATCH);
+    if (n < 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, gateway_fd, NULL);
+        close(gateway_fd);
+        gateway_fd = -1;
+        add_log("WebSocket gateway gone");
+        return;
+    }
+    for (int i = 0; i < n; i++) admit_connection(fds[i]);
+}
+
+int main(int argc, char *argv[]) {
+    struct sockaddr_in addr;
+    
+    int opt_char;
+    const char *roster_path = NULL;
+    int upgrade = 0;
+    int standby = 0;
+    while ((opt_char = getopt(argc, argv, "vHSUBR:r:t:T:P:D:W:A:")) != -1) {
+        switch (opt_char) {
+        case 'v':
+            validate_words = 1;
+            break;
+        case 'H':
+            use_huge_pages = 1;
+            break;
+        case 'S':
+            simultaneous_rounds = 1;
+            break;
+        case 'U':
+            upgrade = 1;
+            break;
+        case 'B':
+            standby = 1;
+            break;
+        case 'R':
+            roster_path = optarg;
+            break;
+        case 'r':
+            total_rounds = atoi(optarg);
+            if (total_rounds < 1) total_rounds = 1;
+            if (total_rounds > MAX_ROUNDS) total_rounds = MAX_ROUNDS;
+            break;
+        case 't':
+            turn_ms = atof(optarg) * 1000;
+            if (turn_ms < 2000) turn_ms = 2000;
+            if (turn_ms > 120000) turn_ms = 120000;
+            break;
+        case 'T':
+            trace_every = atoi(optarg);
+            break;
+        case 'P':
+            heartbeat_ms = atoi(optarg);
+            if (heartbeat_ms < 100) heartbeat_ms = 100;
+            break;
+        case 'D':
+            dead_after_ms = atoi(optarg);
+            break;
+        case 'W':
+            gateway_port = atoi(optarg);
+            if (gateway_port <= 0 || gateway_port > 65535 || gateway_port == PORT) {
+                fprintf(stderr, "-W needs a free port other than %d\n", PORT);
+                exit(1);
+            }
+            break;
+        case 'A':
+            accept_rate = atoi(optarg);
+            if (accept_rate < 0) accept_rate = 0;
+            if (accept_rate > ACCEPT_RATE_MAX) accept_rate = ACCEPT_RATE_MAX;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-v] [-H] [-S] [-U] [-B] [-R roster] [-r rounds] [-t seconds] [-T every] [-P ms] [-D ms] [-W port] [-A rate]\n", argv[0]);
+            fprintf(stderr, "  -v  reject WORD guesses that are not dictionary words (no penalty)\n");
+            fprintf(stderr, "  -H  back shared game state with huge pages\n");
+            fprintf(stderr, "  -S  simultaneous rounds: every active player guesses at once\n");
+            fprintf(stderr, "  -U  take over the games and players of the server running on this port\n");
+            fprintf(stderr, "  -B  hot standby for the server running on this port\n");
+            fprintf(stderr, "  -R  run a knockout tournament for the names in the roster file\n");
+            fprintf(stderr, "  -r  rounds per game, 1-%d (default %d)\n", MAX_ROUNDS, TOTAL_ROUNDS);
+            fprintf(stderr, "  -t  seconds per turn, may be fractional (default %d)\n", TIMEOUT_SECONDS);
+            fprintf(stderr, "  -T  trace every Nth turn into %s/ (see tracemerge)\n", TRACE_DIR);
+            fprintf(stderr, "  -P  heartbeat PING interval in ms (default %d)\n", HEARTBEAT_MS);
+            fprintf(stderr, "  -D  ms without a reply before a player is dropped (default %d)\n", HEARTBEAT_DEAD_MS);
+            fprintf(stderr, "  -W  serve browsers over WebSocket on this port\n");
+            fprintf(stderr, "  -A  new connections a second per address, 0 = no limit (default %d, at most %d)\n",
+                    ACCEPT_RATE, ACCEPT_RATE_MAX);
+            exit(1);
+        }
+    }
+    // A reply needs a whole interval plus the prompt pause to come back
+    if (dead_after_ms < 2 * heartbeat_ms + 1000) dead_after_ms = 2 * heartbeat_ms + 1000;
+    if ((upgrade || standby) && roster_path) {
+        fprintf(stderr, "A tournament cannot be started by an upgrade or a standby\n");
+        exit(1);
+    }
+    if (upgrade && standby) {
+        fprintf(stderr, "-U and -B do not go together\n");
+        exit(1);
+    }
+    
+    struct sigaction sa;
+    sa.sa_handler = sigchld_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, NULL);
+    // No SA_RESTART: SIGINT has to break the main thread out of epoll_wait()
+    sa.sa_handler = sigint_handler;
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, NULL);
+    sa.sa_handler = sighup_handler;
+    sigaction(SIGHUP, &sa, NULL);
+    sa.sa_handler = sigusr1_handler;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+    
+    dictionary = malloc(sizeof(Dictionary));
+    if (!dictionary || dict_load(dictionary, DICTIONARY_FILE, word_database, WORD_DATABASE_SIZE) < 0) {
+        perror("dictionary load failed");
+        exit(1);
+    }
+    
+    match_queue = malloc(sizeof(MatchQueue));
+    if (!match_queue || map_shared_state() < 0) {
+        perror("mmap failed");
+        exit(1);
+    }
+    match_init(match_queue);
+    
+    if (roster_path) {
+        tournament = malloc(sizeof(Tournament));
+        if (!tournament || tournament_load(tournament, roster_path) < 0) {
+            perror("roster unreadable");
+            exit(1);
+        }
+        for (int i = 0; i < MAX_SPECTATORS; i++) spectators[i] = -1;
+        registration_closes = now_ms() + TOURNAMENT_REGISTER_MS;
+    }
+    
+    if (trace_init(trace_every) < 0 || trace_open("main") < 0) {
+        perror("trace setup failed");
+        trace_every = 0;
+    }
+    
+    if (profiler_init("main") < 0 || profiler_register_thread("main") < 0) {
+        perror("profiler setup failed");
+    }
+    
+    init_shared_lock(&log_buffer->lock, &log_buffer->lock_attr);
+    init_shared_lock(&score_data->lock, &score_data->lock_attr);
+    init_shared_lock(&results->lock, &results->lock_attr);
+    for (int i = 0; i < MAX_ROOMS; i++) {
+        feed_init(&feeds[i]);
+        init_shared_lock(&chats[i].lock, &chats[i].lock_attr);
+    }
+    pthread_condattr_init(&results->cond_attr);
+    pthread_condattr_setpshared(&results->cond_attr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&results->ready, &results->cond_attr);
+    pthread_cond_init(&results->done, &results->cond_attr);
+    
+    analytics_init(analytics);
+    log_buffer->count = 0;
+    
+    // Before anything reads the files the old server is still writing
+    if (upgrade && receive_handoff() < 0) server_fd = -1;
+    
+    start_thread(&logging_thread, logger_func);
+    // Returns once the primary is gone, with its score store kept warm
+    if (standby) run_standby();
+    
+    if (history_open(&history, HISTORY_DIR) < 0) {
+        perror("history store unavailable");
+    }
+    
+    start_thread(&persist_thread, persist_func);
+    
+    if (!standby) load_scores();
+    if (analytics_load(analytics, ANALYTICS_FILE) >= 0) {
+        add_log("Loaded analytics for %d players", analytics->count);
+    }
+    add_log("Loaded %u dictionary words", dictionary->count);
+    if (validate_words) add_log("Rule mode: WORD guesses validated against the dictionary");
+    if (simultaneous_rounds) add_log("Round mode: simultaneous guesses resolved per volley");
+    if (total_rounds != TOTAL_ROUNDS) add_log("Games last %d rounds", total_rounds);
+    if (tournament) add_log("Tournament of %d entrants from %s", tournament->count, roster_path);
+    add_log("Server initialized");
+    
+    // An upgrade inherits the listener, already bound and nonblocking
+    if (server_fd < 0) {
+        if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+            perror("socket failed");
+            exit(1);
+        }
+        
+        int opt = 1;
+        setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(PORT);
+        
+        if (bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            perror("bind failed");
+            exit(1);
+        }
+        
+        // Bursts queue in the kernel backlog, accept_connections() drains it
+        if (listen(server_fd, SOMAXCONN) < 0) {
+            perror("listen failed");
+            exit(1);
+        }
+        fcntl(server_fd, F_SETFL, O_NONBLOCK);
+    }
+    
+    epoll_fd = epoll_create1(0);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = LISTEN_TAG;
+    if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &ev) < 0) {
+        perror("epoll setup failed");
+        exit(1);
+    }
+    // Connections handed over in an upgrade, as read_name() left them
+    for (int slot = 0; slot < MATCH_CAPACITY; slot++) {
+        if (match_queue->slots[slot].state == SLOT_FREE) continue;
+        ev.events = match_queue->slots[slot].state == SLOT_QUEUED ? EPOLLRDHUP : EPOLLIN | EPOLLRDHUP;
+        ev.data.u32 = slot;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, match_queue->slots[slot].fd, &ev);
+    }
+    open_control();
+    resume_rooms();
+    // After the resumed rooms, so it holds none of their sockets
+    if (gateway_port) start_gateway();
+    
+    printf("╔════════════════════════════════════════╗\n");
+    printf("║   Word Guessing Server Started         ║\n");
+    printf("║   Port: %d                              ║\n", PORT);
+    printf("║   Matching rooms of %d-%d players       ║\n", MATCH_ROOM_MIN, MATCH_ROOM_MAX);
+    printf("╚════════════════════════════════════════╝\n\n");
+    if (tournament) {
+        printf("Tournament of %d entrants, standings in %s\n\n", tournament->count, TOURNAMENT_FILE);
+        fflush(stdout);
+    }
+    
+    add_log("Server listening on port %d", PORT);
+    
+    while (!shutdown_requested) {
+        struct epoll_event events[64];
+        int n = epoll_wait(epoll_fd, events, 64, MATCH_TICK_MS);
+        
+        for (int i = 0; i < n; i++) {
+            int slot = events[i].data.u32;
+            if (slot == LISTEN_TAG) {
+                accept_connections();
+            } else if (slot == CONTROL_TAG) {
+                if (upgrade_fd < 0) control_request();
+            } else if (slot == STANDBY_TAG) {
+                if (standby_fd >= 0 && peer_closed(standby_fd)) detach_standby();
+            } else if (slot == UPGRADE_TAG) {
+                if (upgrade_fd >= 0 && peer_closed(upgrade_fd)) abort_upgrade();
+            } else if (slot == GATEWAY_TAG) {
+                if (gateway_fd >= 0) gateway_players();
+            } else if (slot >= SPECTATOR_TAG) {
+                if (peer_closed(spectators[slot - SPECTATOR_TAG])) drop_spectator(slot - SPECTATOR_TAG);
+            } else if (slot >= ENTRANT_TAG) {
+                if (peer_closed(tournament->entrants[slot - ENTRANT_TAG].fd)) entrant_left(slot - ENTRANT_TAG);
+            } else if (match_queue->slots[slot].state == SLOT_HANDSHAKE) {
+                read_name(slot);
+            } else if (match_queue->slots[slot].state == SLOT_QUEUED &&
+                       peer_closed(match_queue->slots[slot].fd)) {
+                add_log("Player %s left the queue", match_queue->slots[slot].name);
+                drop_connection(slot);
+            }
+        }
+        
+        sweep_handshakes();
+        if (reload_requested) start_reload();
+        publish_dictionary();
+        reap_rooms();
+        if (upgrade_fd >= 0) {
+            // Waiters stay queued for the new server
+            if (rooms_running == 0) break;
+            check_upgrade();
+        } else if (tournament) {
+            tournament_tick();
+        } else {
+            form_rooms();
+        }
+    }
+    
+    if (upgrade_fd >= 0) {
+        printf("\n\nUpgrade: every room handed over, passing on the listener...\n");
+        add_log("Server handing over to the new build");
+        hand_off_waiters();
+    } else {
+        printf("\n\nShutting down server...\n");
+        add_log("Server shutdown via SIGINT");
+        
+        for (int slot = 0; slot < MATCH_CAPACITY; slot++) {
+            if (match_queue->slots[slot].state != SLOT_FREE) drop_connection(slot);
+        }
+        
+        // Rooms end their games and queue the results before persistence stops
+        for (int i = 0; i < MAX_ROOMS; i++) {
+            if (room_pids[i] && !room_exited[i]) kill(room_pids[i], SIGINT);
+        }
+        long long stop_deadline = now_ms() + ROOM_STOP_MS;
+        while (rooms_running > 0 && now_ms() < stop_deadline) {
+            usleep(100000);
+            reap_rooms();
+        }
+        if (rooms_running > 0) add_log("%d room(s) still running at shutdown", rooms_running);
+    }
+    
+    if (tournament) {
+        if (!tournament->finished) save_standings();
+        for (int i = 0; i < tournament->count; i++) {
+            if (tournament->entrants[i].fd >= 0) close(tournament->entrants[i].fd);
+        }
+        for (int i = 0; i < MAX_SPECTATORS; i++) {
+            if (spectators[i] >= 0) close(spectators[i]);
+        }
+        free(tournament);
+    }
+    
+    persist_stop();
+    history_close(&history);
+    analytics_save(analytics, ANALYTICS_FILE);     // turns from unfinished games
+    release_standby();
+    if (upgrade_fd >= 0) hand_off_listener();
+    
+    logging_active = 0;
+    pthread_join(logging_thread, NULL);
+    profiler_shutdown();
+    
+    close(epoll_fd);
+    close(server_fd);
+    if (control_fd >= 0) close(control_fd);
+    if (gateway_fd >= 0) close(gateway_fd);
+    
+    pthread_mutex_destroy(&log_buffer->lock);
+    pthread_mutex_destroy(&score_data->lock);
+    pthread_mutex_destroy(&results->lock);
+    pthread_mutex_destroy(&analytics->lock);
+    pthread_cond_destroy(&results->ready);
+    pthread_cond_destroy(&results->done);
+    
+    munmap(shared_arena, shared_arena_size);
+    free(match_queue);
+    trace_close();
+    dict_free(dictionary);
+    free(dictionary);
+    
+    printf("Server shutdown complete.\n");
+    
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tournament.h"
+
+// One entrant per line, blank lines and '#' comments skipped. Returns the
+// number of entrants, -1 if the file cannot be read.
+int tournament_load(Tournament *t, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    memset(t, 0, sizeof(*t));
+    t->champion = -1;
+    char line[256];
+    while (fgets(line, sizeof(line), f) && t->count < TOURNAMENT_MAX_ENTRANTS) {
+        char *name = line + strspn(line, " \t");
+        name[strcspn(name, "\r\n")] = '\0';
+        int len = strlen(name);
+        while (len > 0 && (name[len - 1] == ' ' || name[len - 1] == '\t')) name[--len] = '\0';
+        if (len == 0 || name[0] == '#') continue;
+        if (len >= NAME_SIZE) name[NAME_SIZE - 1] = '\0';
+        if (tournament_find(t, name) >= 0) continue;
+
+        Entrant *e = &t->entrants[t->count++];
+        strcpy(e->name, name);
+        e->fd = -1;
+        e->status = ENTRANT_ABSENT;
+    }
+    fclose(f);
+    return t->count;
+}
+
+int tournament_find(const Tournament *t, const char *name) {
+    for (int i = 0; i < t->count; i++) {
+        if (strcmp(t->entrants[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static const Tournament *sort_tournament;
+
+// Points so far, then roster seed
+static int by_points(const void *a, const void *b) {
+    const Entrant *x = &sort_tournament->entrants[*(const int *)a];
+    const Entrant *y = &sort_tournament->entrants[*(const int *)b];
+    if (x->points != y->points) return y->points - x->points;
+    return *(const int *)a - *(const int *)b;
+}
+
+// Champion, then the furthest stage reached, place in that stage's heat,
+// points and roster seed
+static int by_standing(const void *a, const void *b) {
+    const Entrant *x = &sort_tournament->entrants[*(const int *)a];
+    const Entrant *y = &sort_tournament->entrants[*(const int *)b];
+    int x_stage = x->status == ENTRANT_PLAYING ? sort_tournament->stage : x->stage;
+    int y_stage = y->status == ENTRANT_PLAYING ? sort_tournament->stage : y->stage;
+    if ((x->status == ENTRANT_CHAMPION) != (y->status == ENTRANT_CHAMPION)) {
+        return x->status == ENTRANT_CHAMPION ? -1 : 1;
+    }
+    if (x_stage != y_stage) return y_stage - x_stage;
+    if (x->place != y->place) return x->place - y->place;
+    if (x->points != y->points) return y->points - x->points;
+    return *(const int *)a - *(const int *)b;
+}
+
+// Draws the next stage from the entrants still in; those who never
+// registered forfeit at the first draw. Returns the number of heats, 0 once
+// the tournament is decided (champion is -1 if nobody was left to win it).
+int tournament_plan(Tournament *t) {
+    int order[TOURNAMENT_MAX_ENTRANTS];
+    int n = 0;
+    for (int i = 0; i < t->count; i++) {
+        Entrant *e = &t->entrants[i];
+        if (e->status == ENTRANT_ABSENT) e->status = ENTRANT_OUT;
+        if (e->status == ENTRANT_READY) order[n++] = i;
+    }
+    t->heat_count = t->heats_started = t->heats_done = 0;
+    if (n <= 1) {
+        t->finished = 1;
+        if (n == 1) {
+            t->champion = order[0];
+            t->entrants[order[0]].status = ENTRANT_CHAMPION;
+        }
+        return 0;
+    }
+
+    // The first stage is seeded by the roster, later ones by points
+    if (t->stage > 0) {
+        sort_tournament = t;
+        qsort(order, n, sizeof(int), by_points);
+    }
+    t->stage++;
+
+    int heats = (n + MAX_CLIENTS - 1) / MAX_CLIENTS;
+    t->advance = heats == 1 ? 0 : heats == 2 ? 2 : 1;
+    for (int h = 0; h < heats; h++) t->heats[h].count = 0;
+    for (int i = 0; i < n; i++) {
+        int pass = i / heats;
+        int pos = i % heats;
+        Heat *heat = &t->heats[pass % 2 ? heats - 1 - pos : pos];
+        heat->members[heat->count++] = order[i];
+    }
+    t->heat_count = heats;
+    return heats;
+}
+
+// Applies a heat's final standings, best first. Members the result does
+// not list (the room died early) rank after those it does, by seed.
+// Members who withdrew before the heat started are skipped.
+void tournament_heat_done(Tournament *t, int heat, const char (*names)[NAME_SIZE],
+                          const int *scores, int n) {
+    Heat *h = &t->heats[heat];
+    int ranked[MAX_CLIENTS];
+    int taken[MAX_CLIENTS] = {0};
+    int k = 0;
+
+    for (int i = 0; i < n; i++) {
+        for (int m = 0; m < h->count; m++) {
+            Entrant *e = &t->entrants[h->members[m]];
+            if (!taken[m] && e->status == ENTRANT_PLAYING && strcmp(e->name, names[i]) == 0) {
+                taken[m] = 1;
+                e->points += scores[i];
+                ranked[k++] = h->members[m];
+                break;
+            }
+        }
+    }
+    for (int m = 0; m < h->count; m++) {
+        if (!taken[m] && t->entrants[h->members[m]].status == ENTRANT_PLAYING) {
+            ranked[k++] = h->members[m];
+        }
+    }
+
+    for (int i = 0; i < k; i++) {
+        Entrant *e = &t->entrants[ranked[i]];
+        e->stage = t->stage;
+        e->place = i + 1;
+        e->heats++;
+        if (t->advance == 0) {
+            e->status = i == 0 ? ENTRANT_CHAMPION : ENTRANT_OUT;
+        } else {
+            e->status = i < t->advance ? ENTRANT_READY : ENTRANT_OUT;
+        }
+    }
+    if (t->advance == 0 && k > 0) t->champion = ranked[0];
+    t->heats_done++;
+}
+
+void tournament_report(const Tournament *t, FILE *f) {
+    static const char *status_names[] = { "absent", "in", "playing", "out", "champion" };
+    int order[TOURNAMENT_MAX_ENTRANTS];
+    for (int i = 0; i < t->count; i++) order[i] = i;
+    sort_tournament = t;
+    qsort(order, t->count, sizeof(int), by_standing);
+
+    fprintf(f, "=== TOURNAMENT STANDINGS ===\n");
+    if (t->finished) {
+        fprintf(f, "Finished after %d stage(s), champion: %s\n\n", t->stage,
+                t->champion >= 0 ? t->entrants[t->champion].name : "none");
+    } else if (t->stage == 0) {
+        fprintf(f, "Registration open\n\n");
+    } else {
+        fprintf(f, "Stage %d: %d of %d heats finished\n\n", t->stage, t->heats_done, t->heat_count);
+    }
+
+    fprintf(f, "%-5s %-20s %-9s %5s %5s %5s %6s\n", "RANK", "NAME", "STATUS", "STAGE", "PLACE", "HEATS", "POINTS");
+    for (int i = 0; i < t->count; i++) {
+        const Entrant *e = &t->entrants[order[i]];
+        const char *status = e->status == ENTRANT_OUT && e->stage == 0 ? "forfeit" : status_names[e->status];
+        fprintf(f, "%-5d %-20s %-9s %5d %5d %5d %6d\n", i + 1, e->name, status,
+                e->stage, e->place, e->heats, e->points);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+
+#include <stdio.h>
+#include "game_state.h"
+
+// Knockout tournament over a roster file, driven by the accept loop. Each
+// stage splits the entrants still in into heats of at most MAX_CLIENTS,
+// seeded snake-wise so every heat gets a spread of seeds, and the heats run
+// as ordinary rooms in parallel. The best of each heat advance (the best two
+// while only two heats are left, so the final is not a duel) until a single
+// heat decides the champion: n entrants need about log5(n) stages, so the
+// whole tournament takes a few games' time as long as the rooms of one
+// stage fit on the machine at once.
+
+#define TOURNAMENT_MAX_ENTRANTS 1024
+#define TOURNAMENT_MAX_HEATS ((TOURNAMENT_MAX_ENTRANTS + MAX_CLIENTS - 1) / MAX_CLIENTS)
+#define TOURNAMENT_FILE "tournament.txt"
+
+enum { ENTRANT_ABSENT, ENTRANT_READY, ENTRANT_PLAYING, ENTRANT_OUT, ENTRANT_CHAMPION };
+
+typedef struct {
+    char name[NAME_SIZE];
+    int fd;                         // -1 while not connected
+    int status;                     // ENTRANT_*
+    int stage;                      // last stage played, 0 = none
+    int place;                      // in the heat of that stage
+    int heats;
+    int points;                     // game points summed over every heat
+} Entrant;
+
+typedef struct {
+    int count;
+    int members[MAX_CLIENTS];       // entrant indices, best seed first
+} Heat;
+
+typedef struct {
+    Entrant entrants[TOURNAMENT_MAX_ENTRANTS];     // roster order is the seeding
+    int count;
+    int stage;                      // 0 while registration is open
+    Heat heats[TOURNAMENT_MAX_HEATS];
+    int heat_count;                 // in the current stage
+    int heats_started;
+    int heats_done;
+    int advance;                    // players each heat sends on, 0 in the final
+    int champion;                   // entrant index, -1 until decided
+    int finished;
+} Tournament;
+
+int tournament_load(Tournament *t, const char *path);
+int tournament_find(const Tournament *t, const char *name);
+int tournament_plan(Tournament *t);
+void tournament_heat_done(Tournament *t, int heat, const char (*names)[NAME_SIZE],
+                          const int *scores, int n);
+void tournament_report(const Tournament *t, FILE *f);
+
+#endif
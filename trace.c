@@ -0,0 +1,104 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "trace.h"
+
+static int sample_every = 0;        // 0 = tracing off
+static TraceRing *ring = NULL;
+static size_t ring_size = 0;
+
+// Called once in the main process, clears rings left by an earlier run
+int trace_init(int every) {
+    sample_every = every;
+    if (sample_every <= 0) return 0;
+
+    if (mkdir(TRACE_DIR, 0755) < 0 && errno != EEXIST) return -1;
+
+    DIR *dir = opendir(TRACE_DIR);
+    if (!dir) return -1;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        if (len > 5 && strcmp(ent->d_name + len - 5, ".ring") == 0) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s", TRACE_DIR, ent->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+    return 0;
+}
+
+// Give the calling process its own ring. A forked child that does not call
+// this keeps writing into its parent's ring.
+int trace_open(const char *process) {
+    if (sample_every <= 0) return 0;
+    trace_close();
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.%d.ring", TRACE_DIR, process, getpid());
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+
+    size_t size = sizeof(TraceRing) + TRACE_RING_SPANS * sizeof(TraceSpan);
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        return -1;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -1;
+
+    ring = base;
+    ring_size = size;
+    ring->capacity = TRACE_RING_SPANS;
+    ring->pid = getpid();
+    snprintf(ring->process, sizeof(ring->process), "%s", process);
+    ring->head = 0;
+    __atomic_store_n(&ring->magic, TRACE_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void trace_close(void) {
+    if (ring) munmap(ring, ring_size);
+    ring = NULL;
+    ring_size = 0;
+}
+
+uint64_t trace_begin(void) {
+    if (!ring) return 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Record [start, now) if the turn is sampled. Threads and forked helpers
+// share the ring, so slots are claimed with an atomic increment.
+void trace_end(const char *name, int round, int turn, int arg, uint64_t start) {
+    if (!ring || !start || turn % sample_every != 0) return;
+
+    uint64_t end = trace_begin();
+    uint64_t n = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+    TraceSpan *s = &ring->spans[n % ring->capacity];
+
+    __atomic_store_n(&s->seq, 0, __ATOMIC_RELAXED);
+    s->start_ns = start;
+    s->dur_ns = end - start;
+    s->pid = getpid();
+    s->tid = syscall(SYS_gettid);
+    s->round = round;
+    s->turn = turn;
+    s->arg = arg;
+    strncpy(s->name, name, TRACE_NAME_SIZE - 1);
+    s->name[TRACE_NAME_SIZE - 1] = '\0';
+    __atomic_store_n(&s->seq, n + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,44 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Span tracing across the server's processes. Each long-lived process owns
+// a ring in a shared file mapping under TRACE_DIR; forked helpers write
+// into the ring they inherit. Spans carry the round and turn they belong
+// to, and only every Nth turn is recorded. tracemerge turns the rings into
+// a Chrome/Perfetto trace.
+
+#define TRACE_DIR "traces"
+#define TRACE_MAGIC 0x54524331      // "TRC1"
+#define TRACE_RING_SPANS 4096       // per process, oldest spans are overwritten
+#define TRACE_NAME_SIZE 20
+
+typedef struct {
+    uint64_t seq;                   // slot index + 1 once the span is complete
+    uint64_t start_ns;              // CLOCK_MONOTONIC
+    uint64_t dur_ns;
+    int32_t pid;
+    int32_t tid;
+    int32_t round;
+    int32_t turn;
+    int32_t arg;                    // span specific, e.g. player slot
+    char name[TRACE_NAME_SIZE];
+} TraceSpan;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t capacity;
+    int32_t pid;
+    char process[36];
+    uint64_t head __attribute__((aligned(64)));
+    TraceSpan spans[] __attribute__((aligned(64)));
+} TraceRing;
+
+int trace_init(int sample_every);
+int trace_open(const char *process);
+void trace_close(void);
+uint64_t trace_begin(void);
+void trace_end(const char *name, int round, int turn, int arg, uint64_t start);
+
+#endif
@@ -0,0 +1,141 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+
+// Merges the server's span rings into one Chrome trace-event file:
+//   ./tracemerge traces/*.ring > turn_trace.json
+// then open it in chrome://tracing or ui.perfetto.dev.
+
+typedef struct {
+    TraceSpan span;
+    int ring;                       // index of the ring it came from
+} Entry;
+
+typedef struct {
+    int pid;
+    int ring;
+} Process;
+
+static Entry *entries = NULL;
+static int entry_count = 0, entry_cap = 0;
+static Process *procs = NULL;
+static int proc_count = 0, proc_cap = 0;
+
+static void add_entry(const TraceSpan *s, int ring) {
+    if (entry_count == entry_cap) {
+        entry_cap = entry_cap ? entry_cap * 2 : 4096;
+        entries = realloc(entries, entry_cap * sizeof(Entry));
+        if (!entries) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    entries[entry_count].span = *s;
+    entries[entry_count].ring = ring;
+    entry_count++;
+}
+
+// First ring a pid shows up in names it; helpers get "<owner>-child"
+static int add_process(int pid, int ring) {
+    for (int i = 0; i < proc_count; i++) {
+        if (procs[i].pid == pid) return 0;
+    }
+    if (proc_count == proc_cap) {
+        proc_cap = proc_cap ? proc_cap * 2 : 16;
+        procs = realloc(procs, proc_cap * sizeof(Process));
+        if (!procs) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    procs[proc_count].pid = pid;
+    procs[proc_count].ring = ring;
+    proc_count++;
+    return 1;
+}
+
+static int by_start(const void *a, const void *b) {
+    const Entry *x = a, *y = b;
+    if (x->span.start_ns != y->span.start_ns) return x->span.start_ns < y->span.start_ns ? -1 : 1;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s ring-file...\n", argv[0]);
+        return 1;
+    }
+
+    int rings = argc - 1;
+    TraceRing **maps = calloc(rings, sizeof(TraceRing *));
+
+    for (int r = 0; r < rings; r++) {
+        int fd = open(argv[r + 1], O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(TraceRing)) {
+            fprintf(stderr, "%s: cannot read\n", argv[r + 1]);
+            if (fd >= 0) close(fd);
+            continue;
+        }
+        TraceRing *ring = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (ring == MAP_FAILED) continue;
+        if (ring->magic != TRACE_MAGIC ||
+            sizeof(TraceRing) + (size_t)ring->capacity * sizeof(TraceSpan) > (size_t)st.st_size) {
+            fprintf(stderr, "%s: not a trace ring\n", argv[r + 1]);
+            continue;
+        }
+        maps[r] = ring;
+        add_process(ring->pid, r);
+
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t first = head > ring->capacity ? head - ring->capacity : 0;
+        for (uint64_t n = first; n < head; n++) {
+            const TraceSpan *s = &ring->spans[n % ring->capacity];
+            // Skip slots still being written or already overwritten
+            if (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != n + 1) continue;
+            add_entry(s, r);
+        }
+        if (head > ring->capacity) {
+            fprintf(stderr, "%s: ring wrapped, %llu oldest spans lost\n",
+                    argv[r + 1], (unsigned long long)(head - ring->capacity));
+        }
+    }
+
+    qsort(entries, entry_count, sizeof(Entry), by_start);
+    uint64_t origin = entry_count ? entries[0].span.start_ns : 0;
+
+    printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    int first = 1;
+    for (int r = 0; r < rings; r++) {
+        if (!maps[r]) continue;
+        printf("%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}",
+               first ? "" : ",\n", maps[r]->pid, maps[r]->process);
+        first = 0;
+    }
+    for (int i = 0; i < entry_count; i++) {
+        const TraceSpan *s = &entries[i].span;
+        if (add_process(s->pid, entries[i].ring)) {
+            printf("%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s-child\"}}",
+                   first ? "" : ",\n", s->pid, maps[entries[i].ring]->process);
+            first = 0;
+        }
+        printf("%s{\"name\":\"%.*s\",\"cat\":\"turn\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+               "\"pid\":%d,\"tid\":%d,\"args\":{\"corr\":\"r%d.t%d\",\"round\":%d,\"turn\":%d,\"arg\":%d}}",
+               first ? "" : ",\n", TRACE_NAME_SIZE, s->name,
+               (s->start_ns - origin) / 1000.0, s->dur_ns / 1000.0,
+               s->pid, s->tid, s->round, s->turn, s->round, s->turn, s->arg);
+        first = 0;
+    }
+    printf("\n]}\n");
+
+    fprintf(stderr, "%d spans from %d rings\n", entry_count, rings);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "dictionary.h"
+
+// Offline pass: score every dictionary word and print "word,score" lines,
+// ready to replace the dictionary file the server loads.
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : "words.txt";
+    Dictionary d;
+
+    if (dict_load(&d, path, NULL, 0) < 0 || d.count == 0) {
+        fprintf(stderr, "Cannot load dictionary %s\n", path);
+        return 1;
+    }
+    if (dict_score(&d, 1) < 0) {
+        fprintf(stderr, "Scoring failed\n");
+        return 1;
+    }
+
+    int histogram[DICT_DIFFICULTY_BUCKETS] = {0};
+    for (uint32_t i = 0; i < d.count; i++) {
+        for (int j = 0; j < d.lengths[i]; j++) putchar(tolower((unsigned char)d.words[i][j]));
+        printf(",%d\n", d.difficulty[i]);
+        histogram[d.difficulty[i] * DICT_DIFFICULTY_BUCKETS / 100]++;
+    }
+
+    fprintf(stderr, "Scored %u words from %s\n", d.count, path);
+    for (int b = 0; b < DICT_DIFFICULTY_BUCKETS; b++) {
+        fprintf(stderr, "  difficulty %2d-%2d: %d\n", b * 10, b * 10 + 9, histogram[b]);
+    }
+    dict_free(&d);
+    return 0;
+}